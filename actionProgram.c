@@ -0,0 +1,229 @@
+/*
+ Routines for CBUS FLiM operations - part of CBUS libraries for PIC 18F
+  This work is licensed under the:
+      Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International License.
+   To view a copy of this license, visit:
+      http://creativecommons.org/licenses/by-nc-sa/4.0/
+   or send a letter to Creative Commons, PO Box 1866, Mountain View, CA 94042, USA.
+   License summary:
+    You are free to:
+      Share, copy and redistribute the material in any medium or format
+      Adapt, remix, transform, and build upon the material
+    The licensor cannot revoke these freedoms as long as you follow the license terms.
+    Attribution : You must give appropriate credit, provide a link to the license,
+                   and indicate if changes were made. You may do so in any reasonable manner,
+                   but not in any way that suggests the licensor endorses you or your use.
+    NonCommercial : You may not use the material for commercial purposes. **(see note below)
+    ShareAlike : If you remix, transform, or build upon the material, you must distribute
+                  your contributions under the same license as the original.
+    No additional restrictions : You may not apply legal terms or technological measures that
+                                  legally restrict others from doing anything the license permits.
+   ** For commercial use, please contact the original copyright holder(s) to agree licensing terms
+**************************************************************************************************************
+	The FLiM routines have no code or definitions that are specific to any
+	module, so they can be used to provide FLiM facilities for any module 
+	using these libraries.
+	
+*/ 
+/*
+ * File:   actionProgram.c
+ *
+ * Created on 20 October 2026, 10:45
+ *
+ * Each consumed event's EVs are compiled into an ON program and an OFF 
+ * program which hold the actions in the order processEvent() would queue 
+ * them, with the SIMULTANEOUS flags already adjusted for OFF events and 
+ * the EV and Flash actions converted. Receiving an event then only needs 
+ * the actions copied from flash into the action queue.
+ * 
+ * The programs are kept in flash at AT_PROGRAMS, PROGRAM_SIZE bytes for each
+ * event table entry. They are compiled at start up and once learning has 
+ * finished for a second, only the bytes which have changed being written.
+ * Until then, for events with more than MAX_PROGRAM_ACTIONS actions and 
+ * when 1Track is enabled the EVs are interpreted as before.
+ * 
+ * In the main loop the programs are compiled a slice at a time, for up to
+ * COMPILE_SLICE per poll, so that servo slots, input scans and the CAN 
+ * drain are not held up. A poll also ends once a flash block has been 
+ * written as erasing and writing a block stalls the processor for a few ms.
+ */
+
+#include "devincs.h"
+#include "module.h"
+#include "romops.h"
+#include "FliM.h"
+#include "TickTime.h"
+#include "actionQueue.h"
+#include "cbus1Track.h"
+#include "latency.h"
+#include "actionProgram.h"
+
+#ifdef ACTION_PROGRAMS
+
+#define PROGRAM_SETTLE_TIME ONE_SECOND
+#define COMPILE_SLICE       ONE_MILI_SECOND     // time spent compiling in one poll
+#define FLASH_BLOCK_SIZE    64      // flash erase and write block
+#define INVALID_PROGRAM     0xFF    // expedited bitmap of a program which can't be used, also erased flash
+
+#define PROGRAM_ADDRESS(tableIndex) ((const rom near BYTE*)(AT_PROGRAMS + (WORD)(tableIndex)*PROGRAM_SIZE))
+
+static BOOL programsValid;
+static BOOL changed;
+static TickValue changeTime;
+static BOOL compiling;
+static BYTE compileScan;        // the next event to compile
+static BOOL written;            // whether the flash image holds bytes not yet written
+
+// forward declarations
+static void startCompile(void);
+static BOOL compileStep(void);
+
+/**
+ * Compile the programs for the whole event table. Called during 
+ * initialisation after the event table and NVs are ready.
+ */
+void actionProgramInit(void) {
+    changed = FALSE;
+    startCompile();
+    while (compiling) {
+        compileStep();
+        ClrWdt();   // nothing else is running yet
+    }
+}
+
+/**
+ * Called after the event table or the IO types may have been changed. The 
+ * programs are no longer used until they have been recompiled.
+ */
+void actionProgramChanged(void) {
+    programsValid = FALSE;
+    compiling = FALSE;
+    if (written) {
+        // the next compile compares against flash so finish this block
+        flushFlashImage();
+        written = FALSE;
+    }
+    changeTime.Val = tickGet();
+    changed = TRUE;
+}
+
+/**
+ * Recompile the programs once learning has finished. Called from the main loop.
+ */
+void pollActionProgram(void) {
+    TickValue sliceStart;
+    
+    if (changed && (tickTimeSince(changeTime) > PROGRAM_SETTLE_TIME)) {
+        changed = FALSE;
+        startCompile();
+    }
+    if ( ! compiling) {
+        return;
+    }
+    sliceStart.Val = tickGet();
+    do {
+        if (compileStep()) {
+            return;     // a flash block has been written
+        }
+    } while (compiling && (tickTimeSince(sliceStart) < COMPILE_SLICE));
+}
+
+/**
+ * Queue the actions of an event from its program.
+ * @param tableIndex the event
+ * @param on TRUE for the ON actions, FALSE for the OFF actions
+ * @return FALSE if there is no usable program so the EVs must be interpreted
+ */
+BOOL runActionProgram(BYTE tableIndex, BOOL on) {
+    const rom near BYTE * program;
+    BYTE expedited;
+    BYTE i;
+    CONSUMER_ACTION_T action;
+    
+    if ( ! programsValid) {
+        return FALSE;
+    }
+    // 1Track decides whether to act upon the current section state
+    if ((NV->track_mode >= STDMODE) && (NV->track_mode <= THREEMODE)) {
+        return FALSE;
+    }
+    program = PROGRAM_ADDRESS(tableIndex);
+    if ( ! on) {
+        program += PROGRAM_SIZE/2;
+    }
+    expedited = program[0];
+    if (expedited == INVALID_PROGRAM) {
+        return FALSE;
+    }
+    for (i=0; i<MAX_PROGRAM_ACTIONS; i++) {
+        action = program[1+i];
+        if (action == NO_ACTION) {
+            break;
+        }
+        if (expedited & (1 << i)) {
+            setExpeditedActions();
+        }
+        pushAction(action);
+        setNormalActions();
+        if ((action&ACTION_MASK) >= ACTION_CONSUMER_IO_BASE) {
+            LATENCY_QUEUED(CONSUMER_IO(action&ACTION_MASK));
+        }
+    }
+    return TRUE;
+}
+
+/**
+ * Start compiling the programs from the first event. They are not used 
+ * until all have been compiled.
+ */
+static void startCompile(void) {
+    programsValid = FALSE;
+    compileScan = 0;
+    written = FALSE;
+    compiling = TRUE;
+}
+
+/**
+ * Compile the programs of the next event and write them to the flash image
+ * if they have changed. The image is written to flash at the end of each 
+ * flash block and once every event has been compiled.
+ * @return TRUE if a flash block was written
+ */
+static BOOL compileStep(void) {
+    BYTE tableIndex;
+    BYTE program[PROGRAM_SIZE];
+    const rom near BYTE * address;
+    BYTE i;
+    
+    tableIndex = compileScan;
+    if (validStart(tableIndex)) {   // unused entries are never looked up
+        if ( ! compileActionProgram(tableIndex, TRUE, program)) {
+            program[0] = INVALID_PROGRAM;
+        }
+        if ( ! compileActionProgram(tableIndex, FALSE, program+PROGRAM_SIZE/2)) {
+            program[PROGRAM_SIZE/2] = INVALID_PROGRAM;
+        }
+        address = PROGRAM_ADDRESS(tableIndex);
+        for (i=0; i<PROGRAM_SIZE; i++) {
+            if (address[i] != program[i]) {
+                writeFlashByte((BYTE*)(AT_PROGRAMS + (WORD)tableIndex*PROGRAM_SIZE + i), program[i]);
+                written = TRUE;
+            }
+        }
+    }
+    compileScan++;
+    if (compileScan >= NUM_EVENTS) {
+        compiling = FALSE;
+        programsValid = TRUE;
+    } else if ((((WORD)compileScan*PROGRAM_SIZE) % FLASH_BLOCK_SIZE) != 0) {
+        return FALSE;   // still in the same flash block
+    }
+    if ( ! written) {
+        return FALSE;
+    }
+    flushFlashImage();
+    written = FALSE;
+    return TRUE;
+}
+
+#endif
@@ -38,6 +38,10 @@
 #include "analogue.h"
 #include "cbus.h"
 #include "romops.h"
+#include "nvCache.h"
+#include "rateLimit.h"
+#include "busLoad.h"
+#include "trace.h"
 
 #ifdef ANALOGUE
 static unsigned char portInProgress;
@@ -62,6 +66,11 @@ void initAnalogue(void) {
     portInProgress = 0;
     ADCON0bits.ADON = 1;
     
+    // interrupt on conversion complete to wake the main loop
+    IPR1bits.ADIP = 0;      // low priority
+    PIR1bits.ADIF = 0;
+    PIE1bits.ADIE = 1;
+    
     setupState = SETUP_NONE;
 }
 
@@ -112,14 +121,14 @@ void pollAnalogue(void) {
                     if ((lastReading[portInProgress] < hthreshold) && (adc >= hthreshold)) {
                         if (eventState[portInProgress] != ANALOGUE_EVENT_UPPER) {
                             //High on
-                            sendProducedEvent(ACTION_IO_PRODUCER_MAGNETH(portInProgress), !(NV->io[portInProgress].flags & FLAG_RESULT_EVENT_INVERTED));
+                            queueLimitedEvent(ACTION_IO_PRODUCER_MAGNETH(portInProgress), !(NV->io[portInProgress].flags & FLAG_RESULT_EVENT_INVERTED));
                             eventState[portInProgress] = ANALOGUE_EVENT_UPPER;
                         }
                     } else if (( lastReading[portInProgress] > hhysteresis) && (adc <= hhysteresis)) {
                         if (eventState[portInProgress] == ANALOGUE_EVENT_UPPER) {
                             //High Off
                             if ( ! (NV->io[portInProgress].flags & FLAG_DISABLE_OFF)) {
-                                sendProducedEvent(ACTION_IO_PRODUCER_MAGNETH(portInProgress), NV->io[portInProgress].flags & FLAG_RESULT_EVENT_INVERTED);
+                                queueLimitedEvent(ACTION_IO_PRODUCER_MAGNETH(portInProgress), NV->io[portInProgress].flags & FLAG_RESULT_EVENT_INVERTED);
                             }
                             eventState[portInProgress] = ANALOGUE_EVENT_OFF;
                         }
@@ -134,14 +143,14 @@ void pollAnalogue(void) {
                 if (( lastReading[portInProgress] > lhysteresis) && (adc <= lhysteresis)) {
                     if (eventState[portInProgress] != ANALOGUE_EVENT_LOWER) {
                         // Low on 
-                        sendProducedEvent(ACTION_IO_PRODUCER_MAGNETL(portInProgress), !(NV->io[portInProgress].flags & FLAG_RESULT_EVENT_INVERTED));
+                        queueLimitedEvent(ACTION_IO_PRODUCER_MAGNETL(portInProgress), !(NV->io[portInProgress].flags & FLAG_RESULT_EVENT_INVERTED));
                         eventState[portInProgress] = ANALOGUE_EVENT_LOWER;
                     }
                 } else if ((lastReading[portInProgress] < lthreshold) && (adc >= lthreshold)) {
                     if (eventState[portInProgress] == ANALOGUE_EVENT_LOWER) {
                         //Low Off
                         if ( ! (NV->io[portInProgress].flags & FLAG_DISABLE_OFF)) {
-                            sendProducedEvent(ACTION_IO_PRODUCER_MAGNETL(portInProgress), NV->io[portInProgress].flags & FLAG_RESULT_EVENT_INVERTED);
+                            queueLimitedEvent(ACTION_IO_PRODUCER_MAGNETL(portInProgress), NV->io[portInProgress].flags & FLAG_RESULT_EVENT_INVERTED);
                         }
                         eventState[portInProgress] = ANALOGUE_EVENT_OFF;
                     }
@@ -154,11 +163,15 @@ void pollAnalogue(void) {
                 cbusMsg[d5] = portInProgress+1;
                 cbusMsg[d6] = ADRESH;
                 cbusMsg[d7] = ADRESL;
-                cbusSendOpcNN(ALL_CBUS, OPC_ARSON3, -1, cbusMsg);
+                if (cbusSendOpcNN(ALL_CBUS, OPC_ARSON3, -1, cbusMsg)) {
+                    busLoadFrame(OPC_ARSON3, TRUE);
+                    TRACE_FRAME(cbusMsg, TRUE);
+                }
                 if (setupState == SETUP_REPORT_AND_SAVE) {
                     // save the offset
-                    writeFlashByte((BYTE*)(AT_NV+NV_IO_MAGNET_OFFSETH(portInProgress)), cbusMsg[d6]);
-                    writeFlashByte((BYTE*)(AT_NV+NV_IO_MAGNET_OFFSETL(portInProgress)), cbusMsg[d7]);
+                    WRITE_NV(NV_IO_MAGNET_OFFSETH(portInProgress), cbusMsg[d6]);
+                    WRITE_NV(NV_IO_MAGNET_OFFSETL(portInProgress), cbusMsg[d7]);
+                    FLUSH_NV();
                 }
                 setupState = SETUP_NONE;
             }
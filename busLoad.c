@@ -0,0 +1,209 @@
+/*
+ Routines for CBUS FLiM operations - part of CBUS libraries for PIC 18F
+  This work is licensed under the:
+      Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International License.
+   To view a copy of this license, visit:
+      http://creativecommons.org/licenses/by-nc-sa/4.0/
+   or send a letter to Creative Commons, PO Box 1866, Mountain View, CA 94042, USA.
+   License summary:
+    You are free to:
+      Share, copy and redistribute the material in any medium or format
+      Adapt, remix, transform, and build upon the material
+    The licensor cannot revoke these freedoms as long as you follow the license terms.
+    Attribution : You must give appropriate credit, provide a link to the license,
+                   and indicate if changes were made. You may do so in any reasonable manner,
+                   but not in any way that suggests the licensor endorses you or your use.
+    NonCommercial : You may not use the material for commercial purposes. **(see note below)
+    ShareAlike : If you remix, transform, or build upon the material, you must distribute
+                  your contributions under the same license as the original.
+    No additional restrictions : You may not apply legal terms or technological measures that
+                                  legally restrict others from doing anything the license permits.
+   ** For commercial use, please contact the original copyright holder(s) to agree licensing terms
+**************************************************************************************************************
+	The FLiM routines have no code or definitions that are specific to any
+	module, so they can be used to provide FLiM facilities for any module 
+	using these libraries.
+	
+*/ 
+/*
+ * File:   busLoad.c
+ *
+ * Created on 18 October 2026, 22:10
+ *
+ * Counts the CAN frames received and sent and estimates how much of the 
+ * 125kbit/s bus they occupy. This is used to work out how many modules a
+ * CAN segment can carry.
+ * 
+ * The counts are kept in four 250ms buckets so the rates are over a rolling
+ * second. The number of bits for a frame is worked out from the number of 
+ * data bytes, which for CBUS is given by the top 3 bits of the opcode. A
+ * standard frame with n data bytes is 47+8n bits of which 34+8n are subject 
+ * to bit stuffing. The worst case of one stuff bit for every 4 bits is 
+ * assumed so the load is never underestimated.
+ * 
+ * Only frames which pass through the module's own code are counted: every 
+ * received frame which is taken from the receive buffers and the events,
+ * diagnostics and errors sent by the module. The load is therefore a lower
+ * bound:
+ * - frames sent from inside CBUSlib, such as the responses to NV and event
+ *   reads, QNN and the FLiM setup messages, are not counted
+ * - with CAN_FILTER the acceptance filters reject most frames for other 
+ *   modules before they reach the receive buffers. The filters are opened 
+ *   while the load is being metered, see below, so this only affects the 
+ *   first second after a request
+ * - frames lost to a receive overflow, see DIAG_CAN, are not counted
+ * 
+ * If the hbDelay NV is not zero the DIAG_BUS diagnostics are sent every 
+ * hbDelay * 100ms as a heartbeat.
+ * 
+ * The load is being metered while the heartbeat is on and for METER_TIME 
+ * after a DIAG_BUS request. The CAN filters are kept open during that time so
+ * that the frames for other modules are counted too. A module used to meter
+ * a segment should be given a heartbeat or be asked more than once.
+ */
+
+#include "module.h"
+#include "mioNv.h"
+#include "FliM.h"
+#include "TickTime.h"
+#include "diagnostics.h"
+#include "busLoad.h"
+
+#define BUS_BUCKETS         4
+#define BUS_BIT_RATE        125000
+#define BUS_BUCKET_TIME     (HUNDRED_MILI_SECOND*5/2)
+#define METER_TIME          (300*ONE_SECOND)    // metering after a DIAG_BUS request
+
+static WORD rxBucket[BUS_BUCKETS];
+static WORD txBucket[BUS_BUCKETS];
+static WORD bitBucket[BUS_BUCKETS];     // at most 31250 bits in 250ms
+static BYTE bucket;                     // the bucket being filled
+static WORD rxTotal;
+static WORD txTotal;
+static WORD rxRate;
+static WORD txRate;
+static WORD load;
+static WORD peakLoad;
+static TickValue bucketStart;
+static TickValue heartbeatTime;
+static TickValue requestTime;
+static BOOL requested;                  // a DIAG_BUS request in the last METER_TIME
+
+/**
+ * Clear the counters.
+ */
+void busLoadInit(void) {
+    BYTE b;
+    for (b=0; b<BUS_BUCKETS; b++) {
+        rxBucket[b] = 0;
+        txBucket[b] = 0;
+        bitBucket[b] = 0;
+    }
+    bucket = 0;
+    rxTotal = 0;
+    txTotal = 0;
+    rxRate = 0;
+    txRate = 0;
+    load = 0;
+    peakLoad = 0;
+    bucketStart.Val = tickGet();
+    heartbeatTime.Val = bucketStart.Val;
+    requested = FALSE;
+}
+
+/**
+ * Count a frame.
+ * @param opc the CBUS opcode of the frame
+ * @param transmitted TRUE if sent by this module, FALSE if received
+ */
+void busLoadFrame(BYTE opc, BOOL transmitted) {
+    BYTE dataBits;
+    
+    dataBits = ((opc >> 5) + 1) << 3;   // opcode plus data bytes
+    bitBucket[bucket] += 47 + dataBits + (33 + dataBits)/4;
+    if (transmitted) {
+        txBucket[bucket]++;
+        txTotal++;
+    } else {
+        rxBucket[bucket]++;
+        rxTotal++;
+    }
+}
+
+/**
+ * Move on to the next bucket every 250ms and send the heartbeat when due.
+ * Called from the main loop.
+ */
+void pollBusLoad(void) {
+    BYTE b;
+    DWORD bits;
+    
+    if (tickTimeSince(bucketStart) >= BUS_BUCKET_TIME) {
+        bucketStart.Val = tickGet();
+        rxRate = 0;
+        txRate = 0;
+        bits = 0;
+        for (b=0; b<BUS_BUCKETS; b++) {
+            rxRate += rxBucket[b];
+            txRate += txBucket[b];
+            bits += bitBucket[b];
+        }
+        load = (WORD)(bits / (BUS_BIT_RATE/1000));
+        if (load > peakLoad) {
+            peakLoad = load;
+        }
+        bucket = (bucket+1) & (BUS_BUCKETS-1);
+        rxBucket[bucket] = 0;
+        txBucket[bucket] = 0;
+        bitBucket[bucket] = 0;
+    }
+    if ((NV->hbDelay != 0) && (tickTimeSince(heartbeatTime) >= (DWORD)NV->hbDelay * HUNDRED_MILI_SECOND)) {
+        // if a diagnostic request is being answered try again next time
+        if (diagnosticsSend(DIAG_BUS)) {
+            heartbeatTime.Val = tickGet();
+        }
+    }
+}
+
+/**
+ * Get a DIAG_BUS diagnostic.
+ * @param code the BUS_xxx code
+ * @param value where to put the value
+ * @return TRUE if a valid code
+ */
+BOOL getBusDiagnostic(BYTE code, WORD * value) {
+    requestTime.Val = tickGet();
+    requested = TRUE;
+    switch (code) {
+        case BUS_RX_RATE:
+            *value = rxRate;
+            return TRUE;
+        case BUS_TX_RATE:
+            *value = txRate;
+            return TRUE;
+        case BUS_LOAD:
+            *value = load;
+            return TRUE;
+        case BUS_PEAK_LOAD:
+            *value = peakLoad;
+            return TRUE;
+        case BUS_RX_FRAMES:
+            *value = rxTotal;
+            return TRUE;
+        case BUS_TX_FRAMES:
+            *value = txTotal;
+            return TRUE;
+    }
+    return FALSE;
+}
+
+/**
+ * Whether the load is being metered so every frame should be received.
+ * @return TRUE if the heartbeat is on or there was a recent DIAG_BUS request
+ */
+BOOL busLoadMetering(void) {
+    if (requested && (tickTimeSince(requestTime) >= METER_TIME)) {
+        requested = FALSE;
+    }
+    return (NV->hbDelay != 0) || requested;
+}
@@ -0,0 +1,67 @@
+/*
+ Routines for CBUS FLiM operations - part of CBUS libraries for PIC 18F
+  This work is licensed under the:
+      Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International License.
+   To view a copy of this license, visit:
+      http://creativecommons.org/licenses/by-nc-sa/4.0/
+   or send a letter to Creative Commons, PO Box 1866, Mountain View, CA 94042, USA.
+   License summary:
+    You are free to:
+      Share, copy and redistribute the material in any medium or format
+      Adapt, remix, transform, and build upon the material
+    The licensor cannot revoke these freedoms as long as you follow the license terms.
+    Attribution : You must give appropriate credit, provide a link to the license,
+                   and indicate if changes were made. You may do so in any reasonable manner,
+                   but not in any way that suggests the licensor endorses you or your use.
+    NonCommercial : You may not use the material for commercial purposes. **(see note below)
+    ShareAlike : If you remix, transform, or build upon the material, you must distribute
+                  your contributions under the same license as the original.
+    No additional restrictions : You may not apply legal terms or technological measures that
+                                  legally restrict others from doing anything the license permits.
+   ** For commercial use, please contact the original copyright holder(s) to agree licensing terms
+**************************************************************************************************************
+	The FLiM routines have no code or definitions that are specific to any
+	module, so they can be used to provide FLiM facilities for any module 
+	using these libraries.
+	
+*/ 
+/* 
+ * File:   busLoad.h
+ *
+ * Created on 18 October 2026, 22:10
+ *
+ * CAN frame counters and an estimate of the bus load over the last second.
+ * Frames sent by CBUSlib itself are not seen so the load is a lower bound.
+ * The CAN filters are kept open while the load is being metered.
+ */
+
+#ifndef BUSLOAD_H
+#define	BUSLOAD_H
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+#include "GenericTypeDefs.h"
+
+/*
+ * Codes for the DIAG_BUS diagnostic service
+ */
+#define BUS_RX_RATE         1   // frames received in the last second
+#define BUS_TX_RATE         2   // frames sent in the last second
+#define BUS_LOAD            3   // bus occupancy in the last second in tenths of a percent
+#define BUS_PEAK_LOAD       4   // highest BUS_LOAD seen
+#define BUS_RX_FRAMES       5   // total frames received, wraps
+#define BUS_TX_FRAMES       6   // total frames sent, wraps
+
+extern void busLoadInit(void);
+extern void busLoadFrame(BYTE opc, BOOL transmitted);
+extern void pollBusLoad(void);
+extern BOOL getBusDiagnostic(BYTE code, WORD * value);
+extern BOOL busLoadMetering(void);
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif	/* BUSLOAD_H */
@@ -0,0 +1,395 @@
+/*
+ Routines for CBUS FLiM operations - part of CBUS libraries for PIC 18F
+  This work is licensed under the:
+      Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International License.
+   To view a copy of this license, visit:
+      http://creativecommons.org/licenses/by-nc-sa/4.0/
+   or send a letter to Creative Commons, PO Box 1866, Mountain View, CA 94042, USA.
+   License summary:
+    You are free to:
+      Share, copy and redistribute the material in any medium or format
+      Adapt, remix, transform, and build upon the material
+    The licensor cannot revoke these freedoms as long as you follow the license terms.
+    Attribution : You must give appropriate credit, provide a link to the license,
+                   and indicate if changes were made. You may do so in any reasonable manner,
+                   but not in any way that suggests the licensor endorses you or your use.
+    NonCommercial : You may not use the material for commercial purposes. **(see note below)
+    ShareAlike : If you remix, transform, or build upon the material, you must distribute
+                  your contributions under the same license as the original.
+    No additional restrictions : You may not apply legal terms or technological measures that
+                                  legally restrict others from doing anything the license permits.
+   ** For commercial use, please contact the original copyright holder(s) to agree licensing terms
+**************************************************************************************************************
+	The FLiM routines have no code or definitions that are specific to any
+	module, so they can be used to provide FLiM facilities for any module 
+	using these libraries.
+	
+*/ 
+/*
+ * File:   canFilter.c
+ *
+ * Created on 19 October 2026, 09:15
+ *
+ * Uses the ECAN acceptance filters so that accessory events which can't 
+ * match a learned event are rejected by the hardware and never interrupt or
+ * get looked up. 
+ * 
+ * In ECAN mode 1 and 2 the filters can compare the first 18 data bits of a
+ * standard frame: the opcode, the node number high byte and the top 2 bits
+ * of the node number low byte. A filter can therefore select an accessory 
+ * event by its NN in blocks of 64 node numbers. There are 16 filters and 3
+ * masks (mask 0, mask 1 and filter 15 used as a mask) and these are used as:
+ * 
+ *  Filters 0-6 with mask 0 (opcode & 0xE0) accept opcodes 0x00-0x7F and 0xA0-0xFF
+ *  Filters 7-9 with filter 15 (opcode & 0xE6) accept 0x82-0x87, 0x8A-0x8F, 
+ *      0x92-0x97 and 0x9A-0x9F
+ *  Filters 10-14 with mask 1 (opcode & 0xF6 and the NN bits) accept 
+ *      ACON/ACOF/ASON/ASOF from up to 5 blocks of node numbers
+ * 
+ * Opcodes 0x80, 0x81, 0x88 and 0x89 are not accepted. Only 0x80 RDCC4 is 
+ * defined and the module doesn't use it.
+ * 
+ * The NN bits of mask 1 are shared by the 5 accessory filters so if the 
+ * learned events come from more than 5 blocks the blocks are made bigger 
+ * until they fit. A learned short event may be sent by any node so then all
+ * accessory events are accepted. The saving therefore depends on how the 
+ * layout's node numbers are spread, see the report from tests/test_canFilter.c.
+ * 
+ * Changing the filters needs the ECAN in configuration mode. So that a burst
+ * of learning doesn't keep doing that, and so a newly learned event isn't 
+ * rejected, the first change opens the filters to accept everything and the 
+ * new filters are set up once the event table hasn't changed for a second.
+ * If CBUSlib has left the ECAN in legacy mode 0 the filters are not touched.
+ * 
+ * The ECAN only changes mode between frames. If it hasn't changed within
+ * MODE_TIMEOUT the request is withdrawn, the filters are left as they were
+ * and the failure is counted in DIAG_CAN CAN_FILTER_FAILURES. A failure to 
+ * set up the filters leaves filtering off; a failure to open them leaves the
+ * old filters in use until they are next set up.
+ * 
+ * Frames rejected by the filters are not seen by the bus load meter so the
+ * filters are opened while busLoadMetering() says the load is being metered,
+ * that is while the hbDelay heartbeat is on or after a DIAG_BUS request, and
+ * set up again a second after metering stops.
+ */
+
+#include "devincs.h"
+#include "module.h"
+#include "events.h"
+#include "TickTime.h"
+#include "canFilter.h"
+#include "busLoad.h"
+
+#ifdef CAN_FILTER
+
+#define NUM_NN_FILTERS      5
+#define FIRST_NN_FILTER     10
+#define NN_KEY_BITS         10      // NN high byte and top 2 bits of the low byte
+#define FILTER_SETTLE_TIME  ONE_SECOND
+#define MODE_TIMEOUT        (10*ONE_MILI_SECOND)    // several maximum length frames at 125Kbit/s
+
+#define SET_FILTER(n, sidl, eidh, eidl)     RXF##n##SIDH = 0; RXF##n##SIDL = (sidl); RXF##n##EIDH = (eidh); RXF##n##EIDL = (eidl)
+#define SET_NN_FILTER(n, key)               SET_FILTER(n, (key) & 0x03, OPC_ACON, (key) >> 2)
+
+static WORD nnKey[NUM_NN_FILTERS];  // the NN blocks accepted
+static BYTE nnFilters;              // number of NN filters in use
+static BYTE nnBits;                 // number of NN bits compared
+static BOOL filtering;              // the filters are in use
+static BOOL changed;                // the event table has changed since the filters were set up
+static TickValue changeTime;
+static BOOL metering;               // the filters are held open for the bus load meter
+static WORD modeFailures;           // times the ECAN didn't change mode
+
+// forward declarations
+static BOOL collectNNs(void);
+static void setFilters(void);
+static void openFilters(void);
+static BOOL configMode(BYTE reqop);
+static BOOL normalMode(BYTE reqop);
+static BOOL waitMode(BYTE mode);
+
+/**
+ * Set up the filters for the events in the table. Called during initialisation.
+ */
+void canFilterInit(void) {
+    changed = FALSE;
+    filtering = FALSE;
+    metering = FALSE;
+    modeFailures = 0;
+    if (collectNNs()) {
+        setFilters();
+    }
+}
+
+/**
+ * Called after the event table may have been changed by learning, 
+ * unlearning or an IO type change.
+ */
+void canFilterChanged(void) {
+    changeTime.Val = tickGet();
+    changed = TRUE;
+    if (filtering) {
+        openFilters();
+    }
+}
+
+/**
+ * Set up the filters once learning has finished and keep them open while the 
+ * bus load is being metered. Called from the main loop.
+ */
+void pollCanFilter(void) {
+    if (busLoadMetering()) {
+        // keep trying if the ECAN didn't change mode
+        if (filtering) {
+            openFilters();
+        }
+        metering = TRUE;
+        return;
+    }
+    if (metering) {
+        metering = FALSE;
+        changeTime.Val = tickGet();
+        changed = TRUE;
+    }
+    if (changed && (tickTimeSince(changeTime) > FILTER_SETTLE_TIME)) {
+        changed = FALSE;
+        if (collectNNs()) {
+            setFilters();
+        }
+    }
+}
+
+/**
+ * The filter state for the DIAG_CAN CAN_FILTERS diagnostic.
+ * @return CAN_FILTER_OFF if everything is accepted otherwise the number of 
+ * NN bits compared in the high byte and the number of NN filters in the low byte
+ */
+WORD getCanFilterState(void) {
+    if ( ! filtering) return CAN_FILTER_OFF;
+    return ((WORD)nnBits << 8) | nnFilters;
+}
+
+/**
+ * The number of times the filters couldn't be changed for the DIAG_CAN 
+ * CAN_FILTER_FAILURES diagnostic.
+ * @return the number of failures
+ */
+WORD getCanFilterFailures(void) {
+    return modeFailures;
+}
+
+/**
+ * Work out the blocks of node numbers of the learned consumed events.
+ * @return FALSE if the ECAN is in legacy mode and can't be filtered
+ */
+static BOOL collectNNs(void) {
+    BYTE tableIndex;
+    BYTE e;
+    BYTE f;
+    WORD key;
+    BOOL consumed;
+    
+    if (ECANCONbits.MDSEL == 0) return FALSE;
+    
+    nnBits = NN_KEY_BITS;
+    nnFilters = 0;
+    for (tableIndex=0; tableIndex<NUM_EVENTS; tableIndex++) {
+        if ( ! validStart(tableIndex)) continue;
+        if (getEVs(tableIndex) != 0) continue;
+        // EV#0 is for produced event so only interested if there are consumer actions
+        consumed = FALSE;
+        for (e=1; e<EVperEVT; e++) {
+            if (evs[e] != NO_ACTION) {
+                consumed = TRUE;
+                break;
+            }
+        }
+        if ( ! consumed) continue;
+        if (getNN(tableIndex) == 0) {
+            // a short event, can come from any node
+            nnBits = 0;
+            break;
+        }
+        key = (getNN(tableIndex) >> (16 - NN_KEY_BITS)) & ~((1 << (NN_KEY_BITS - nnBits)) - 1);
+        for (f=0; f<nnFilters; f++) {
+            if (nnKey[f] == key) break;
+        }
+        if (f < nnFilters) continue;    // already have this block
+        if (nnFilters < NUM_NN_FILTERS) {
+            nnKey[nnFilters++] = key;
+            continue;
+        }
+        // too many blocks so make them bigger until this one fits
+        while (f >= NUM_NN_FILTERS) {
+            nnBits--;
+            key &= ~(1 << (NN_KEY_BITS - nnBits - 1));
+            nnFilters = 0;
+            for (f=0; f<NUM_NN_FILTERS; f++) {
+                nnKey[f] &= ~(1 << (NN_KEY_BITS - nnBits - 1));
+                for (e=0; e<nnFilters; e++) {
+                    if (nnKey[e] == nnKey[f]) break;
+                }
+                if (e == nnFilters) {
+                    nnKey[nnFilters++] = nnKey[f];
+                }
+            }
+            for (f=0; f<nnFilters; f++) {
+                if (nnKey[f] == key) break;
+            }
+            if ((f == nnFilters) && (nnFilters < NUM_NN_FILTERS)) {
+                nnKey[nnFilters++] = key;
+            }
+        }
+    }
+    if (nnBits == 0) {
+        // every accessory event is accepted
+        nnFilters = 1;
+        nnKey[0] = 0;
+    }
+    return TRUE;
+}
+
+/**
+ * Program the filters from the NN blocks.
+ */
+static void setFilters(void) {
+    BYTE reqop;
+    BYTE buffer;
+    WORD nnMask;
+    
+    reqop = CANCONbits.REQOP;
+    if ( ! configMode(reqop)) {
+        filtering = FALSE;
+        return;
+    }
+    
+    // keep the receive buffer CBUSlib associated with filter 0
+    buffer = RXFBCON0 & 0x0F;
+    buffer |= buffer << 4;
+    RXFBCON0 = buffer;
+    RXFBCON1 = buffer;
+    RXFBCON2 = buffer;
+    RXFBCON3 = buffer;
+    RXFBCON4 = buffer;
+    RXFBCON5 = buffer;
+    RXFBCON6 = buffer;
+    RXFBCON7 = buffer;
+    
+    // compare the opcode, NN high and 2 bits of NN low
+    SDFLC = 18;
+    // standard frames only
+    RXM0SIDH = 0;
+    RXM0SIDL = 0x08;
+    RXM0EIDH = 0xE0;
+    RXM0EIDL = 0;
+    RXF15SIDH = 0;
+    RXF15SIDL = 0x08;
+    RXF15EIDH = 0xE6;
+    RXF15EIDL = 0;
+    nnMask = ~((1 << (NN_KEY_BITS - nnBits)) - 1) & ((1 << NN_KEY_BITS) - 1);
+    RXM1SIDH = 0;
+    RXM1SIDL = 0x08 | (nnMask & 0x03);
+    RXM1EIDH = 0xF6;
+    RXM1EIDL = nnMask >> 2;
+    
+    SET_FILTER(0, 0, 0x00, 0);
+    SET_FILTER(1, 0, 0x20, 0);
+    SET_FILTER(2, 0, 0x40, 0);
+    SET_FILTER(3, 0, 0x60, 0);
+    SET_FILTER(4, 0, 0xA0, 0);
+    SET_FILTER(5, 0, 0xC0, 0);
+    SET_FILTER(6, 0, 0xE0, 0);
+    SET_FILTER(7, 0, 0x82, 0);
+    SET_FILTER(8, 0, 0x84, 0);
+    SET_FILTER(9, 0, 0x86, 0);
+    SET_NN_FILTER(10, nnKey[0]);
+    SET_NN_FILTER(11, nnKey[1]);
+    SET_NN_FILTER(12, nnKey[2]);
+    SET_NN_FILTER(13, nnKey[3]);
+    SET_NN_FILTER(14, nnKey[4]);
+    
+    // filters 0-6 mask 0, 7-9 filter 15, 10-14 mask 1
+    MSEL0 = 0x00;
+    MSEL1 = 0x80;
+    MSEL2 = 0x5A;
+    MSEL3 = 0x15;
+    RXFCON0 = 0xFF;
+    RXFCON1 = 0x03 | (((1 << nnFilters) - 1) << (FIRST_NN_FILTER - 8));
+    
+    filtering = TRUE;
+    if ( ! normalMode(reqop)) {
+        // still in configuration mode so turn the filters off again
+        RXFCON0 = 0x01;
+        RXFCON1 = 0;
+        SDFLC = 0;
+        RXM0SIDL = 0;
+        RXM0EIDH = 0;
+        filtering = FALSE;
+    }
+}
+
+/**
+ * Accept every frame.
+ */
+static void openFilters(void) {
+    BYTE reqop;
+    
+    reqop = CANCONbits.REQOP;
+    if ( ! configMode(reqop)) return;
+    SDFLC = 0;
+    RXM0SIDH = 0;
+    RXM0SIDL = 0;
+    RXM0EIDH = 0;
+    RXM0EIDL = 0;
+    MSEL0 = 0x00;
+    RXFCON0 = 0x01;     // filter 0 with mask 0 accepts everything
+    RXFCON1 = 0;
+    filtering = FALSE;
+    normalMode(reqop);
+}
+
+/**
+ * Put the ECAN into configuration mode. Waits for any frame in progress to finish.
+ * @param reqop the current REQOP to go back to if it doesn't change
+ * @return FALSE if the ECAN is in legacy mode or didn't change mode
+ */
+static BOOL configMode(BYTE reqop) {
+    if (ECANCONbits.MDSEL == 0) return FALSE;
+    CANCONbits.REQOP = 4;
+    if ( ! waitMode(4)) {
+        CANCONbits.REQOP = reqop;
+        return FALSE;
+    }
+    return TRUE;
+}
+
+/**
+ * Put the ECAN back into the mode it was in.
+ * @param reqop the previous REQOP
+ * @return FALSE if the ECAN didn't change mode
+ */
+static BOOL normalMode(BYTE reqop) {
+    CANCONbits.REQOP = reqop;
+    return waitMode(reqop);
+}
+
+/**
+ * Wait for the ECAN to change mode, counting a failure if it doesn't within
+ * MODE_TIMEOUT.
+ * @param mode the OPMODE to wait for
+ * @return TRUE if the ECAN is in the mode
+ */
+static BOOL waitMode(BYTE mode) {
+    TickValue start;
+    
+    start.Val = tickGet();
+    while (CANSTATbits.OPMODE != mode) {
+        if (tickTimeSince(start) > MODE_TIMEOUT) {
+            if (modeFailures != 0xFFFF) modeFailures++;
+            return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+#endif
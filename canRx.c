@@ -0,0 +1,125 @@
+/*
+ Routines for CBUS FLiM operations - part of CBUS libraries for PIC 18F
+  This work is licensed under the:
+      Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International License.
+   To view a copy of this license, visit:
+      http://creativecommons.org/licenses/by-nc-sa/4.0/
+   or send a letter to Creative Commons, PO Box 1866, Mountain View, CA 94042, USA.
+   License summary:
+    You are free to:
+      Share, copy and redistribute the material in any medium or format
+      Adapt, remix, transform, and build upon the material
+    The licensor cannot revoke these freedoms as long as you follow the license terms.
+    Attribution : You must give appropriate credit, provide a link to the license,
+                   and indicate if changes were made. You may do so in any reasonable manner,
+                   but not in any way that suggests the licensor endorses you or your use.
+    NonCommercial : You may not use the material for commercial purposes. **(see note below)
+    ShareAlike : If you remix, transform, or build upon the material, you must distribute
+                  your contributions under the same license as the original.
+    No additional restrictions : You may not apply legal terms or technological measures that
+                                  legally restrict others from doing anything the license permits.
+   ** For commercial use, please contact the original copyright holder(s) to agree licensing terms
+**************************************************************************************************************
+	The FLiM routines have no code or definitions that are specific to any
+	module, so they can be used to provide FLiM facilities for any module 
+	using these libraries.
+	
+*/ 
+/*
+ * File:   canRx.c
+ *
+ * Created on 19 October 2026, 11:40
+ *
+ * Drains the CAN receive path from the main loop. Each frame is handled by 
+ * receiveCBUS() in main.c. Up to CAN_RX_BUDGET frames are handled per call
+ * and draining also stops once the next servo slot is due so servo pulses 
+ * are not delayed by a burst of traffic.
+ * 
+ * Kept apart from main.c so that tests/bench_canRx.c can run it against a
+ * burst of frames on the host.
+ */
+
+#include "devincs.h"
+#include "module.h"
+#include "TickTime.h"
+#include "scheduler.h"
+#include "diagnostics.h"
+#include "trace.h"
+#include "canFilter.h"
+#include "canRx.h"
+
+/*
+ * Receive path statistics
+ */
+static WORD rxOverflows;        // times the CAN receive buffers overflowed
+static BYTE maxBacklog;         // most frames drained by a single checkCBUS
+static WORD budgetExhausted;    // times checkCBUS stopped with frames possibly still waiting
+
+/**
+ * Clear the receive path statistics.
+ */
+void canRxInit(void) {
+    rxOverflows = 0;
+    maxBacklog = 0;
+    budgetExhausted = 0;
+}
+
+/**
+ * Drain the messages received on the CBUS and process them. Up to 
+ * CAN_RX_BUDGET messages are handled per call. Draining also stops once the
+ * next servo slot is due so servo pulses are not delayed by a burst of traffic.
+ * @return true if there may be more messages waiting.
+ */
+BOOL checkCBUS( void ) {
+    BYTE frames;
+    
+    if (COMSTAT & 0x40) {
+        // RXBnOVFL receive buffer overflow
+        if (rxOverflows != 0xFFFF) rxOverflows++;
+        TRACE_FAULT(TRACE_FROZEN_RX);
+        COMSTAT &= ~0x40;
+    }
+    for (frames=0; frames<CAN_RX_BUDGET; ) {
+        if ( ! receiveCBUS()) {
+            // all drained
+            if (frames > maxBacklog) maxBacklog = frames;
+            return FALSE;
+        }
+        frames++;
+        if (schedulerDue(TASK_SERVO, tickGet())) {
+            break;
+        }
+    }
+    if (frames > maxBacklog) maxBacklog = frames;
+    if (budgetExhausted != 0xFFFF) budgetExhausted++;
+    return TRUE;
+}
+
+/**
+ * Get a DIAG_CAN diagnostic.
+ * @param code the CAN_xxx code
+ * @param value where to put the value
+ * @return TRUE if a valid code
+ */
+BOOL getCanDiagnostic(BYTE code, WORD * value) {
+    switch (code) {
+        case CAN_RX_OVERFLOWS:
+            *value = rxOverflows;
+            return TRUE;
+        case CAN_MAX_BACKLOG:
+            *value = maxBacklog;
+            return TRUE;
+        case CAN_BUDGET_EXHAUSTED:
+            *value = budgetExhausted;
+            return TRUE;
+#ifdef CAN_FILTER
+        case CAN_FILTERS:
+            *value = getCanFilterState();
+            return TRUE;
+        case CAN_FILTER_FAILURES:
+            *value = getCanFilterFailures();
+            return TRUE;
+#endif
+    }
+    return FALSE;
+}
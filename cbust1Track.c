@@ -9,10 +9,10 @@
  *      where 3-rail is typically Mrklin and 2-rail most other H0 vendors. 
  * 2- Allow the modification of a produced event's Event Number
  * 3- Allow not taking action on a consumed ACON event
- * 4- Introduces an extra config option using NV spare 10 so the appropriate 1Track operating mode can be set
- *      If the spare 10 value is outside the range of 0x81 - 0x83 then the node will operate like a standard CANMIO
+ * 4- Introduces an extra config option using NV 15 (track_mode) so the appropriate 1Track operating mode can be set
+ *      If the track_mode value is outside the range of 0x81 - 0x83 then the node will operate like a standard CANMIO
  * 
- * Features 2 and 3 should be generic as well as 4, the use of spare 10, so that anyone who wishes to run local logic can
+ * Features 2 and 3 should be generic as well as 4, the use of NV 15, so that anyone who wishes to run local logic can
  * leverage the extra features with little effort. This is also why the extra class of eventMods and it's header file have been created.
  * 
  * Created on 9 Feb 2019, 16:26
@@ -153,13 +153,13 @@ unsigned char ticTac(void){
 
 void getTrackMode(void){
     
-    if ((NV->spare[10] != RLMODE) && (NV->spare[10] != THREEMODE)){
+    if ((NV->track_mode != RLMODE) && (NV->track_mode != THREEMODE)){
         trackMode = 0;        
     }
-    if (NV->spare[10] == RLMODE){
+    if (NV->track_mode == RLMODE){
         trackMode = 1;
     }
-    if (NV->spare[10] == THREEMODE){
+    if (NV->track_mode == THREEMODE){
         trackMode = 2;        
     }    
 }
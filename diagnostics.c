@@ -0,0 +1,186 @@
+/*
+ Routines for CBUS FLiM operations - part of CBUS libraries for PIC 18F
+  This work is licensed under the:
+      Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International License.
+   To view a copy of this license, visit:
+      http://creativecommons.org/licenses/by-nc-sa/4.0/
+   or send a letter to Creative Commons, PO Box 1866, Mountain View, CA 94042, USA.
+   License summary:
+    You are free to:
+      Share, copy and redistribute the material in any medium or format
+      Adapt, remix, transform, and build upon the material
+    The licensor cannot revoke these freedoms as long as you follow the license terms.
+    Attribution : You must give appropriate credit, provide a link to the license,
+                   and indicate if changes were made. You may do so in any reasonable manner,
+                   but not in any way that suggests the licensor endorses you or your use.
+    NonCommercial : You may not use the material for commercial purposes. **(see note below)
+    ShareAlike : If you remix, transform, or build upon the material, you must distribute
+                  your contributions under the same license as the original.
+    No additional restrictions : You may not apply legal terms or technological measures that
+                                  legally restrict others from doing anything the license permits.
+   ** For commercial use, please contact the original copyright holder(s) to agree licensing terms
+**************************************************************************************************************
+	The FLiM routines have no code or definitions that are specific to any
+	module, so they can be used to provide FLiM facilities for any module 
+	using these libraries.
+	
+*/ 
+/*
+ * File:   diagnostics.c
+ *
+ * Created on 18 October 2026, 14:30
+ *
+ * Handles the RDGN request. Each service supplies a function which returns
+ * the 16 bit value for a diagnostic code. A request for a single code is 
+ * answered with one DGN. A request for all codes of a service is streamed
+ * from diagnosticsPoll() as the CAN transmit buffers allow so a long answer
+ * doesn't hold up the main loop.
+ */
+
+#include "module.h"
+#include "cbus.h"
+#include "diagnostics.h"
+#include "pendingWork.h"
+#include "supervisor.h"
+#include "txQueue.h"
+#include "rateLimit.h"
+#include "busLoad.h"
+#include "trace.h"
+#include "latency.h"
+#include "evCache.h"
+#include "eventFilter.h"
+#include "learnSession.h"
+#include "eventCompact.h"
+#include "eventIndex.h"
+#include "canRx.h"
+#ifdef PROFILE
+#include "profile.h"
+#endif
+
+static BYTE diagService;     // the service currently being answered, 0 if none
+static BYTE diagCode;        // the next code to be sent
+static BOOL diagAll;         // whether all the codes of the service are being sent
+
+// forward declarations
+static BOOL getDiagnostic(BYTE service, BYTE code, WORD * value);
+
+void diagnosticsInit(void) {
+    diagService = 0;
+}
+
+/**
+ * Handle an RDGN addressed to this node.
+ * @param msg the received CBUS message
+ */
+void diagnosticsRequest(BYTE * msg) {
+    diagService = msg[d3];
+    diagCode = msg[d4];
+#ifdef TRACE
+    if (diagService == DIAG_TRACE) {
+        diagCode = traceRequest(diagCode);
+    }
+#endif
+    diagAll = (diagCode == DIAG_ALL_CODES);
+    if (diagAll) {
+        diagCode = 1;
+    }
+}
+
+/**
+ * Send all the codes of a service without a request, such as for a heartbeat.
+ * @param service the diagnostic service
+ * @return FALSE if a request is still being answered
+ */
+BOOL diagnosticsSend(BYTE service) {
+    if (diagService != 0) {
+        return FALSE;
+    }
+    diagService = service;
+    diagCode = 1;
+    diagAll = TRUE;
+    return TRUE;
+}
+
+/**
+ * Send any outstanding DGN responses. Called from the main loop.
+ * Stops as soon as the transmit buffers are full and carries on next time.
+ */
+void diagnosticsPoll(void) {
+    WORD value;
+    
+    while (diagService != 0) {
+        if (getDiagnostic(diagService, diagCode, &value)) {
+            cbusMsg[d3] = diagService;
+            cbusMsg[d4] = diagCode;
+            cbusMsg[d5] = value >> 8;
+            cbusMsg[d6] = value & 0xFF;
+            if ( ! cbusSendOpcMyNN(0, OPC_DGN, cbusMsg)) {
+                return; // try again later
+            }
+            busLoadFrame(OPC_DGN, TRUE);
+            TRACE_FRAME(cbusMsg, TRUE);
+        }
+        if (( ! diagAll) || (diagCode == 0xFF)) {
+            diagService = 0;    // finished
+        } else {
+            diagCode++;
+        }
+    }
+}
+
+/**
+ * Get the value of a diagnostic.
+ * @param service the diagnostic service
+ * @param code the diagnostic code within the service
+ * @param value where to put the value
+ * @return TRUE if the service has this code
+ */
+static BOOL getDiagnostic(BYTE service, BYTE code, WORD * value) {
+    switch (service) {
+#ifdef PROFILE
+        case DIAG_PROFILE:
+            return getProfileDiagnostic(code, value);
+#endif
+        case DIAG_LOOP:
+            return getLoopDiagnostic(code, value);
+        case DIAG_SUPERVISOR:
+            return getSupervisorDiagnostic(code, value);
+        case DIAG_CAN:
+            return getCanDiagnostic(code, value);
+        case DIAG_TX:
+            return getTxDiagnostic(code, value);
+        case DIAG_RATE_LIMIT:
+            return getRateLimitDiagnostic(code, value);
+        case DIAG_BUS:
+            return getBusDiagnostic(code, value);
+#ifdef TRACE
+        case DIAG_TRACE:
+            return getTraceDiagnostic(code, value);
+#endif
+#ifdef LATENCY
+        case DIAG_LATENCY:
+            return getLatencyDiagnostic(code, value);
+#endif
+#ifdef EV_CACHE
+        case DIAG_EV_CACHE:
+            return getEvCacheDiagnostic(code, value);
+#endif
+#ifdef EVENT_FILTER
+        case DIAG_EVENT_FILTER:
+            return getEventFilterDiagnostic(code, value);
+#endif
+#ifdef LEARN_SESSION
+        case DIAG_LEARN:
+            return getLearnDiagnostic(code, value);
+#endif
+#ifdef EVENT_COMPACTION
+        case DIAG_EVENT_TABLE:
+            return getEventTableDiagnostic(code, value);
+#endif
+#ifdef EVENT_INDEX
+        case DIAG_EVENT_INDEX:
+            return getEventIndexDiagnostic(code, value);
+#endif
+    }
+    return FALSE;
+}
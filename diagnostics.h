@@ -0,0 +1,92 @@
+/*
+ Routines for CBUS FLiM operations - part of CBUS libraries for PIC 18F
+  This work is licensed under the:
+      Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International License.
+   To view a copy of this license, visit:
+      http://creativecommons.org/licenses/by-nc-sa/4.0/
+   or send a letter to Creative Commons, PO Box 1866, Mountain View, CA 94042, USA.
+   License summary:
+    You are free to:
+      Share, copy and redistribute the material in any medium or format
+      Adapt, remix, transform, and build upon the material
+    The licensor cannot revoke these freedoms as long as you follow the license terms.
+    Attribution : You must give appropriate credit, provide a link to the license,
+                   and indicate if changes were made. You may do so in any reasonable manner,
+                   but not in any way that suggests the licensor endorses you or your use.
+    NonCommercial : You may not use the material for commercial purposes. **(see note below)
+    ShareAlike : If you remix, transform, or build upon the material, you must distribute
+                  your contributions under the same license as the original.
+    No additional restrictions : You may not apply legal terms or technological measures that
+                                  legally restrict others from doing anything the license permits.
+   ** For commercial use, please contact the original copyright holder(s) to agree licensing terms
+**************************************************************************************************************
+	The FLiM routines have no code or definitions that are specific to any
+	module, so they can be used to provide FLiM facilities for any module 
+	using these libraries.
+	
+*/ 
+/* 
+ * File:   diagnostics.h
+ *
+ * Created on 18 October 2026, 14:30
+ *
+ * Diagnostic data requested over CBUS using RDGN and returned with DGN.
+ */
+
+#ifndef DIAGNOSTICS_H
+#define	DIAGNOSTICS_H
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+#include "GenericTypeDefs.h"
+
+/*
+ * These opcodes are not in all versions of cbusdefs so define them here if needed.
+ */
+#ifndef OPC_RDGN
+#define OPC_RDGN    0x87    // Request diagnostics <NN hi><NN lo><service><code>
+#endif
+#ifndef OPC_DGN
+#define OPC_DGN     0xC7    // Diagnostic data <NN hi><NN lo><service><code><value hi><value lo>
+#endif
+
+/*
+ * The diagnostic services. A request for code 0 returns every code of the service.
+ */
+#define DIAG_ALL_CODES      0
+#define DIAG_PROFILE        1   // Task execution times. Code is (task<<4)|PROFILE_xxx
+#define DIAG_LOOP           2   // Main loop utilisation. Code is LOOP_xxx
+#define DIAG_SUPERVISOR     3   // Overruns and missed slots. Code is SUPER_xxx
+#define DIAG_CAN            4   // CAN receive path. Code is CAN_xxx
+#define DIAG_TX             5   // Produced event transmit queue. Code is TX_xxx
+#define DIAG_RATE_LIMIT     6   // Produced events suppressed by the rate limit. Code is IO+1
+#define DIAG_BUS            7   // CAN frame rates and bus load, a lower bound. Code is BUS_xxx
+#define DIAG_TRACE          8   // Trace of the last CAN frames. Code is frame*6+word+1 or TRACE_xxx
+#define DIAG_LATENCY        9   // Event received to output acting. Code is LATENCY_xxx
+#define DIAG_EV_CACHE       10  // Consumed event EV cache. Code is EV_CACHE_xxx
+#define DIAG_EVENT_FILTER   11  // Received event Bloom filter. Code is EVENT_FILTER_xxx
+#define DIAG_LEARN          12  // Event learning flash writes. Code is LEARN_xxx
+#define DIAG_EVENT_TABLE    13  // Event table use and compaction. Code is EVENT_TABLE_xxx
+#define DIAG_EVENT_INDEX    14  // Perfect hash event index. Code is EVENT_INDEX_xxx
+
+/*
+ * Codes for the DIAG_CAN service
+ */
+#define CAN_RX_OVERFLOWS        1   // times the receive buffers overflowed
+#define CAN_MAX_BACKLOG         2   // most frames drained in one go
+#define CAN_BUDGET_EXHAUSTED    3   // times draining stopped before the buffers were empty
+#define CAN_FILTERS             4   // NN bits compared<<8 | NN filters used, 0xFFFF if not filtering
+#define CAN_FILTER_FAILURES     5   // times the ECAN didn't change mode to set up the filters
+
+extern void diagnosticsInit(void);
+extern void diagnosticsRequest(BYTE * msg);
+extern void diagnosticsPoll(void);
+extern BOOL diagnosticsSend(BYTE service);
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif	/* DIAGNOSTICS_H */
@@ -46,6 +46,8 @@
 #include "mioEEPROM.h"
 #include "config.h"
 #include "actionQueue.h"
+#include "txQueue.h"
+#include "stateJournal.h"
 
 // Forward declarations
 unsigned char pulseDelays[NUM_IO];
@@ -99,7 +101,7 @@ void startDigitalOutput(unsigned char io, unsigned char state) {
         flashDelays[io] = NV->io[io].nv_io.nv_output.output_flash_period;
         pulseDelays[io] = 0;
         setOutputPin(io, TRUE);
-        ee_write(EE_OP_STATE+io, state);	// save the current state of output
+        SAVE_OUTPUT_STATE(io, state);	// save the current state of output
         return;
     }
     // Check if the input event is inverted
@@ -112,11 +114,11 @@ void startDigitalOutput(unsigned char io, unsigned char state) {
     if ((pinState) && NV->io[io].nv_io.nv_output.output_pulse_duration) {
         if (pulseDelays[io] == 0) {
             pulseDelays[io] = NV->io[io].nv_io.nv_output.output_pulse_duration;
-            ee_write(EE_OP_STATE+io, ACTION_IO_CONSUMER_3);	// save the current state of output as OFF so 
+            SAVE_OUTPUT_STATE(io, ACTION_IO_CONSUMER_3);	// save the current state of output as OFF so 
                                                             // we don't power up with ON outputs
         }
     } else {
-        ee_write(EE_OP_STATE+io, state);	// save the current state of output
+        SAVE_OUTPUT_STATE(io, state);	// save the current state of output
     }    
     if (NV->io[io].flags & FLAG_RESULT_ACTION_INVERTED) {
         setOutputPin(io, ! pinState);
@@ -128,11 +130,11 @@ void startDigitalOutput(unsigned char io, unsigned char state) {
         if (pinState) {
             // only ON
             // check if produced event is inverted
-            sendInvertedProducedEvent(ACTION_IO_PRODUCER_INPUT(io), pinState, NV->io[io].flags & FLAG_RESULT_EVENT_INVERTED);
+            queueInvertedProducedEvent(ACTION_IO_PRODUCER_INPUT(io), pinState, NV->io[io].flags & FLAG_RESULT_EVENT_INVERTED, TX_PRIORITY_OUTPUT);
         }
     } else {
         // check if produced event is inverted
-        sendInvertedProducedEvent(ACTION_IO_PRODUCER_INPUT(io), pinState, NV->io[io].flags & FLAG_RESULT_EVENT_INVERTED);
+        queueInvertedProducedEvent(ACTION_IO_PRODUCER_INPUT(io), pinState, NV->io[io].flags & FLAG_RESULT_EVENT_INVERTED, TX_PRIORITY_OUTPUT);
     }
 }
 
@@ -170,7 +172,7 @@ void processOutputs(void) {
                 // check if OFF events are enabled
                 if ( ! (NV->io[io].flags & FLAG_DISABLE_OFF)) {
                     // check if produced event is inverted
-                    sendProducedEvent(ACTION_IO_PRODUCER_INPUT(io), !NV->io[io].flags & FLAG_RESULT_EVENT_INVERTED);
+                    queueProducedEvent(ACTION_IO_PRODUCER_INPUT(io), !NV->io[io].flags & FLAG_RESULT_EVENT_INVERTED, TX_PRIORITY_OUTPUT);
                 }
                 doneAction();
             }
@@ -0,0 +1,152 @@
+/*
+ Routines for CBUS FLiM operations - part of CBUS libraries for PIC 18F
+  This work is licensed under the:
+      Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International License.
+   To view a copy of this license, visit:
+      http://creativecommons.org/licenses/by-nc-sa/4.0/
+   or send a letter to Creative Commons, PO Box 1866, Mountain View, CA 94042, USA.
+   License summary:
+    You are free to:
+      Share, copy and redistribute the material in any medium or format
+      Adapt, remix, transform, and build upon the material
+    The licensor cannot revoke these freedoms as long as you follow the license terms.
+    Attribution : You must give appropriate credit, provide a link to the license,
+                   and indicate if changes were made. You may do so in any reasonable manner,
+                   but not in any way that suggests the licensor endorses you or your use.
+    NonCommercial : You may not use the material for commercial purposes. **(see note below)
+    ShareAlike : If you remix, transform, or build upon the material, you must distribute
+                  your contributions under the same license as the original.
+    No additional restrictions : You may not apply legal terms or technological measures that
+                                  legally restrict others from doing anything the license permits.
+   ** For commercial use, please contact the original copyright holder(s) to agree licensing terms
+**************************************************************************************************************
+	The FLiM routines have no code or definitions that are specific to any
+	module, so they can be used to provide FLiM facilities for any module 
+	using these libraries.
+	
+*/ 
+/*
+ * File:   evCache.c
+ *
+ * Created on 19 October 2026, 16:30
+ *
+ * Keeps the EVs of the last EV_CACHE_SIZE consumed events in RAM so that 
+ * an event which is used repeatedly, such as a turnout being thrown back and
+ * forth, doesn't need its EVs reading from the event table in flash each 
+ * time. The least recently used entry is replaced on a miss.
+ * 
+ * The cache is emptied whenever the event table may have changed.
+ */
+
+#include "module.h"
+#include "events.h"
+#include "evCache.h"
+
+#ifdef EV_CACHE
+
+static BYTE cachedEVs[EV_CACHE_SIZE][EVperEVT];
+static BYTE cachedIndex[EV_CACHE_SIZE];     // table index of each entry, NO_INDEX if empty
+static BYTE order[EV_CACHE_SIZE];           // entries, most recently used first
+static WORD hits;
+static WORD misses;
+
+// forward declarations
+static void makeMostRecent(BYTE position);
+
+/**
+ * Empty the cache and clear the statistics.
+ */
+void evCacheInit(void) {
+    hits = 0;
+    misses = 0;
+    evCacheInvalidate();
+}
+
+/**
+ * Empty the cache. Called after the event table may have changed.
+ */
+void evCacheInvalidate(void) {
+    BYTE i;
+    for (i=0; i<EV_CACHE_SIZE; i++) {
+        cachedIndex[i] = NO_INDEX;
+        order[i] = i;
+    }
+}
+
+/**
+ * Get the EVs of an event into evs[], from the cache if possible.
+ * @param tableIndex the event table index
+ * @return 0 if successful otherwise the getEVs() error
+ */
+BYTE getCachedEVs(BYTE tableIndex) {
+    BYTE position;
+    BYTE entry;
+    BYTE error;
+    BYTE e;
+    
+    for (position=0; position<EV_CACHE_SIZE; position++) {
+        entry = order[position];
+        if (cachedIndex[entry] == tableIndex) {
+            for (e=0; e<EVperEVT; e++) {
+                evs[e] = cachedEVs[entry][e];
+            }
+            makeMostRecent(position);
+            if (hits != 0xFFFF) hits++;
+            return 0;
+        }
+    }
+    if (misses != 0xFFFF) misses++;
+    error = getEVs(tableIndex);
+    if (error != 0) {
+        return error;
+    }
+    // replace the least recently used
+    entry = order[EV_CACHE_SIZE-1];
+    for (e=0; e<EVperEVT; e++) {
+        cachedEVs[entry][e] = evs[e];
+    }
+    cachedIndex[entry] = tableIndex;
+    makeMostRecent(EV_CACHE_SIZE-1);
+    return 0;
+}
+
+/**
+ * Move an entry to the front of the order.
+ * @param position where the entry is in the order
+ */
+static void makeMostRecent(BYTE position) {
+    BYTE entry;
+    
+    entry = order[position];
+    for ( ; position>0; position--) {
+        order[position] = order[position-1];
+    }
+    order[0] = entry;
+}
+
+/**
+ * Get a DIAG_EV_CACHE diagnostic.
+ * @param code the EV_CACHE_xxx code
+ * @param value where to put the value
+ * @return TRUE if a valid code
+ */
+BOOL getEvCacheDiagnostic(BYTE code, WORD * value) {
+    switch (code) {
+        case EV_CACHE_HITS:
+            *value = hits;
+            return TRUE;
+        case EV_CACHE_MISSES:
+            *value = misses;
+            return TRUE;
+        case EV_CACHE_HIT_RATE:
+            if ((hits + (DWORD)misses) == 0) {
+                *value = 0;
+            } else {
+                *value = (WORD)((hits * 100UL) / (hits + (DWORD)misses));
+            }
+            return TRUE;
+    }
+    return FALSE;
+}
+
+#endif
@@ -0,0 +1,68 @@
+/*
+ Routines for CBUS FLiM operations - part of CBUS libraries for PIC 18F
+  This work is licensed under the:
+      Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International License.
+   To view a copy of this license, visit:
+      http://creativecommons.org/licenses/by-nc-sa/4.0/
+   or send a letter to Creative Commons, PO Box 1866, Mountain View, CA 94042, USA.
+   License summary:
+    You are free to:
+      Share, copy and redistribute the material in any medium or format
+      Adapt, remix, transform, and build upon the material
+    The licensor cannot revoke these freedoms as long as you follow the license terms.
+    Attribution : You must give appropriate credit, provide a link to the license,
+                   and indicate if changes were made. You may do so in any reasonable manner,
+                   but not in any way that suggests the licensor endorses you or your use.
+    NonCommercial : You may not use the material for commercial purposes. **(see note below)
+    ShareAlike : If you remix, transform, or build upon the material, you must distribute
+                  your contributions under the same license as the original.
+    No additional restrictions : You may not apply legal terms or technological measures that
+                                  legally restrict others from doing anything the license permits.
+   ** For commercial use, please contact the original copyright holder(s) to agree licensing terms
+**************************************************************************************************************
+	The FLiM routines have no code or definitions that are specific to any
+	module, so they can be used to provide FLiM facilities for any module 
+	using these libraries.
+	
+*/ 
+/* 
+ * File:   evCache.h
+ *
+ * Created on 19 October 2026, 16:30
+ *
+ * RAM cache of the EVs of recently consumed events.
+ * Only compiled when EV_CACHE is defined in module.h.
+ */
+
+#ifndef EVCACHE_H
+#define	EVCACHE_H
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+#include "GenericTypeDefs.h"
+
+/*
+ * Codes for the DIAG_EV_CACHE diagnostic service
+ */
+#define EV_CACHE_HITS       1   // lookups found in the cache
+#define EV_CACHE_MISSES     2   // lookups which read the EVs from flash
+#define EV_CACHE_HIT_RATE   3   // percentage of lookups found in the cache
+
+#ifdef EV_CACHE
+#define GET_EVS(tableIndex)     getCachedEVs(tableIndex)
+#else
+#define GET_EVS(tableIndex)     getEVs(tableIndex)
+#endif
+
+extern void evCacheInit(void);
+extern void evCacheInvalidate(void);
+extern BYTE getCachedEVs(BYTE tableIndex);
+extern BOOL getEvCacheDiagnostic(BYTE code, WORD * value);
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif	/* EVCACHE_H */
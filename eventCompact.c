@@ -0,0 +1,269 @@
+/*
+ Routines for CBUS FLiM operations - part of CBUS libraries for PIC 18F
+  This work is licensed under the:
+      Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International License.
+   To view a copy of this license, visit:
+      http://creativecommons.org/licenses/by-nc-sa/4.0/
+   or send a letter to Creative Commons, PO Box 1866, Mountain View, CA 94042, USA.
+   License summary:
+    You are free to:
+      Share, copy and redistribute the material in any medium or format
+      Adapt, remix, transform, and build upon the material
+    The licensor cannot revoke these freedoms as long as you follow the license terms.
+    Attribution : You must give appropriate credit, provide a link to the license,
+                   and indicate if changes were made. You may do so in any reasonable manner,
+                   but not in any way that suggests the licensor endorses you or your use.
+    NonCommercial : You may not use the material for commercial purposes. **(see note below)
+    ShareAlike : If you remix, transform, or build upon the material, you must distribute
+                  your contributions under the same license as the original.
+    No additional restrictions : You may not apply legal terms or technological measures that
+                                  legally restrict others from doing anything the license permits.
+   ** For commercial use, please contact the original copyright holder(s) to agree licensing terms
+**************************************************************************************************************
+	The FLiM routines have no code or definitions that are specific to any
+	module, so they can be used to provide FLiM facilities for any module 
+	using these libraries.
+	
+*/ 
+/*
+ * File:   eventCompact.c
+ *
+ * Created on 22 October 2026, 10:20
+ *
+ * CBUSlib puts a newly learned event, or a continuation entry for more EVs,
+ * in the first free entry of the event table. After many learn and unlearn
+ * cycles the used entries are scattered through the table and an event's 
+ * continuation entries can be far from its first entry.
+ * 
+ * Compaction moves the used entries down to the start of the table, keeping
+ * their order, and corrects the continuation indexes. The table is written 
+ * one flash block at a time: the new contents of a block are put together 
+ * in RAM and the block is only written if it has changed, so each block is
+ * erased at most once. As an entry only ever moves down the entries still 
+ * to be moved are never in a block which has already been written.
+ * 
+ * It is only done in learn mode when asked for with an NVSET of NV_COMMAND
+ * to NV_COMMAND_COMPACT_EVENTS, which is acknowledged with WRACK, or with 
+ * CMDERR if the module isn't in learn mode. A power failure part way through
+ * can leave an entry duplicated or lost, so compaction is never started 
+ * automatically or by a read: whoever asks for it is expected to check the
+ * table afterwards (e.g. with NERD) and relearn if necessary. The 
+ * DIAG_EVENT_TABLE EVENT_TABLE_HOLES diagnostic can be read using RDGN to 
+ * decide whether it is worth doing.
+ * Everything depending upon event table indexes is then rebuilt.
+ */
+
+#include <stddef.h>
+#include "devincs.h"
+#include "module.h"
+#include "events.h"
+#include "romops.h"
+#include "cbus.h"
+#include "FliM.h"
+#include "mioNv.h"
+#include "busLoad.h"
+#include "trace.h"
+#include "eventCompact.h"
+
+#ifdef EVENT_COMPACTION
+
+#define FLASH_BLOCK_SIZE    64
+#define ENTRIES_PER_BLOCK   (FLASH_BLOCK_SIZE/sizeof(EventTable))
+#define NEXT_OFFSET         offsetof(EventTable, next)
+
+#define ENTRY_ADDRESS(tableIndex)   (AT_EVENTS + (WORD)(tableIndex)*sizeof(EventTable))
+
+static const rom near EventTable * eventTable = (const rom near EventTable*)AT_EVENTS;
+
+static BYTE used[(NUM_EVENTS+7)/8];     // bit set for each used entry before compaction
+static BYTE blockImage[FLASH_BLOCK_SIZE];
+static BOOL compactPending;
+static WORD compactions;
+
+// forward declarations
+static BYTE countHoles(BYTE * usedCount);
+static void compact(void);
+static BYTE newIndex(BYTE tableIndex);
+
+/**
+ * Initialise compaction. The table is not compacted at start up, see above.
+ */
+void eventCompactInit(void) {
+    compactPending = FALSE;
+    compactions = 0;
+}
+
+/**
+ * Handle the NVSET asking for the event table to be compacted.
+ * @param msg the received message
+ * @return TRUE if the message was the command and has been answered
+ */
+BOOL eventCompactCommand(BYTE * msg) {
+    BYTE opc;
+    
+    if ((msg[d0] != OPC_NVSET) || (msg[d3] != NV_COMMAND) 
+            || (msg[d4] != NV_COMMAND_COMPACT_EVENTS) || ! thisNN(msg)) {
+        return FALSE;
+    }
+    if (flimState == fsFLiMLearn) {
+        compactPending = TRUE;
+        opc = OPC_WRACK;
+    } else {
+        cbusMsg[d3] = CMDERR_NOT_LRN;
+        opc = OPC_CMDERR;
+    }
+    if (cbusSendOpcMyNN(0, opc, cbusMsg)) {
+        busLoadFrame(opc, TRUE);
+        TRACE_FRAME(cbusMsg, TRUE);
+    }
+    return TRUE;
+}
+
+/**
+ * Do a requested compaction. Called from the main loop.
+ * @return TRUE if the event table was changed
+ */
+BOOL pollEventCompact(void) {
+    if ( ! compactPending) {
+        return FALSE;
+    }
+    compactPending = FALSE;
+    compact();
+#ifdef HASH_TABLE
+    rebuildHashtable();
+#endif
+    return TRUE;
+}
+
+/**
+ * Count the free entries below the last used one.
+ * @param usedCount where to put the number of used entries
+ * @return the number of free entries below the last used one
+ */
+static BYTE countHoles(BYTE * usedCount) {
+    BYTE tableIndex;
+    BYTE free;
+    BYTE holes;
+    
+    *usedCount = 0;
+    free = 0;
+    holes = 0;
+    for (tableIndex=0; tableIndex<NUM_EVENTS; tableIndex++) {
+        if (eventTable[tableIndex].flags.freeEntry) {
+            free++;
+        } else {
+            (*usedCount)++;
+            holes = free;
+        }
+    }
+    return holes;
+}
+
+/**
+ * Move the used entries to the start of the table.
+ */
+static void compact(void) {
+    BYTE tableIndex;
+    BYTE usedCount;
+    BYTE source;
+    BYTE first;
+    BYTE e;
+    BYTE b;
+    BOOL changed;
+    const rom near BYTE * entry;
+    
+    // note which entries are used before anything moves
+    usedCount = 0;
+    for (tableIndex=0; tableIndex<NUM_EVENTS; tableIndex++) {
+        if (eventTable[tableIndex].flags.freeEntry) {
+            used[tableIndex>>3] &= ~(1 << (tableIndex&7));
+        } else {
+            used[tableIndex>>3] |= (1 << (tableIndex&7));
+            usedCount++;
+        }
+    }
+    source = 0;
+    for (first=0; first<NUM_EVENTS; first+=ENTRIES_PER_BLOCK) {
+        // put together the new contents of the block
+        for (e=0; e<ENTRIES_PER_BLOCK; e++) {
+            tableIndex = first + e;
+            if ((tableIndex >= NUM_EVENTS) || (tableIndex >= usedCount)) {
+                // free entries are left erased
+                for (b=0; b<sizeof(EventTable); b++) {
+                    blockImage[e*sizeof(EventTable)+b] = 0xFF;
+                }
+                continue;
+            }
+            while ( ! (used[source>>3] & (1 << (source&7)))) {
+                source++;
+            }
+            entry = (const rom near BYTE*)ENTRY_ADDRESS(source);
+            for (b=0; b<sizeof(EventTable); b++) {
+                blockImage[e*sizeof(EventTable)+b] = entry[b];
+            }
+            if (eventTable[source].flags.continued && (eventTable[source].next < NUM_EVENTS)) {
+                blockImage[e*sizeof(EventTable)+NEXT_OFFSET] = newIndex(eventTable[source].next);
+            }
+            source++;
+        }
+        // write the block if it has changed
+        entry = (const rom near BYTE*)ENTRY_ADDRESS(first);
+        changed = FALSE;
+        for (b=0; b<FLASH_BLOCK_SIZE; b++) {
+            if ((first + b/sizeof(EventTable)) >= NUM_EVENTS) break;
+            if (entry[b] != blockImage[b]) {
+                writeFlashByte((BYTE*)(ENTRY_ADDRESS(first) + b), blockImage[b]);
+                changed = TRUE;
+            }
+        }
+        if (changed) {
+            flushFlashImage();
+        }
+        ClrWdt();   // compacting is slow so don't let the watchdog expire
+    }
+    if (compactions != 0xFFFF) compactions++;
+}
+
+/**
+ * Get where a used entry has been moved to.
+ * @param tableIndex the index before compaction
+ * @return the index after compaction
+ */
+static BYTE newIndex(BYTE tableIndex) {
+    BYTE i;
+    BYTE index;
+    
+    index = 0;
+    for (i=0; i<tableIndex; i++) {
+        if (used[i>>3] & (1 << (i&7))) {
+            index++;
+        }
+    }
+    return index;
+}
+
+/**
+ * Get a DIAG_EVENT_TABLE diagnostic.
+ * @param code the EVENT_TABLE_xxx code
+ * @param value where to put the value
+ * @return TRUE if a valid code
+ */
+BOOL getEventTableDiagnostic(BYTE code, WORD * value) {
+    BYTE usedCount;
+    
+    switch (code) {
+        case EVENT_TABLE_USED:
+            countHoles(&usedCount);
+            *value = usedCount;
+            return TRUE;
+        case EVENT_TABLE_HOLES:
+            *value = countHoles(&usedCount);
+            return TRUE;
+        case EVENT_TABLE_COMPACTIONS:
+            *value = compactions;
+            return TRUE;
+    }
+    return FALSE;
+}
+
+#endif
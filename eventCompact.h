@@ -0,0 +1,62 @@
+/*
+ Routines for CBUS FLiM operations - part of CBUS libraries for PIC 18F
+  This work is licensed under the:
+      Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International License.
+   To view a copy of this license, visit:
+      http://creativecommons.org/licenses/by-nc-sa/4.0/
+   or send a letter to Creative Commons, PO Box 1866, Mountain View, CA 94042, USA.
+   License summary:
+    You are free to:
+      Share, copy and redistribute the material in any medium or format
+      Adapt, remix, transform, and build upon the material
+    The licensor cannot revoke these freedoms as long as you follow the license terms.
+    Attribution : You must give appropriate credit, provide a link to the license,
+                   and indicate if changes were made. You may do so in any reasonable manner,
+                   but not in any way that suggests the licensor endorses you or your use.
+    NonCommercial : You may not use the material for commercial purposes. **(see note below)
+    ShareAlike : If you remix, transform, or build upon the material, you must distribute
+                  your contributions under the same license as the original.
+    No additional restrictions : You may not apply legal terms or technological measures that
+                                  legally restrict others from doing anything the license permits.
+   ** For commercial use, please contact the original copyright holder(s) to agree licensing terms
+**************************************************************************************************************
+	The FLiM routines have no code or definitions that are specific to any
+	module, so they can be used to provide FLiM facilities for any module 
+	using these libraries.
+	
+*/ 
+/* 
+ * File:   eventCompact.h
+ *
+ * Created on 22 October 2026, 10:20
+ *
+ * Moves the used event table entries to the start of the table.
+ * Only compiled when EVENT_COMPACTION is defined in module.h.
+ */
+
+#ifndef EVENTCOMPACT_H
+#define	EVENTCOMPACT_H
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+#include "GenericTypeDefs.h"
+
+/*
+ * Codes for the DIAG_EVENT_TABLE diagnostic service
+ */
+#define EVENT_TABLE_USED        1   // entries used including continuations
+#define EVENT_TABLE_HOLES       2   // free entries below the last used one
+#define EVENT_TABLE_COMPACTIONS 3   // times the table has been compacted since start up
+
+extern void eventCompactInit(void);
+extern BOOL eventCompactCommand(BYTE * msg);
+extern BOOL pollEventCompact(void);
+extern BOOL getEventTableDiagnostic(BYTE code, WORD * value);
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif	/* EVENTCOMPACT_H */
@@ -0,0 +1,237 @@
+/*
+ Routines for CBUS FLiM operations - part of CBUS libraries for PIC 18F
+  This work is licensed under the:
+      Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International License.
+   To view a copy of this license, visit:
+      http://creativecommons.org/licenses/by-nc-sa/4.0/
+   or send a letter to Creative Commons, PO Box 1866, Mountain View, CA 94042, USA.
+   License summary:
+    You are free to:
+      Share, copy and redistribute the material in any medium or format
+      Adapt, remix, transform, and build upon the material
+    The licensor cannot revoke these freedoms as long as you follow the license terms.
+    Attribution : You must give appropriate credit, provide a link to the license,
+                   and indicate if changes were made. You may do so in any reasonable manner,
+                   but not in any way that suggests the licensor endorses you or your use.
+    NonCommercial : You may not use the material for commercial purposes. **(see note below)
+    ShareAlike : If you remix, transform, or build upon the material, you must distribute
+                  your contributions under the same license as the original.
+    No additional restrictions : You may not apply legal terms or technological measures that
+                                  legally restrict others from doing anything the license permits.
+   ** For commercial use, please contact the original copyright holder(s) to agree licensing terms
+**************************************************************************************************************
+	The FLiM routines have no code or definitions that are specific to any
+	module, so they can be used to provide FLiM facilities for any module 
+	using these libraries.
+	
+*/ 
+/*
+ * File:   eventFilter.c
+ *
+ * Created on 20 October 2026, 16:10
+ *
+ * On a busy layout most of the accessory events received are for other 
+ * modules. A Bloom filter of FILTER_BITS bits holds the learned events so 
+ * that most of those can be rejected without reading the event table. 
+ * Each event sets FILTER_HASHES bits, found from two hashes of its NN and 
+ * EN. An event with any of its bits clear is certainly not learned; one 
+ * with all set is looked up as usual.
+ * 
+ * With 512 bits and 3 hashes about 2% of foreign events pass when 50 events
+ * are learned, rising to about 47% with a full table of 255. These are 
+ * measured by tests/bench_eventFilter.c.
+ * 
+ * With the event index a foreign event costs one hash and, when its slot is
+ * in use, one event table read. The filter saves most of those reads but 
+ * adds its own hash for every event which passes. The bench reports that it 
+ * pays off while a read costs more than 0.25 hashes at 100 events, 0.64 at
+ * 200 and 0.89 at 255. On the host, where reads are cheap, it stops paying 
+ * off at about 100 events. On the PIC getNN() reads flash and costs about as
+ * much as a hash, so the filter still just pays at 200 and breaks even at 
+ * 255. Without the index it always pays.
+ * 
+ * The other events covered by range entries are added as well.
+ * 
+ * The filter can't have bits removed so it is rebuilt once learning or 
+ * unlearning has finished for a second. Until then every event is looked up.
+ */
+
+#include "module.h"
+#include "events.h"
+#include "TickTime.h"
+#include "rangeEvents.h"
+#include "eventFilter.h"
+
+#ifdef EVENT_FILTER
+
+#define FILTER_BITS         512     // must be a power of two
+#define FILTER_HASHES       3
+#define FILTER_SETTLE_TIME  ONE_SECOND
+
+static BYTE filter[FILTER_BITS/8];
+static BOOL filterValid;
+static BOOL changed;
+static TickValue changeTime;
+static WORD rejected;
+static WORD passed;
+static WORD falsePositives;
+
+// forward declarations
+static void buildFilter(void);
+static void addToFilter(WORD nn, WORD en);
+static WORD hashFilter(WORD nn, WORD en, WORD * h2);
+
+/**
+ * Build the filter from the event table and clear the statistics. Called 
+ * during initialisation after the event table is ready.
+ */
+void eventFilterInit(void) {
+    rejected = 0;
+    passed = 0;
+    falsePositives = 0;
+    changed = FALSE;
+    buildFilter();
+}
+
+/**
+ * Called after the event table may have been changed by learning or 
+ * unlearning. The filter is not used until it has been rebuilt.
+ */
+void eventFilterChanged(void) {
+    filterValid = FALSE;
+    changeTime.Val = tickGet();
+    changed = TRUE;
+}
+
+/**
+ * Rebuild the filter once learning has finished. Called from the main loop.
+ */
+void pollEventFilter(void) {
+    if (changed && (tickTimeSince(changeTime) > FILTER_SETTLE_TIME)) {
+        changed = FALSE;
+        buildFilter();
+    }
+}
+
+/**
+ * Find a received event in the event table, if the filter shows it may 
+ * have been learned.
+ * @param nn the event's node number, 0 for a short event
+ * @param en the event number
+ * @return the event table index or NO_INDEX if not found
+ */
+BYTE eventFilterFind(WORD nn, WORD en) {
+    WORD h;
+    WORD h2;
+    WORD bit;
+    BYTE i;
+    BYTE tableIndex;
+    
+    if ( ! filterValid) {
+        return FIND_CONSUMED_EVENT(nn, en);
+    }
+    h = hashFilter(nn, en, &h2);
+    for (i=0; i<FILTER_HASHES; i++) {
+        bit = h & (FILTER_BITS-1);
+        if ( ! (filter[bit>>3] & (1 << (bit&7)))) {
+            if (rejected != 0xFFFF) rejected++;
+            return NO_INDEX;
+        }
+        h += h2;
+    }
+    if (passed != 0xFFFF) passed++;
+    tableIndex = FIND_CONSUMED_EVENT(nn, en);
+    if ((tableIndex == NO_INDEX) && (falsePositives != 0xFFFF)) {
+        falsePositives++;
+    }
+    return tableIndex;
+}
+
+/**
+ * Hash an event. The filter bits are h, h+h2, h+2*h2...
+ * @param nn the node number
+ * @param en the event number
+ * @param h2 where to put the second hash, always odd
+ * @return the first hash
+ */
+static WORD hashFilter(WORD nn, WORD en, WORD * h2) {
+    WORD h;
+    
+    h = (en * 0x9E37) ^ nn;
+    h *= 0x6F4B;
+    h ^= h >> 8;
+    *h2 = ((h * 0x9E37) ^ en) | 1;
+    return h;
+}
+
+/**
+ * Set the bits of every learned event.
+ */
+static void buildFilter(void) {
+    BYTE tableIndex;
+    BYTE i;
+#ifdef RANGE_EVENTS
+    WORD nn;
+    WORD en;
+    BYTE count;
+#endif
+    
+    for (i=0; i<FILTER_BITS/8; i++) {
+        filter[i] = 0;
+    }
+    for (tableIndex=0; tableIndex<NUM_EVENTS; tableIndex++) {
+        if ( ! validStart(tableIndex)) continue;
+        addToFilter(getNN(tableIndex), getEN(tableIndex));
+    }
+#ifdef RANGE_EVENTS
+    for (i=0; i<MAX_RANGES; i++) {
+        for (count=getRange(i, &nn, &en); count>1; count--) {
+            en++;
+            addToFilter(nn, en);
+        }
+    }
+#endif
+    filterValid = TRUE;
+}
+
+/**
+ * Set the bits of an event.
+ * @param nn the node number
+ * @param en the event number
+ */
+static void addToFilter(WORD nn, WORD en) {
+    WORD h;
+    WORD h2;
+    WORD bit;
+    BYTE i;
+    
+    h = hashFilter(nn, en, &h2);
+    for (i=0; i<FILTER_HASHES; i++) {
+        bit = h & (FILTER_BITS-1);
+        filter[bit>>3] |= (1 << (bit&7));
+        h += h2;
+    }
+}
+
+/**
+ * Get a DIAG_EVENT_FILTER diagnostic.
+ * @param code the EVENT_FILTER_xxx code
+ * @param value where to put the value
+ * @return TRUE if a valid code
+ */
+BOOL getEventFilterDiagnostic(BYTE code, WORD * value) {
+    switch (code) {
+        case EVENT_FILTER_REJECTED:
+            *value = rejected;
+            return TRUE;
+        case EVENT_FILTER_PASSED:
+            *value = passed;
+            return TRUE;
+        case EVENT_FILTER_FALSE:
+            *value = falsePositives;
+            return TRUE;
+    }
+    return FALSE;
+}
+
+#endif
@@ -0,0 +1,70 @@
+/*
+ Routines for CBUS FLiM operations - part of CBUS libraries for PIC 18F
+  This work is licensed under the:
+      Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International License.
+   To view a copy of this license, visit:
+      http://creativecommons.org/licenses/by-nc-sa/4.0/
+   or send a letter to Creative Commons, PO Box 1866, Mountain View, CA 94042, USA.
+   License summary:
+    You are free to:
+      Share, copy and redistribute the material in any medium or format
+      Adapt, remix, transform, and build upon the material
+    The licensor cannot revoke these freedoms as long as you follow the license terms.
+    Attribution : You must give appropriate credit, provide a link to the license,
+                   and indicate if changes were made. You may do so in any reasonable manner,
+                   but not in any way that suggests the licensor endorses you or your use.
+    NonCommercial : You may not use the material for commercial purposes. **(see note below)
+    ShareAlike : If you remix, transform, or build upon the material, you must distribute
+                  your contributions under the same license as the original.
+    No additional restrictions : You may not apply legal terms or technological measures that
+                                  legally restrict others from doing anything the license permits.
+   ** For commercial use, please contact the original copyright holder(s) to agree licensing terms
+**************************************************************************************************************
+	The FLiM routines have no code or definitions that are specific to any
+	module, so they can be used to provide FLiM facilities for any module 
+	using these libraries.
+	
+*/ 
+/* 
+ * File:   eventFilter.h
+ *
+ * Created on 20 October 2026, 16:10
+ *
+ * Bloom filter of the learned events, checked before looking up a received
+ * accessory event. Only compiled when EVENT_FILTER is defined in module.h.
+ */
+
+#ifndef EVENTFILTER_H
+#define	EVENTFILTER_H
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+#include "GenericTypeDefs.h"
+#include "rangeEvents.h"
+
+/*
+ * Codes for the DIAG_EVENT_FILTER diagnostic service
+ */
+#define EVENT_FILTER_REJECTED   1   // events the filter showed were not learned
+#define EVENT_FILTER_PASSED     2   // events which had to be looked up
+#define EVENT_FILTER_FALSE      3   // events which passed but were not learned
+
+#ifdef EVENT_FILTER
+#define LOOKUP_EVENT(nn, en)    eventFilterFind(nn, en)
+#else
+#define LOOKUP_EVENT(nn, en)    FIND_CONSUMED_EVENT(nn, en)
+#endif
+
+extern void eventFilterInit(void);
+extern void eventFilterChanged(void);
+extern void pollEventFilter(void);
+extern BYTE eventFilterFind(WORD nn, WORD en);
+extern BOOL getEventFilterDiagnostic(BYTE code, WORD * value);
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif	/* EVENTFILTER_H */
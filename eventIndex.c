@@ -0,0 +1,415 @@
+/*
+ Routines for CBUS FLiM operations - part of CBUS libraries for PIC 18F
+  This work is licensed under the:
+      Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International License.
+   To view a copy of this license, visit:
+      http://creativecommons.org/licenses/by-nc-sa/4.0/
+   or send a letter to Creative Commons, PO Box 1866, Mountain View, CA 94042, USA.
+   License summary:
+    You are free to:
+      Share, copy and redistribute the material in any medium or format
+      Adapt, remix, transform, and build upon the material
+    The licensor cannot revoke these freedoms as long as you follow the license terms.
+    Attribution : You must give appropriate credit, provide a link to the license,
+                   and indicate if changes were made. You may do so in any reasonable manner,
+                   but not in any way that suggests the licensor endorses you or your use.
+    NonCommercial : You may not use the material for commercial purposes. **(see note below)
+    ShareAlike : If you remix, transform, or build upon the material, you must distribute
+                  your contributions under the same license as the original.
+    No additional restrictions : You may not apply legal terms or technological measures that
+                                  legally restrict others from doing anything the license permits.
+   ** For commercial use, please contact the original copyright holder(s) to agree licensing terms
+**************************************************************************************************************
+	The FLiM routines have no code or definitions that are specific to any
+	module, so they can be used to provide FLiM facilities for any module 
+	using these libraries.
+	
+*/ 
+/*
+ * File:   eventIndex.c
+ *
+ * Created on 19 October 2026, 14:00
+ *
+ * A minimal perfect hash of the events in the event table which replaces 
+ * the CBUSlib hash table of HASH_LENGTH chains of CHAIN_LENGTH. Once the 
+ * index has been built a lookup takes one compare against the event table
+ * and the index uses INDEX_SLOTS + INDEX_BUCKETS (384) bytes of RAM rather 
+ * than 640.
+ * 
+ * The NN and EN are hashed to two 16 bit values. The first gives the key's
+ * base slot and an odd step, the second selects one of INDEX_BUCKETS 
+ * buckets. Each bucket has a displacement d and its keys are in slot 
+ * base + d*step. The displacements are found when the index is built, 
+ * largest buckets first, by trying each in turn until all the keys of the 
+ * bucket land in free slots. If that can't be done another seed is tried.
+ * With 128 buckets a full table of 255 events almost always builds with the
+ * first seed. tests/model_eventIndex.c measures this.
+ * 
+ * Building reads the whole event table once per bucket so it takes a 
+ * noticeable time. It is done at start up and once learning has finished
+ * for a second. In the main loop it is done BUILD_STEP_EVENTS event table 
+ * entries or PLACE_STEP_TRIES displacements at a time for up to BUILD_SLICE
+ * per poll so it doesn't hold up the servos or the CAN receive path.
+ * A bucket which collects more than MAX_BUCKET_SIZE events, which can only 
+ * happen if the table changes during the build, abandons the seed. Until it has been built, or if no 
+ * seed works, lookups fall back to findEvent() and are counted in the
+ * DIAG_EVENT_INDEX diagnostic.
+ */
+
+#include "devincs.h"
+#include "module.h"
+#include "events.h"
+#include "TickTime.h"
+#include "eventIndex.h"
+
+#ifdef EVENT_INDEX
+
+#define INDEX_SLOTS         256     // one more than NUM_EVENTS
+#define INDEX_BUCKETS       128     // must be a power of two
+#define MAX_BUCKET_SIZE     16      // most events hashing to one bucket
+#define MAX_SEEDS           4
+#define INDEX_SETTLE_TIME   ONE_SECOND
+#define BUILD_STEP_EVENTS   32      // event table entries read in one build step
+#define PLACE_STEP_TRIES    16      // displacements tried in one build step
+#define BUILD_SLICE         ONE_MILI_SECOND     // time spent building in one poll
+
+#define BUILD_IDLE          0       // not building
+#define BUILD_COUNT         1       // counting the events in each bucket
+#define BUILD_COLLECT       2       // collecting the events of a bucket to place them
+#define BUILD_PLACE         3       // finding a displacement for the bucket
+
+#define BASE_SLOT(h)        ((BYTE)((h) >> 8))
+#define STEP(h)             ((BYTE)(h) | 1)
+#define BUCKET(h2)          ((BYTE)(h2) & (INDEX_BUCKETS-1))
+#define SLOT(base, step, d) ((BYTE)((base) + (BYTE)((d) * (step))))
+
+// too big for a single bank so it uses the space the CBUSlib hash table would have had
+#pragma udata large_event_hash
+static BYTE slots[INDEX_SLOTS];             // event table index, NO_INDEX if empty
+static BYTE displacement[INDEX_BUCKETS];
+#pragma udata
+
+static BYTE bucketDone[INDEX_BUCKETS/8];
+static BYTE keyBase[MAX_BUCKET_SIZE];       // base slots of the bucket being placed
+static BYTE keyStep[MAX_BUCKET_SIZE];       // steps of the bucket being placed
+static BYTE keyIndex[MAX_BUCKET_SIZE];      // table indexes of the bucket being placed
+static BYTE seed;
+static BOOL indexValid;
+static BOOL changed;
+static TickValue changeTime;
+static BYTE buildState;                     // BUILD_xxx
+static BYTE buildSize;                      // size of the buckets being placed
+static BYTE buildBucket;                    // the bucket being placed
+static BYTE buildScan;                      // next event table entry to read
+static BYTE buildKeys;                      // keys of the bucket collected so far
+static BYTE buildDisplacement;              // next displacement to try for the bucket
+static WORD fallbacks;
+static WORD builds;
+static WORD buildFailures;
+
+// forward declarations
+static WORD hashEvent(WORD nn, WORD en, WORD * h2);
+static void startSeed(void);
+static void nextSeed(void);
+static void buildStep(void);
+static void countStep(void);
+static void collectStep(void);
+static void placeStep(void);
+static void nextBucket(void);
+static BOOL placeBucket(BYTE keys, BYTE d);
+
+/**
+ * Build the index from the event table. Called during initialisation after
+ * the event table is ready.
+ */
+void eventIndexInit(void) {
+    changed = FALSE;
+    fallbacks = 0;
+    builds = 0;
+    buildFailures = 0;
+    seed = 0;
+    startSeed();
+    while (buildState != BUILD_IDLE) {
+        buildStep();
+    }
+}
+
+/**
+ * Called after the event table may have been changed by learning, 
+ * unlearning or an IO type change. The index is no longer used until it has
+ * been rebuilt.
+ */
+void eventIndexChanged(void) {
+    indexValid = FALSE;
+    buildState = BUILD_IDLE;
+    changeTime.Val = tickGet();
+    changed = TRUE;
+}
+
+/**
+ * Rebuild the index once learning has finished, a slice at a time. Called 
+ * from the main loop.
+ */
+void pollEventIndex(void) {
+    TickValue sliceStart;
+    
+    if (changed && (tickTimeSince(changeTime) > INDEX_SETTLE_TIME)) {
+        changed = FALSE;
+        seed = 0;
+        startSeed();
+    }
+    if (buildState == BUILD_IDLE) {
+        return;
+    }
+    sliceStart.Val = tickGet();
+    do {
+        buildStep();
+    } while ((buildState != BUILD_IDLE) && (tickTimeSince(sliceStart) < BUILD_SLICE));
+}
+
+/**
+ * Find an event in the event table.
+ * @param nn the event's node number, 0 for a short event
+ * @param en the event number
+ * @return the event table index or NO_INDEX if not found
+ */
+BYTE eventIndexFind(WORD nn, WORD en) {
+    WORD h;
+    WORD h2;
+    BYTE tableIndex;
+    
+    if ( ! indexValid) {
+        if (fallbacks != 0xFFFF) fallbacks++;
+        return findEvent(nn, en);
+    }
+    h = hashEvent(nn, en, &h2);
+    tableIndex = slots[SLOT(BASE_SLOT(h), STEP(h), displacement[BUCKET(h2)])];
+    if ((tableIndex != NO_INDEX) && (getNN(tableIndex) == nn) && (getEN(tableIndex) == en)) {
+        return tableIndex;
+    }
+    return NO_INDEX;
+}
+
+/**
+ * Hash an event.
+ * @param nn the node number
+ * @param en the event number
+ * @param h2 where to put the second hash
+ * @return the first hash
+ */
+static WORD hashEvent(WORD nn, WORD en, WORD * h2) {
+    WORD h;
+    
+    h = (en ^ ((WORD)seed << 8)) * 0x9E37;
+    h ^= nn;
+    h *= 0x6F4B;
+    h ^= h >> 9;
+    *h2 = (h * 0x9E37) ^ nn;
+    *h2 *= 0x6F4B;
+    *h2 ^= *h2 >> 7;
+    return h;
+}
+
+/**
+ * Start building the index with the current seed.
+ */
+static void startSeed(void) {
+    BYTE b;
+    
+    for (b=0; b<INDEX_BUCKETS; b++) {
+        displacement[b] = 0;    // the number of events in the bucket until it is placed
+    }
+    for (b=0; b<INDEX_BUCKETS/8; b++) {
+        bucketDone[b] = 0;
+    }
+    slots[INDEX_SLOTS-1] = NO_INDEX;
+    indexValid = FALSE;
+    buildScan = 0;
+    buildState = BUILD_COUNT;
+}
+
+/**
+ * Give up on the current seed and try the next.
+ */
+static void nextSeed(void) {
+    seed++;
+    if (seed < MAX_SEEDS) {
+        startSeed();
+        return;
+    }
+    buildState = BUILD_IDLE;
+    if (buildFailures != 0xFFFF) buildFailures++;
+}
+
+/**
+ * Do the next step of building the index.
+ */
+static void buildStep(void) {
+    switch (buildState) {
+        case BUILD_COUNT:
+            countStep();
+            break;
+        case BUILD_COLLECT:
+            collectStep();
+            break;
+        case BUILD_PLACE:
+            placeStep();
+            break;
+    }
+}
+
+/**
+ * Count the events in each bucket. Once all have been counted start placing
+ * the biggest buckets whilst there are most free slots.
+ */
+static void countStep(void) {
+    BYTE n;
+    BYTE b;
+    WORD h2;
+    
+    for (n=0; (n<BUILD_STEP_EVENTS) && (buildScan<NUM_EVENTS); n++, buildScan++) {
+        slots[buildScan] = NO_INDEX;
+        if (validStart(buildScan)) {
+            hashEvent(getNN(buildScan), getEN(buildScan), &h2);
+            displacement[BUCKET(h2)]++;
+        }
+    }
+    if (buildScan < NUM_EVENTS) return;
+    
+    buildSize = 0;
+    for (b=0; b<INDEX_BUCKETS; b++) {
+        if (displacement[b] > buildSize) buildSize = displacement[b];
+    }
+    if (buildSize > MAX_BUCKET_SIZE) {
+        nextSeed();
+        return;
+    }
+    buildBucket = 0;
+    buildState = BUILD_COLLECT;
+    nextBucket();
+}
+
+/**
+ * Collect the events of the bucket being placed and once they have all been 
+ * found start looking for a displacement for them.
+ */
+static void collectStep(void) {
+    BYTE n;
+    WORD h;
+    WORD h2;
+    
+    for (n=0; (n<BUILD_STEP_EVENTS) && (buildScan<NUM_EVENTS); n++, buildScan++) {
+        if ( ! validStart(buildScan)) continue;
+        h = hashEvent(getNN(buildScan), getEN(buildScan), &h2);
+        if (BUCKET(h2) == buildBucket) {
+            if (buildKeys == MAX_BUCKET_SIZE) {
+                // the table has changed since the buckets were counted
+                nextSeed();
+                return;
+            }
+            keyBase[buildKeys] = BASE_SLOT(h);
+            keyStep[buildKeys] = STEP(h);
+            keyIndex[buildKeys] = buildScan;
+            buildKeys++;
+        }
+    }
+    if (buildScan < NUM_EVENTS) return;
+    
+    buildDisplacement = 0;
+    buildState = BUILD_PLACE;
+}
+
+/**
+ * Try the next few displacements for the bucket being placed. Once one 
+ * works move on to the next bucket.
+ */
+static void placeStep(void) {
+    BYTE n;
+    
+    for (n=0; n<PLACE_STEP_TRIES; n++) {
+        if (placeBucket(buildKeys, buildDisplacement)) {
+            displacement[buildBucket] = buildDisplacement;
+            bucketDone[buildBucket>>3] |= (1 << (buildBucket&7));
+            buildState = BUILD_COLLECT;
+            nextBucket();
+            return;
+        }
+        if (buildDisplacement == 0xFF) {
+            nextSeed();
+            return;
+        }
+        buildDisplacement++;
+    }
+}
+
+/**
+ * Move on to the next bucket to be placed, biggest first. The index is 
+ * complete once there are none left.
+ */
+static void nextBucket(void) {
+    while (buildSize > 0) {
+        for ( ; buildBucket<INDEX_BUCKETS; buildBucket++) {
+            if ( ! (bucketDone[buildBucket>>3] & (1 << (buildBucket&7))) 
+                    && (displacement[buildBucket] == buildSize)) {
+                buildScan = 0;
+                buildKeys = 0;
+                return;
+            }
+        }
+        buildSize--;
+        buildBucket = 0;
+    }
+    buildState = BUILD_IDLE;
+    indexValid = TRUE;
+    if (builds != 0xFFFF) builds++;
+}
+
+/**
+ * Try to put the keys of a bucket into the slots.
+ * @param keys the number of keys in keyBase and keyIndex
+ * @param d the displacement to try
+ * @return TRUE if they all went into free slots
+ */
+static BOOL placeBucket(BYTE keys, BYTE d) {
+    BYTE k;
+    BYTE s;
+    
+    for (k=0; k<keys; k++) {
+        s = SLOT(keyBase[k], keyStep[k], d);
+        if (slots[s] != NO_INDEX) break;
+        slots[s] = keyIndex[k];
+    }
+    if (k == keys) return TRUE;
+    // take back the ones placed
+    while (k > 0) {
+        k--;
+        slots[SLOT(keyBase[k], keyStep[k], d)] = NO_INDEX;
+    }
+    return FALSE;
+}
+
+/**
+ * Get a DIAG_EVENT_INDEX diagnostic.
+ * @param code the EVENT_INDEX_xxx code
+ * @param value where to put the value
+ * @return TRUE if a valid code
+ */
+BOOL getEventIndexDiagnostic(BYTE code, WORD * value) {
+    switch (code) {
+        case EVENT_INDEX_FALLBACKS:
+            *value = fallbacks;
+            return TRUE;
+        case EVENT_INDEX_BUILDS:
+            *value = builds;
+            return TRUE;
+        case EVENT_INDEX_FAILURES:
+            *value = buildFailures;
+            return TRUE;
+        case EVENT_INDEX_SEED:
+            *value = indexValid ? seed : 0xFFFF;
+            return TRUE;
+    }
+    return FALSE;
+}
+
+#endif
@@ -0,0 +1,70 @@
+/*
+ Routines for CBUS FLiM operations - part of CBUS libraries for PIC 18F
+  This work is licensed under the:
+      Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International License.
+   To view a copy of this license, visit:
+      http://creativecommons.org/licenses/by-nc-sa/4.0/
+   or send a letter to Creative Commons, PO Box 1866, Mountain View, CA 94042, USA.
+   License summary:
+    You are free to:
+      Share, copy and redistribute the material in any medium or format
+      Adapt, remix, transform, and build upon the material
+    The licensor cannot revoke these freedoms as long as you follow the license terms.
+    Attribution : You must give appropriate credit, provide a link to the license,
+                   and indicate if changes were made. You may do so in any reasonable manner,
+                   but not in any way that suggests the licensor endorses you or your use.
+    NonCommercial : You may not use the material for commercial purposes. **(see note below)
+    ShareAlike : If you remix, transform, or build upon the material, you must distribute
+                  your contributions under the same license as the original.
+    No additional restrictions : You may not apply legal terms or technological measures that
+                                  legally restrict others from doing anything the license permits.
+   ** For commercial use, please contact the original copyright holder(s) to agree licensing terms
+**************************************************************************************************************
+	The FLiM routines have no code or definitions that are specific to any
+	module, so they can be used to provide FLiM facilities for any module 
+	using these libraries.
+	
+*/ 
+/* 
+ * File:   eventIndex.h
+ *
+ * Created on 19 October 2026, 14:00
+ *
+ * Perfect hash index for looking up received events in the event table.
+ * Only compiled when EVENT_INDEX is defined in module.h.
+ */
+
+#ifndef EVENTINDEX_H
+#define	EVENTINDEX_H
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+#include "GenericTypeDefs.h"
+
+#ifdef EVENT_INDEX
+#define FIND_EVENT(nn, en)      eventIndexFind(nn, en)
+#else
+#define FIND_EVENT(nn, en)      findEvent(nn, en)
+#endif
+
+/*
+ * Codes for the DIAG_EVENT_INDEX diagnostic service
+ */
+#define EVENT_INDEX_FALLBACKS   1   // lookups done with findEvent() as the index wasn't built
+#define EVENT_INDEX_BUILDS      2   // times the index has been built
+#define EVENT_INDEX_FAILURES    3   // times no seed worked
+#define EVENT_INDEX_SEED        4   // the seed in use, 0xFFFF if the index isn't built
+
+extern void eventIndexInit(void);
+extern void eventIndexChanged(void);
+extern void pollEventIndex(void);
+extern BYTE eventIndexFind(WORD nn, WORD en);
+extern BOOL getEventIndexDiagnostic(BYTE code, WORD * value);
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif	/* EVENTINDEX_H */
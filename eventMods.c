@@ -53,7 +53,7 @@ WORD modifyEN(WORD workEN){
 
 BOOL executeAction (unsigned char io, unsigned char ca, int action) {
     BOOL actionStatus = TRUE;
-        if ((NV->spare[10] >= STDMODE) && (NV->spare[10] <= THREEMODE)){
+        if ((NV->track_mode >= STDMODE) && (NV->track_mode <= THREEMODE)){
             int i = 0;
             BOOL foundEN = FALSE;
             unsigned char sectionEN = 0;
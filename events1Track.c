@@ -17,7 +17,7 @@
 /*
 int produce1TrackEvent () {
 
-    // NV reading = use NV_SPARE12
+    // NV reading = use NV_1TRACK_MODE
     
     // Standard ACON and ACOFF handled by generic CANMIO functionality
     
@@ -34,7 +34,7 @@ int produce1TrackEvent () {
 
 int consume1TrackEvent () {
 
-    // NV reading = use NV_SPARE12
+    // NV reading = use NV_1TRACK_MODE
     
     // Standard ACON and ACOFF handled by generic CANMIO functionality
     
@@ -44,6 +44,7 @@
 #include "config.h"
 #include "mioEvents.h"
 #include "cbus.h"
+#include "rateLimit.h"
 
 /**
  * The current state of the input pins. This may not be the actual read state uas we
@@ -55,9 +56,12 @@ static BYTE inputState[NUM_IO];
  */
 BYTE outputState[NUM_IO];
 /*
- * Counts the number of cycles since the input changed state.
+ * The time in ms since the input changed state. The on and off delay NVs are
+ * in units of INPUT_DELAY_UNIT ms whatever the input scan period.
  */
-static BYTE delayCount[NUM_IO];
+#define INPUT_DELAY_UNIT    5
+static WORD delayTime[NUM_IO];
+static BYTE scanPeriod;     // ms between scans
 
 // forward declarations
 BOOL readInput(unsigned char io);
@@ -78,8 +82,18 @@ void initInputScan(void) {
             input = !input;
         }
         outputState[io] = input;
-        delayCount[io] = 0;
+        delayTime[io] = 0;
     }
+    scanPeriod = DEFAULT_INPUT_SCAN_PERIOD;
+}
+
+/**
+ * Set the time between input scans so that the on and off delays stay the 
+ * same when the input scan period NV is changed.
+ * @param ms the scan period in ms
+ */
+void setInputScanPeriod(BYTE ms) {
+    scanPeriod = ms;
 }
 
 /**
@@ -100,15 +114,15 @@ void inputScan(void) {
             if (input != inputState[io]) {
                 BOOL change = FALSE;
                 // check if we have reached the debounce count
-                if (inputState[io] && (delayCount[io] == NV->io[io].nv_io.nv_input.input_on_delay)) {
+                if (inputState[io] && (delayTime[io] >= NV->io[io].nv_io.nv_input.input_on_delay * (WORD)INPUT_DELAY_UNIT)) {
                     change = TRUE;
                 }
-                if (!inputState[io] && (delayCount[io] == NV->io[io].nv_io.nv_input.input_off_delay)) {
+                if (!inputState[io] && (delayTime[io] >= NV->io[io].nv_io.nv_input.input_off_delay * (WORD)INPUT_DELAY_UNIT)) {
                     change = TRUE;
                 }
                 if (change) {
                     // input been steady long enough to be treated as a real change
-                    delayCount[io] = 0;
+                    delayTime[io] = 0;
                     inputState[io] = input;
                     // check if input pin is inverted
                     if (!(NV->io[io].flags & FLAG_TRIGGER_INVERTED)) {
@@ -131,30 +145,30 @@ void inputScan(void) {
                             // only ON
                             // check if produced event is inverted
                             if (NV->io[io].flags & FLAG_RESULT_EVENT_INVERTED) {
-                                sendProducedEvent(ACTION_IO_PRODUCER_INPUT(io), FALSE);
+                                queueLimitedEvent(ACTION_IO_PRODUCER_INPUT(io), FALSE);
                             } else {
-                                sendProducedEvent(ACTION_IO_PRODUCER_INPUT(io), TRUE);
+                                queueLimitedEvent(ACTION_IO_PRODUCER_INPUT(io), TRUE);
                             }
                         } else {
                             if (NV->io[io].flags & FLAG_RESULT_EVENT_INVERTED) {
-                                sendProducedEvent(ACTION_IO_PRODUCER_INPUT_TWO_ON(io), FALSE);
+                                queueLimitedEvent(ACTION_IO_PRODUCER_INPUT_TWO_ON(io), FALSE);
                             } else {
-                                sendProducedEvent(ACTION_IO_PRODUCER_INPUT_TWO_ON(io), TRUE);
+                                queueLimitedEvent(ACTION_IO_PRODUCER_INPUT_TWO_ON(io), TRUE);
                             }
                         }
                     } else {
                         // check if produced event is inverted
                         if (NV->io[io].flags & FLAG_RESULT_EVENT_INVERTED) {
-                            sendProducedEvent(ACTION_IO_PRODUCER_INPUT(io), !outputState[io]);
+                            queueLimitedEvent(ACTION_IO_PRODUCER_INPUT(io), !outputState[io]);
                         } else {
-                            sendProducedEvent(ACTION_IO_PRODUCER_INPUT(io), outputState[io]);
+                            queueLimitedEvent(ACTION_IO_PRODUCER_INPUT(io), outputState[io]);
                         }
                     }
                 } else {
-                    delayCount[io]++;
+                    delayTime[io] += scanPeriod;
                 }
             } else {
-                delayCount[io] = 0;
+                delayTime[io] = 0;
             }
         }
     }
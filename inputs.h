@@ -45,6 +45,7 @@ extern "C" {
      */
     extern void initInputScan(void);
     extern void inputScan(void);
+    extern void setInputScanPeriod(BYTE ms);
 
 
 #ifdef	__cplusplus
@@ -0,0 +1,278 @@
+/*
+ Routines for CBUS FLiM operations - part of CBUS libraries for PIC 18F
+  This work is licensed under the:
+      Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International License.
+   To view a copy of this license, visit:
+      http://creativecommons.org/licenses/by-nc-sa/4.0/
+   or send a letter to Creative Commons, PO Box 1866, Mountain View, CA 94042, USA.
+   License summary:
+    You are free to:
+      Share, copy and redistribute the material in any medium or format
+      Adapt, remix, transform, and build upon the material
+    The licensor cannot revoke these freedoms as long as you follow the license terms.
+    Attribution : You must give appropriate credit, provide a link to the license,
+                   and indicate if changes were made. You may do so in any reasonable manner,
+                   but not in any way that suggests the licensor endorses you or your use.
+    NonCommercial : You may not use the material for commercial purposes. **(see note below)
+    ShareAlike : If you remix, transform, or build upon the material, you must distribute
+                  your contributions under the same license as the original.
+    No additional restrictions : You may not apply legal terms or technological measures that
+                                  legally restrict others from doing anything the license permits.
+   ** For commercial use, please contact the original copyright holder(s) to agree licensing terms
+**************************************************************************************************************
+	The FLiM routines have no code or definitions that are specific to any
+	module, so they can be used to provide FLiM facilities for any module 
+	using these libraries.
+	
+*/ 
+/*
+ * File:   latency.c
+ *
+ * Created on 19 October 2026, 11:20
+ *
+ * Measures the time from a CAN frame arriving to an output acting upon the
+ * event, so the cost of queueing actions and polling them can be seen.
+ * 
+ * The CAN interrupt records the TMR0 time if it hasn't already got a time 
+ * for frames not yet taken. CBUSlib doesn't give a time for each frame so 
+ * when several are waiting they all get the time of the first one and the 
+ * latency is never underestimated. The time is cleared once the receive 
+ * buffers are empty.
+ * 
+ * processEvent() gives each IO an action is queued for the time of the frame
+ * being processed. A digital output has acted when startDigitalOutput() 
+ * sets the pin. A servo, bounce or multi output has acted on its next pulse
+ * from setupTimer1() or setupTimer3() after being started.
+ * 
+ * TMR0 counts 16us ticks and wraps after about 1 second. An IO still 
+ * waiting after LATENCY_CLAMP is counted in the top bucket by latencyPoll()
+ * so a longer wait is never recorded as a short one, and the maximum is 
+ * then reported as 0xFFFF. The latencies are kept in a histogram of 4ms 
+ * buckets from which the median and 99th percentile are found.
+ * 
+ * The low priority ISR reads TMR0 for the receive time, and reading TMR0L
+ * latches TMR0H, so the main loop reads TMR0 with low priority interrupts
+ * disabled.
+ */
+
+#include "devincs.h"
+#include "module.h"
+#include "latency.h"
+
+#ifdef LATENCY
+
+#define IDLE        0
+#define QUEUED      1   // an action has been queued
+#define STARTED     2   // the output has been started and is waiting for its next pulse
+
+#define LATENCY_CLAMP   49152   // ticks, leaves a quarter of TMR0's range for the poll to be late
+
+static WORD rxTime;             // time of the oldest frame not yet taken
+static BOOL rxTimeValid;
+static WORD frameTime;          // time of the frame being processed
+static BOOL frameTimeValid;
+static WORD ioTime[NUM_IO];
+static BYTE ioState[NUM_IO];
+static WORD histogram[LATENCY_BUCKETS];
+static WORD count;
+static WORD max;
+
+// forward declarations
+static WORD readTimer0(void);
+static void record(unsigned char io);
+static void addToHistogram(WORD latency);
+static WORD percentile(BYTE percent);
+
+void latencyInit(void) {
+    unsigned char i;
+    rxTimeValid = FALSE;
+    frameTimeValid = FALSE;
+    for (i=0; i<NUM_IO; i++) {
+        ioState[i] = IDLE;
+    }
+    for (i=0; i<LATENCY_BUCKETS; i++) {
+        histogram[i] = 0;
+    }
+    count = 0;
+    max = 0;
+}
+
+/**
+ * Called from the low priority ISR when a frame has been received.
+ */
+void latencyRxInterrupt(void) {
+    if ( ! rxTimeValid) {
+        rxTime = TMR0L;             // reading TMR0L latches TMR0H
+        rxTime |= (WORD)TMR0H << 8;
+        rxTimeValid = TRUE;
+    }
+}
+
+/**
+ * Called when taking a frame from the receive buffers.
+ * @param received TRUE if a frame was taken, FALSE if the buffers were empty
+ */
+void latencyFrameTaken(BOOL received) {
+    frameTime = rxTime;
+    frameTimeValid = received && rxTimeValid;
+    if ( ! received) {
+        rxTimeValid = FALSE;
+    }
+}
+
+/**
+ * An action has been queued for an IO by the frame being processed.
+ * @param io the IO
+ */
+void latencyQueued(unsigned char io) {
+    if (frameTimeValid && (ioState[io] == IDLE)) {
+        ioTime[io] = frameTime;
+        ioState[io] = QUEUED;
+    }
+}
+
+/**
+ * A servo type output has been started and will act on its next pulse.
+ * @param io the IO
+ */
+void latencyStarted(unsigned char io) {
+    if (ioState[io] == QUEUED) {
+        ioState[io] = STARTED;
+    }
+}
+
+/**
+ * A digital output has been set.
+ * @param io the IO
+ */
+void latencyActuated(unsigned char io) {
+    if (ioState[io] != IDLE) {
+        record(io);
+    }
+}
+
+/**
+ * A servo pulse is being generated.
+ * @param io the IO
+ */
+void latencyPulse(unsigned char io) {
+    if (ioState[io] == STARTED) {
+        record(io);
+    }
+}
+
+/**
+ * The queued action didn't need the output to do anything.
+ * @param io the IO
+ */
+void latencyCancel(unsigned char io) {
+    if (ioState[io] == QUEUED) {
+        ioState[io] = IDLE;
+    }
+}
+
+/**
+ * Count the IOs which have been waiting too long to measure in the top 
+ * bucket. Called from the main loop.
+ */
+void latencyPoll(void) {
+    unsigned char io;
+    WORD now;
+    
+    now = readTimer0();
+    for (io=0; io<NUM_IO; io++) {
+        if ((ioState[io] != IDLE) && ((WORD)(now - ioTime[io]) > LATENCY_CLAMP)) {
+            ioState[io] = IDLE;
+            addToHistogram(0xFFFF);
+        }
+    }
+}
+
+/**
+ * Read TMR0 from the main loop.
+ * @return the TMR0 time
+ */
+static WORD readTimer0(void) {
+    WORD now;
+    
+    INTCONbits.GIEL = 0;
+    now = TMR0L;                // reading TMR0L latches TMR0H
+    now |= (WORD)TMR0H << 8;
+    INTCONbits.GIEL = 1;
+    return now;
+}
+
+/**
+ * Add the latency of an IO to the histogram.
+ * @param io the IO
+ */
+static void record(unsigned char io) {
+    ioState[io] = IDLE;
+    addToHistogram(readTimer0() - ioTime[io]);
+}
+
+/**
+ * Add a latency to the histogram.
+ * @param latency the latency in ticks, 0xFFFF if over LATENCY_CLAMP
+ */
+static void addToHistogram(WORD latency) {
+    BYTE bucket;
+    
+    bucket = latency >> LATENCY_BUCKET_SHIFT;
+    if (bucket >= LATENCY_BUCKETS) {
+        bucket = LATENCY_BUCKETS-1;
+    }
+    if (histogram[bucket] != 0xFFFF) histogram[bucket]++;
+    if (count != 0xFFFF) count++;
+    if (latency > max) max = latency;
+}
+
+/**
+ * Find a percentile from the histogram.
+ * @param percent the percentile required
+ * @return the upper edge of the bucket holding the percentile, in ticks
+ */
+static WORD percentile(BYTE percent) {
+    DWORD target;
+    DWORD total;
+    BYTE bucket;
+    
+    if (count == 0) return 0;
+    target = ((DWORD)count * percent + 99) / 100;
+    total = 0;
+    for (bucket=0; bucket<LATENCY_BUCKETS-1; bucket++) {
+        total += histogram[bucket];
+        if (total >= target) break;
+    }
+    return ((WORD)(bucket+1) << LATENCY_BUCKET_SHIFT) - 1;
+}
+
+/**
+ * Get a DIAG_LATENCY diagnostic.
+ * @param code the LATENCY_xxx code
+ * @param value where to put the value
+ * @return TRUE if a valid code
+ */
+BOOL getLatencyDiagnostic(BYTE code, WORD * value) {
+    switch (code) {
+        case LATENCY_COUNT:
+            *value = count;
+            return TRUE;
+        case LATENCY_P50:
+            *value = percentile(50);
+            return TRUE;
+        case LATENCY_P99:
+            *value = percentile(99);
+            return TRUE;
+        case LATENCY_MAX:
+            *value = max;
+            return TRUE;
+    }
+    if ((code >= LATENCY_BUCKET0) && (code < LATENCY_BUCKET0+LATENCY_BUCKETS)) {
+        *value = histogram[code - LATENCY_BUCKET0];
+        return TRUE;
+    }
+    return FALSE;
+}
+
+#endif
@@ -0,0 +1,92 @@
+/*
+ Routines for CBUS FLiM operations - part of CBUS libraries for PIC 18F
+  This work is licensed under the:
+      Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International License.
+   To view a copy of this license, visit:
+      http://creativecommons.org/licenses/by-nc-sa/4.0/
+   or send a letter to Creative Commons, PO Box 1866, Mountain View, CA 94042, USA.
+   License summary:
+    You are free to:
+      Share, copy and redistribute the material in any medium or format
+      Adapt, remix, transform, and build upon the material
+    The licensor cannot revoke these freedoms as long as you follow the license terms.
+    Attribution : You must give appropriate credit, provide a link to the license,
+                   and indicate if changes were made. You may do so in any reasonable manner,
+                   but not in any way that suggests the licensor endorses you or your use.
+    NonCommercial : You may not use the material for commercial purposes. **(see note below)
+    ShareAlike : If you remix, transform, or build upon the material, you must distribute
+                  your contributions under the same license as the original.
+    No additional restrictions : You may not apply legal terms or technological measures that
+                                  legally restrict others from doing anything the license permits.
+   ** For commercial use, please contact the original copyright holder(s) to agree licensing terms
+**************************************************************************************************************
+	The FLiM routines have no code or definitions that are specific to any
+	module, so they can be used to provide FLiM facilities for any module 
+	using these libraries.
+	
+*/ 
+/* 
+ * File:   latency.h
+ *
+ * Created on 19 October 2026, 11:20
+ *
+ * Latency from an event being received to the output acting upon it.
+ * Only compiled when LATENCY is defined in module.h.
+ */
+
+#ifndef LATENCY_H
+#define	LATENCY_H
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+#include "GenericTypeDefs.h"
+
+#define LATENCY_BUCKETS     32  // each bucket is 256 ticks, about 4ms
+#define LATENCY_BUCKET_SHIFT 8
+
+/*
+ * Codes for the DIAG_LATENCY diagnostic service. Times are in ticks (16us).
+ */
+#define LATENCY_COUNT       1   // number of latencies recorded
+#define LATENCY_P50         2   // median, to the upper edge of its bucket
+#define LATENCY_P99         3   // 99th percentile, to the upper edge of its bucket
+#define LATENCY_MAX         4   // longest latency, 0xFFFF if one was too long to measure
+#define LATENCY_BUCKET0     0x10    // histogram, codes 0x10 to 0x2F
+                                    // the last bucket also holds everything longer
+
+#ifdef LATENCY
+#define LATENCY_RX_INTERRUPT()  latencyRxInterrupt()
+#define LATENCY_FRAME_TAKEN(received)   latencyFrameTaken(received)
+#define LATENCY_QUEUED(io)      latencyQueued(io)
+#define LATENCY_STARTED(io)     latencyStarted(io)
+#define LATENCY_ACTUATED(io)    latencyActuated(io)
+#define LATENCY_PULSE(io)       latencyPulse(io)
+#define LATENCY_CANCEL(io)      latencyCancel(io)
+#else
+#define LATENCY_RX_INTERRUPT()
+#define LATENCY_FRAME_TAKEN(received)
+#define LATENCY_QUEUED(io)
+#define LATENCY_STARTED(io)
+#define LATENCY_ACTUATED(io)
+#define LATENCY_PULSE(io)
+#define LATENCY_CANCEL(io)
+#endif
+
+extern void latencyInit(void);
+extern void latencyRxInterrupt(void);
+extern void latencyFrameTaken(BOOL received);
+extern void latencyQueued(unsigned char io);
+extern void latencyStarted(unsigned char io);
+extern void latencyActuated(unsigned char io);
+extern void latencyPulse(unsigned char io);
+extern void latencyCancel(unsigned char io);
+extern void latencyPoll(void);
+extern BOOL getLatencyDiagnostic(BYTE code, WORD * value);
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif	/* LATENCY_H */
@@ -0,0 +1,326 @@
+/*
+ Routines for CBUS FLiM operations - part of CBUS libraries for PIC 18F
+  This work is licensed under the:
+      Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International License.
+   To view a copy of this license, visit:
+      http://creativecommons.org/licenses/by-nc-sa/4.0/
+   or send a letter to Creative Commons, PO Box 1866, Mountain View, CA 94042, USA.
+   License summary:
+    You are free to:
+      Share, copy and redistribute the material in any medium or format
+      Adapt, remix, transform, and build upon the material
+    The licensor cannot revoke these freedoms as long as you follow the license terms.
+    Attribution : You must give appropriate credit, provide a link to the license,
+                   and indicate if changes were made. You may do so in any reasonable manner,
+                   but not in any way that suggests the licensor endorses you or your use.
+    NonCommercial : You may not use the material for commercial purposes. **(see note below)
+    ShareAlike : If you remix, transform, or build upon the material, you must distribute
+                  your contributions under the same license as the original.
+    No additional restrictions : You may not apply legal terms or technological measures that
+                                  legally restrict others from doing anything the license permits.
+   ** For commercial use, please contact the original copyright holder(s) to agree licensing terms
+**************************************************************************************************************
+	The FLiM routines have no code or definitions that are specific to any
+	module, so they can be used to provide FLiM facilities for any module 
+	using these libraries.
+	
+*/ 
+/*
+ * File:   learnSession.c
+ *
+ * Created on 21 October 2026, 15:00
+ *
+ * Teaching an event a sequence of actions sends an EVLRN for each EV and 
+ * CBUSlib's addEvent() erases and rewrites the flash block holding the 
+ * event for every one of them. Here the EVLRNs for the same event are 
+ * collected in RAM and acknowledged once it has been checked that the event
+ * table has room for them: the event's own entries and the free entries 
+ * must be enough for the EV number. An EVLRN there isn't room for is given
+ * to CBUSlib, which reports the error straight away. The session ends when
+ * an EVLRN for a different event, another message which learns, unlearns or
+ * reads events or changes the learn mode, or any message addressed to this
+ * node is received, after LEARN_SESSION_TIME without an EVLRN, or when learn
+ * mode is left. Other traffic on the bus, such as events and messages to 
+ * other nodes, leaves the session open. The EVs are then written together:
+ * 
+ *  If the event already has entries for all the EVs, and they are in use,
+ *  every EV is written straight into the event table through the flash 
+ *  image, which writes each block once when it is flushed.
+ *  Otherwise the highest EV is written using addEvent(), which creates the
+ *  event and any continuation entries it needs, and the others are written
+ *  through the flash image. The block holding the highest EV may then be
+ *  written twice.
+ * 
+ * An error when the session is written, which the checks above should
+ * prevent, is reported with CMDERR after the EVLRNs have been acknowledged.
+ * 
+ * The number of flash block writes can be read using RDGN. It is exact for
+ * sessions but for the EVLRN, EVLRNI and EVULN messages CBUSlib handles it
+ * is an estimate of one block per message, as CBUSlib doesn't say how many
+ * blocks it wrote.
+ */
+
+#include <stddef.h>
+#include "devincs.h"
+#include "module.h"
+#include "events.h"
+#include "romops.h"
+#include "cbus.h"
+#include "FliM.h"
+#include "TickTime.h"
+#include "busLoad.h"
+#include "trace.h"
+#include "learnSession.h"
+
+#ifdef LEARN_SESSION
+
+#define LEARN_SESSION_TIME  (5*HUNDRED_MILI_SECOND)
+#define FLASH_BLOCK_SHIFT   6   // 64 byte erase blocks
+
+#define EV_ADDRESS(tableIndex, ev)  (AT_EVENTS + (WORD)(tableIndex)*sizeof(EventTable) + offsetof(EventTable, evs) + (ev))
+
+static const rom near EventTable * eventTable = (const rom near EventTable*)AT_EVENTS;
+
+static BOOL sessionOpen;
+static WORD sessionNN;
+static WORD sessionEN;
+static BYTE sessionEVs[EVperEVT];
+static DWORD sessionSet;        // bit set for each EV collected
+static TickValue lastLearn;
+static BYTE sessionIndex;       // the event's first entry, NO_INDEX if it is new
+static BYTE sessionEntries;     // entries the event has or can have
+static WORD flashWrites;
+static WORD evsLearned;
+static WORD sessions;
+
+// forward declarations
+static void writeSession(void);
+static BYTE lastEntry(BYTE tableIndex, BYTE * entries);
+static void sendError(BYTE error);
+
+/**
+ * Clear the statistics.
+ */
+void learnSessionInit(void) {
+    sessionOpen = FALSE;
+    flashWrites = 0;
+    evsLearned = 0;
+    sessions = 0;
+}
+
+/**
+ * Check whether a received message ends the session and if so write the 
+ * session to flash. Must be called for each message before learnSessionAdd().
+ * @param msg the received message
+ * @return TRUE if the event table was changed
+ */
+BOOL learnSessionEnds(BYTE * msg) {
+    if ( ! sessionOpen) {
+        return FALSE;
+    }
+    switch (msg[d0]) {
+        case OPC_EVLRN:
+            if ((sessionNN == (((WORD)msg[d1] << 8) | msg[d2])) 
+                    && (sessionEN == (((WORD)msg[d3] << 8) | msg[d4]))) {
+                return FALSE;
+            }
+            break;
+        case OPC_EVLRNI:
+        case OPC_EVULN:
+        case OPC_REQEV:
+        case OPC_NNLRN:
+        case OPC_NNULN:
+        case OPC_NNCLR:
+            break;
+        default:
+            if ( ! thisNN(msg)) {
+                return FALSE;   // for other nodes, the session isn't affected
+            }
+    }
+    writeSession();
+    return TRUE;
+}
+
+/**
+ * Collect an EVLRN into the session.
+ * @param msg the received message
+ * @return TRUE if the message was collected and acknowledged, FALSE if it 
+ * should be given to CBUSlib
+ */
+BOOL learnSessionAdd(BYTE * msg) {
+    BYTE evNum;
+    BYTE tableIndex;
+    
+    if ((msg[d0] != OPC_EVLRN) || (flimState != fsFLiMLearn)) {
+        return FALSE;
+    }
+    evNum = msg[d5];
+    if ((evNum == 0) || (evNum > EVperEVT)) {
+        return FALSE;   // let CBUSlib report the error
+    }
+    evNum--;
+    if ( ! sessionOpen) {
+        sessionNN = ((WORD)msg[d1] << 8) | msg[d2];
+        sessionEN = ((WORD)msg[d3] << 8) | msg[d4];
+        sessionIndex = findEvent(sessionNN, sessionEN);
+        sessionEntries = 0;
+        if (sessionIndex != NO_INDEX) {
+            lastEntry(sessionIndex, &sessionEntries);
+        }
+        for (tableIndex=0; tableIndex<NUM_EVENTS; tableIndex++) {
+            if (eventTable[tableIndex].flags.freeEntry) {
+                sessionEntries++;
+            }
+        }
+        sessionSet = 0;
+    }
+    if (evNum/EVENT_TABLE_WIDTH >= sessionEntries) {
+        return FALSE;   // no room, let CBUSlib report the error
+    }
+    sessionOpen = TRUE;
+    sessionEVs[evNum] = msg[d6];
+    sessionSet |= (1UL << evNum);
+    lastLearn.Val = tickGet();
+    if (cbusSendOpcMyNN(0, OPC_WRACK, cbusMsg)) {
+        busLoadFrame(OPC_WRACK, TRUE);
+        TRACE_FRAME(cbusMsg, TRUE);
+    }
+    return TRUE;
+}
+
+/**
+ * Write the session once the EVLRNs have stopped or learn mode has been 
+ * left. Called from the main loop.
+ * @return TRUE if the event table was changed
+ */
+BOOL pollLearnSession(void) {
+    if (sessionOpen && ((flimState != fsFLiMLearn) || (tickTimeSince(lastLearn) > LEARN_SESSION_TIME))) {
+        writeSession();
+        return TRUE;
+    }
+    return FALSE;
+}
+
+/**
+ * Count a flash block write done by CBUSlib when changing the event table.
+ * This is an estimate as CBUSlib may write more than one block.
+ */
+void learnFlashWritten(void) {
+    if (flashWrites != 0xFFFF) flashWrites++;
+}
+
+/**
+ * Write the EVs collected to the event table.
+ */
+static void writeSession(void) {
+    BYTE highest;
+    BYTE evNum;
+    BYTE last;
+    BYTE tableIndex;
+    BYTE entries;
+    BYTE error;
+    WORD address;
+    WORD block;
+    
+    sessionOpen = FALSE;
+    for (highest=EVperEVT-1; highest>0; highest--) {
+        if (sessionSet & (1UL << highest)) break;
+    }
+    tableIndex = sessionIndex;
+    if (tableIndex != NO_INDEX) {
+        last = lastEntry(tableIndex, &entries);
+    }
+    if ((tableIndex != NO_INDEX) && (highest/EVENT_TABLE_WIDTH < entries)
+            && ((highest/EVENT_TABLE_WIDTH < entries - 1) 
+                || (highest%EVENT_TABLE_WIDTH < eventTable[last].flags.eVsUsed))) {
+        // the event already has the highest EV so write them all through the image
+        highest++;
+    } else {
+        error = addEvent(sessionNN, sessionEN, highest, sessionEVs[highest], FALSE);
+        learnFlashWritten();
+        if (error != 0) {
+            sendError(error);
+            return;
+        }
+        tableIndex = findEvent(sessionNN, sessionEN);
+        if (tableIndex == NO_INDEX) {
+            sendError(CMDERR_INV_EV_IDX);
+            return;
+        }
+        if (evsLearned != 0xFFFF) evsLearned++;     // the highest
+    }
+    block = 0xFFFF;
+    for (evNum=0; evNum<highest; evNum++) {
+        if ((evNum > 0) && (evNum % EVENT_TABLE_WIDTH == 0)) {
+            // move to the continuation entry
+            tableIndex = eventTable[tableIndex].next;
+            if (tableIndex >= NUM_EVENTS) {
+                sendError(CMDERR_INV_EV_IDX);
+                break;
+            }
+        }
+        if ( ! (sessionSet & (1UL << evNum))) continue;
+        if (evsLearned != 0xFFFF) evsLearned++;
+        if (eventTable[tableIndex].evs[evNum % EVENT_TABLE_WIDTH] == sessionEVs[evNum]) continue;
+        address = EV_ADDRESS(tableIndex, evNum % EVENT_TABLE_WIDTH);
+        if ((address >> FLASH_BLOCK_SHIFT) != block) {
+            block = address >> FLASH_BLOCK_SHIFT;
+            learnFlashWritten();
+        }
+        writeFlashByte((BYTE*)address, sessionEVs[evNum]);
+    }
+    flushFlashImage();
+    if (sessions != 0xFFFF) sessions++;
+}
+
+/**
+ * Find the last of an event's entries.
+ * @param tableIndex the event's first entry
+ * @param entries where to put the number of entries the event has
+ * @return the index of the last entry
+ */
+static BYTE lastEntry(BYTE tableIndex, BYTE * entries) {
+    *entries = 1;
+    while (eventTable[tableIndex].flags.continued 
+            && (eventTable[tableIndex].next < NUM_EVENTS)
+            && (*entries < (EVperEVT+EVENT_TABLE_WIDTH-1)/EVENT_TABLE_WIDTH)) {
+        tableIndex = eventTable[tableIndex].next;
+        (*entries)++;
+    }
+    return tableIndex;
+}
+
+/**
+ * Report an error writing the session.
+ * @param error the CMDERR code
+ */
+static void sendError(BYTE error) {
+    cbusMsg[d3] = error;
+    if (cbusSendOpcMyNN(0, OPC_CMDERR, cbusMsg)) {
+        busLoadFrame(OPC_CMDERR, TRUE);
+        TRACE_FRAME(cbusMsg, TRUE);
+    }
+}
+
+/**
+ * Get a DIAG_LEARN diagnostic.
+ * @param code the LEARN_xxx code
+ * @param value where to put the value
+ * @return TRUE if a valid code
+ */
+BOOL getLearnDiagnostic(BYTE code, WORD * value) {
+    switch (code) {
+        case LEARN_FLASH_WRITES:
+            *value = flashWrites;
+            return TRUE;
+        case LEARN_EVS:
+            *value = evsLearned;
+            return TRUE;
+        case LEARN_SESSIONS:
+            *value = sessions;
+            return TRUE;
+    }
+    return FALSE;
+}
+
+#endif
@@ -0,0 +1,64 @@
+/*
+ Routines for CBUS FLiM operations - part of CBUS libraries for PIC 18F
+  This work is licensed under the:
+      Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International License.
+   To view a copy of this license, visit:
+      http://creativecommons.org/licenses/by-nc-sa/4.0/
+   or send a letter to Creative Commons, PO Box 1866, Mountain View, CA 94042, USA.
+   License summary:
+    You are free to:
+      Share, copy and redistribute the material in any medium or format
+      Adapt, remix, transform, and build upon the material
+    The licensor cannot revoke these freedoms as long as you follow the license terms.
+    Attribution : You must give appropriate credit, provide a link to the license,
+                   and indicate if changes were made. You may do so in any reasonable manner,
+                   but not in any way that suggests the licensor endorses you or your use.
+    NonCommercial : You may not use the material for commercial purposes. **(see note below)
+    ShareAlike : If you remix, transform, or build upon the material, you must distribute
+                  your contributions under the same license as the original.
+    No additional restrictions : You may not apply legal terms or technological measures that
+                                  legally restrict others from doing anything the license permits.
+   ** For commercial use, please contact the original copyright holder(s) to agree licensing terms
+**************************************************************************************************************
+	The FLiM routines have no code or definitions that are specific to any
+	module, so they can be used to provide FLiM facilities for any module 
+	using these libraries.
+	
+*/ 
+/* 
+ * File:   learnSession.h
+ *
+ * Created on 21 October 2026, 15:00
+ *
+ * Collects the EVLRNs for one event so they are written to flash together.
+ * Only compiled when LEARN_SESSION is defined in module.h.
+ */
+
+#ifndef LEARNSESSION_H
+#define	LEARNSESSION_H
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+#include "GenericTypeDefs.h"
+
+/*
+ * Codes for the DIAG_LEARN diagnostic service
+ */
+#define LEARN_FLASH_WRITES  1   // event table flash blocks erased and written
+#define LEARN_EVS           2   // EVs learned through sessions
+#define LEARN_SESSIONS      3   // sessions written to flash
+
+extern void learnSessionInit(void);
+extern BOOL learnSessionEnds(BYTE * msg);
+extern BOOL learnSessionAdd(BYTE * msg);
+extern BOOL pollLearnSession(void);
+extern void learnFlashWritten(void);
+extern BOOL getLearnDiagnostic(BYTE code, WORD * value);
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif	/* LEARNSESSION_H */
@@ -36,10 +36,9 @@
  * 
  * Timer usage:
  * TMR0 used in ticktime for symbol times. Used to trigger next set of servo pulses
- * TMR1 Servo outputs 0, 4, 8, 12
- * TMR2 Servo outputs 1, 5, 9, 13
- * TMR3 Servo outputs 2, 6, 10, 14
- * TMR4 Servo outputs 3, 7, 11, 15
+ * TMR1 Servo outputs 0-7
+ * TMR2 0.5ms wake up timer for the main loop
+ * TMR3 Servo outputs 8-15
  *
  * Updated on 14 Feb 2019, 17:26
  */
@@ -130,15 +129,34 @@
 #include "can18.h"
 #include "cbus.h"
 #include "actionQueue.h"
+#include "scheduler.h"
+#include "diagnostics.h"
+#include "pendingWork.h"
+#include "supervisor.h"
+#include "txQueue.h"
+#include "rateLimit.h"
+#include "busLoad.h"
+#include "trace.h"
+#include "canFilter.h"
+#include "canRx.h"
+#include "latency.h"
+#include "eventIndex.h"
+#include "evCache.h"
+#include "actionProgram.h"
+#include "producerIndex.h"
+#include "rangeEvents.h"
+#include "eventFilter.h"
+#include "learnSession.h"
+#include "eventCompact.h"
+#include "stateJournal.h"
+#include "profile.h"
 #ifdef SERVO
 #include "servo.h"
 #endif
 #ifdef ANALOGUE
 #include "analogue.h"
 #endif
-#ifdef NV_CACHE
 #include "nvCache.h"
-#endif
 #include "cbus1Track.h"
 #include "eventMods.h"
 
@@ -176,7 +194,6 @@ const rom Config configs[NUM_IO] = {
 
 // forward declarations
 void __init(void);
-BOOL checkCBUS( void);
 void ISRHigh(void);
 void initialise(void);
 void configIO(unsigned char io);
@@ -187,6 +204,16 @@ void setOutputPosition(unsigned char i, unsigned char state, unsigned char type)
 BOOL sendProducedEvent(unsigned char action, BOOL on);
 void factoryResetEE(void);
 void factoryResetFlash(void);
+void processOutputs(void);
+static void pollActions(void);
+static void poll1Track(void);
+static BYTE rateNv(BYTE value, BYTE def, BYTE min, BYTE max);
+static void eventTableChanged(void);
+void setTaskRates(void);
+
+// ACON, ACOF, ASON and ASOF. Bit 0 is the ON/OFF bit and bit 3 the short event bit.
+#define IS_ACCESSORY_OPC(opc)   (((opc) & 0xF6) == OPC_ACON)
+#define ACCESSORY_SHORT_MASK    0x08
 
 #ifdef __18CXX
 void high_irq_errata_fix(void);
@@ -239,9 +266,10 @@ void LOW_INT_VECT(void)
 
 static TickValue   startTime;
 static BOOL        started = FALSE;
-TickValue          lastServoStartTime;
-static TickValue   lastInputScanTime;
-static TickValue   lastActionPollTime;
+static BYTE        work;        // the work to be done on this pass of the main loop
+static BYTE        nextWork;    // work carried over to the next pass
+static WORD        busyStart;
+static WORD        loopTicks;
 static unsigned char io;
 
 #ifdef BOOTLOADER_PRESENT
@@ -270,9 +298,6 @@ int main(void) @0x800 {
     initStatusLeds();
 
     startTime.Val = tickGet();
-    lastServoStartTime.Val = startTime.Val;
-    lastInputScanTime.Val = startTime.Val;
-    lastActionPollTime.Val = startTime.Val;
 
     initialise();
     
@@ -280,46 +305,102 @@ int main(void) @0x800 {
     set1TrackPorts(); //1Track debug only
     io2PinMapping(); //1Track
 
+    // the status LEDs and 1Track run from the start, the other tasks once started
+    schedulerStartTask(TASK_LEDS, tickGet());
+    schedulerStartTask(TASK_1TRACK, tickGet());
+    work = 0;
     while (TRUE) {
-        // Startup delay for CBUS about 2 seconds to let other modules get powered up
-        // ISR will be running so incoming packets processed
-        if (!started && (tickTimeSince(startTime) > (NV->sendSodDelay * HUNDRED_MILI_SECOND) + TWO_SECOND)) {
-            started = TRUE;
-            if (NV->sendSodDelay > 0) {
-                sendProducedEvent(ACTION_PRODUCER_SOD, TRUE);
-            }
+        work |= takePendingWork();
+        if (work == 0) {
+            // nothing to do so sleep until the next interrupt
+            supervisorIdle();
+            idleUntilWork();
+            continue;
         }
-        checkCBUS();    // Consume any CBUS message and act upon it
+        busyStart = (WORD)tickGet();
+        nextWork = 0;
         
-        FLiMSWCheck();  // Check FLiM switch for any mode changes
-        
-        //If the node has been configured for 1Track then also execute the 1Track logic 
-        if ((NV->spare[10] >= STDMODE) && (NV->spare[10] <= THREEMODE)){
-            trackCoreLogic(); // Check all 4 channels of 1Track but not yet generate/consume messages
+        if (work & PENDING_TICK) {
+            // Startup delay for CBUS about 2 seconds to let other modules get powered up
+            // ISR will be running so incoming packets processed
+            if (!started && (tickTimeSince(startTime) > (NV->sendSodDelay * HUNDRED_MILI_SECOND) + TWO_SECOND)) {
+                started = TRUE;
+                schedulerStartTask(TASK_SERVO, tickGet());
+                schedulerStartTask(TASK_INPUTS, tickGet());
+                schedulerStartTask(TASK_ACTIONS, tickGet());
+                schedulerStartTask(TASK_ANALOGUE, tickGet());
+                supervisorStart();
+                if (NV->sendSodDelay > 0) {
+                    queueProducedEvent(ACTION_PRODUCER_SOD, TRUE, TX_PRIORITY_OUTPUT);
+                }
+            }
         }
-        
-        if (started) {
-            #ifdef SERVO
-                        if (tickTimeSince(lastServoStartTime) > 5*HALF_MILLI_SECOND) {
-                            startServos();  // call every 2.5ms
-                            lastServoStartTime.Val = tickGet();
-                        }
-            #endif
-                        if (tickTimeSince(lastInputScanTime) > 5*ONE_MILI_SECOND) {
-                            inputScan();    // Strobe inputs for changes
-                            lastInputScanTime.Val = tickGet();
-                        }
-                        if (tickTimeSince(lastActionPollTime) > 100*ONE_MILI_SECOND) {
-                            processActions();
-                            processOutputs();
-                            lastActionPollTime.Val = tickGet();
-                        }
-            #ifdef ANALOGUE
-                        pollAnalogue();
-            #endif
+        if (work & PENDING_CAN) {
+            PROFILE_BEGIN(PROF_CBUS);
+            if (checkCBUS()) {  // Consume the received CBUS messages and act upon them
+                nextWork |= PENDING_CAN;    // there may be more waiting
+            }
+            PROFILE_END(PROF_CBUS);
+        }
+        if (work & PENDING_TICK) {
+            FLiMSWCheck();  // Check FLiM switch for any mode changes
+            pollBusLoad();  // Bus load buckets and heartbeat
+#ifdef CAN_FILTER
+            pollCanFilter();    // Set up the CAN filters once learning has finished
+#endif
+#ifdef EVENT_INDEX
+            pollEventIndex();   // Rebuild the event index once learning has finished
+#endif
+#ifdef ACTION_PROGRAMS
+            pollActionProgram();    // Recompile the action programs once learning has finished
+#endif
+#ifdef PRODUCER_INDEX
+            pollProducerIndex();    // Rebuild the producer index once learning has finished
+#endif
+#ifdef EVENT_FILTER
+            pollEventFilter();      // Rebuild the event filter once learning has finished
+#endif
+#ifdef LEARN_SESSION
+            if (pollLearnSession()) {   // Write the EVs collected once the EVLRNs stop
+                eventTableChanged();
+            }
+#endif
+#ifdef EVENT_COMPACTION
+            if (pollEventCompact()) {   // Compact the event table if requested
+                eventTableChanged();
+            }
+#endif
+#ifdef STATE_JOURNAL
+            pollStateJournal();     // Write any output state changes once they have settled
+#endif
+#ifdef LATENCY
+            latencyPoll();          // Count the outputs waiting too long to measure
+#endif
+        }
+        if (work & (PENDING_TICK | PENDING_SERVO | PENDING_ADC)) {
+            // servo pulses, input scan, action processing, analogue, status LEDs and 1Track
+            schedulerRun(tickGet());
+        }
+        if (work & (PENDING_TICK | PENDING_CAN)) {
+            // Send any rate limited events which now have tokens
+            pollRateLimit();
+            // Send any produced events waiting for a transmit buffer
+            pollTxQueue();
+            // Keep a SOD going as the transmit buffers empty rather than waiting for the next action poll
+            if (started && sodInProgress()) {
+                processActions();
+            }
+            // Send any outstanding diagnostic responses
+            diagnosticsPoll();
+        }
+        work = nextWork;
+        loopTicks = (WORD)tickGet() - busyStart;
+        if (loopBusy(loopTicks, rateNv(NV->overload_limit, DEFAULT_OVERLOAD_LIMIT, 
+                MIN_OVERLOAD_LIMIT, MAX_OVERLOAD_LIMIT))) {
+            // overload state has changed
+            setTaskRates();
         }
-        // Check for any flashing status LEDs
-        checkFlashing();
+        supervisorPoll(loopTicks);
      } // main loop
 } // main
  
@@ -330,6 +411,12 @@ int main(void) @0x800 {
 void initialise(void) {
     // enable the 4x PLL
     OSCTUNEbits.PLLEN = 1; 
+    // find out why we were reset before anything clears the watchdog
+    initSupervisor();
+#ifdef STATE_JOURNAL
+    // recover the output states before anything uses them
+    stateJournalInit();
+#endif
     
     // check if EEPROM is valid
    if (ee_read((WORD)EE_VERSION) != EEPROM_VERSION) {
@@ -362,6 +449,7 @@ void initialise(void) {
     // RB bits 0,1,4,5 need pullups
     WPUB = NV->pullups; 
     actionQueueInit();
+    txQueueInit();
     mioEventsInit();
     mioFlimInit(); // This will call FLiMinit, which, in turn, calls eventsInit, cbusInit
 #ifdef ANALOGUE
@@ -381,6 +469,61 @@ void initialise(void) {
         configIO(io);
     }
     initInputScan();
+    rateLimitInit();
+    busLoadInit();
+    canRxInit();
+#ifdef TRACE
+    traceInit();
+#endif
+#ifdef EVENT_COMPACTION
+    eventCompactInit();
+#endif
+#ifdef CAN_FILTER
+    canFilterInit();
+#endif
+#ifdef EVENT_INDEX
+    eventIndexInit();
+#endif
+#ifdef EV_CACHE
+    evCacheInit();
+#endif
+#ifdef ACTION_PROGRAMS
+    actionProgramInit();
+#endif
+#ifdef PRODUCER_INDEX
+    producerIndexInit();
+#endif
+#ifdef RANGE_EVENTS
+    rangeEventsInit();
+#endif
+#ifdef LEARN_SESSION
+    learnSessionInit();
+#endif
+#ifdef EVENT_FILTER
+    eventFilterInit();
+#endif
+    initPendingWork();
+    diagnosticsInit();
+#ifdef PROFILE
+    profileInit();
+#endif
+#ifdef LATENCY
+    latencyInit();
+#endif
+    
+    // The periodic jobs. Phases keep them from all falling due on the same pass.
+    // The periods are set from the NVs by setTaskRates().
+#ifdef SERVO
+    schedulerSetTask(TASK_SERVO, startServos, 0, 0);
+#endif
+    schedulerSetTask(TASK_INPUTS, inputScan, 0, ONE_MILI_SECOND);
+    schedulerSetTask(TASK_ACTIONS, pollActions, 0, 3*HALF_MILLI_SECOND);
+#ifdef ANALOGUE
+    schedulerSetTask(TASK_ANALOGUE, pollAnalogue, 0, HALF_MILLI_SECOND);
+#endif
+    schedulerSetTask(TASK_LEDS, checkFlashing, 0, 0);
+    schedulerSetTask(TASK_1TRACK, poll1Track, 0, 0);
+    setTaskRates();
 
     /*
      * Now configure the interrupts.
@@ -394,6 +537,62 @@ void initialise(void) {
     ei(); 
 }
 
+/**
+ * Get the value of a rate NV.
+ * @param value the NV value
+ * @param def the default
+ * @param min the minimum valid value
+ * @param max the maximum valid value
+ * @return the value or the default if the value is 0 or out of range
+ */
+static BYTE rateNv(BYTE value, BYTE def, BYTE min, BYTE max) {
+    if ((value == 0) || (value < min) || (value > max)) {
+        return def;
+    }
+    return value;
+}
+
+/**
+ * Set the periods of the scheduled tasks from the NVs. The low priority polls
+ * are slowed down by the overload stretch factor.
+ * Called at startup, when a rate NV is changed and when the stretch factor changes.
+ */
+void setTaskRates(void) {
+    BYTE stretch = getLoopStretch();
+    BYTE scanPeriod = rateNv(NV->input_scan_period, DEFAULT_INPUT_SCAN_PERIOD, 1, MAX_INPUT_SCAN_PERIOD);
+    
+    schedulerSetPeriod(TASK_SERVO, (WORD)(rateNv(NV->servo_slot_period, DEFAULT_SERVO_SLOT_PERIOD, 
+            MIN_SERVO_SLOT_PERIOD, MAX_SERVO_SLOT_PERIOD) * HALF_MILLI_SECOND));
+    schedulerSetPeriod(TASK_INPUTS, (WORD)(scanPeriod * ONE_MILI_SECOND));
+    setInputScanPeriod(scanPeriod);     // the input delays are in ms not scans
+    schedulerSetPeriod(TASK_ACTIONS, (WORD)(rateNv(NV->action_poll_period, DEFAULT_ACTION_POLL_PERIOD, 
+            1, MAX_ACTION_POLL_PERIOD) * 10 * ONE_MILI_SECOND));
+    // low priority
+    schedulerSetPeriod(TASK_ANALOGUE, (WORD)(rateNv(NV->analogue_poll_period, DEFAULT_ANALOGUE_POLL_PERIOD, 
+            1, MAX_ANALOGUE_POLL_PERIOD) * stretch * HALF_MILLI_SECOND));
+    schedulerSetPeriod(TASK_LEDS, (WORD)(rateNv(NV->led_poll_period, DEFAULT_LED_POLL_PERIOD, 
+            1, MAX_LED_POLL_PERIOD) * stretch * ONE_MILI_SECOND));
+    schedulerSetPeriod(TASK_1TRACK, (WORD)(rateNv(NV->track_poll_period, DEFAULT_1TRACK_POLL_PERIOD, 
+            1, MAX_1TRACK_POLL_PERIOD) * stretch * ONE_MILI_SECOND));
+}
+
+/**
+ * If the node has been configured for 1Track then also execute the 1Track logic.
+ */
+static void poll1Track(void) {
+    if ((NV->track_mode >= STDMODE) && (NV->track_mode <= THREEMODE)){
+        trackCoreLogic(); // Check all 4 channels of 1Track but not yet generate/consume messages
+    }
+}
+
+/**
+ * The action queue and the pulse/flash outputs are progressed together.
+ */
+static void pollActions(void) {
+    processActions();
+    processOutputs();
+}
+
 /**
  * set EEPROM to default values
  */
@@ -412,6 +611,7 @@ void factoryResetEE(void) {
 void factoryReset(void) {
     factoryResetEE();
     factoryResetFlash();
+    setTaskRates();
 }
 
 void factoryResetFlash(void) {
@@ -421,8 +621,10 @@ void factoryResetFlash(void) {
     clearAllEvents();
     // perform other actions based upon type
     for (io=0; io<NUM_IO; io++) {
+        ClrWdt();   // rewriting all the IOs is slow so don't let the watchdog expire
         setType(io, TYPE_DEFAULT);
     } 
+    FLUSH_NV();
     flushFlashImage();
 }
 
@@ -432,12 +634,7 @@ void factoryResetFlash(void) {
  * @param type the new Type
  */
 void setType(unsigned char io, unsigned char type) {
-    WORD addr;
-    addr = AT_NV+NV_IO_TYPE(io);
-    writeFlashByte((BYTE*)addr, type);
-#ifdef NV_CACHE
-    NV->io[io].type = type;
-#endif
+    WRITE_NV(NV_IO_TYPE(io), type);
     // set to default NVs
     defaultNVs(io, type);
     // set the pin input/output
@@ -461,26 +658,95 @@ void setType(unsigned char io, unsigned char type) {
  * it if one has been received.
  * @return true if a message has been received.
  */
-BOOL checkCBUS( void ) {
+BOOL receiveCBUS( void ) {
     BYTE    msg[20];
+    BOOL    handled;
+#ifdef FAST_ACCESSORY_PATH
+    BYTE    tableIndex;
+#endif
 
     if (cbusMsgReceived( 0, (BYTE *)msg )) {
+        LATENCY_FRAME_TAKEN(TRUE);
+        busLoadFrame(msg[d0], FALSE);
+        TRACE_FRAME(msg, FALSE);
         shortFlicker();         // short flicker LED when a CBUS message is seen on the bus
-        if (parseCBUSMsg(msg)) {               // Process the incoming message
+        PROFILE_BEGIN(PROF_ACCESSORY);  // only recorded for accessory events
+#ifdef FAST_ACCESSORY_PATH
+        // In normal FLiM operation the accessory events only need looking up
+        if (IS_ACCESSORY_OPC(msg[d0]) && (flimState == fsFLiM)) {
+            // short events are stored with NN of 0
+            tableIndex = LOOKUP_EVENT((msg[d0] & ACCESSORY_SHORT_MASK) ? 0 : ((WORD)msg[d1] << 8) | msg[d2], 
+                    ((WORD)msg[d3] << 8) | msg[d4]);
+            if (tableIndex != NO_INDEX) {
+                processEvent(tableIndex, msg);
+                longFlicker();
+            }
+            PROFILE_END(PROF_ACCESSORY);
+            return TRUE;
+        }
+#endif
+#ifdef NV_CACHE
+        if ((msg[d0] == OPC_NVSET) && thisNN(msg)) {
+            nvCacheUpdate(msg[d3]);     // only the NV being set needs reloading
+        }
+#endif
+#ifdef LEARN_SESSION
+        if (learnSessionEnds(msg)) {
+            eventTableChanged();
+        }
+        if (learnSessionAdd(msg)) {
+            longFlicker();
+            return TRUE;
+        }
+#endif
+#ifdef EVENT_COMPACTION
+        if (eventCompactCommand(msg)) {     // after any learn session has been written
+            return TRUE;
+        }
+#endif
+        handled = parseCBUSMsg(msg);    // Process the incoming message
+#ifdef NV_CACHE
+        nvCacheUpdate(NV_CACHE_ALL);    // in case the NVSET was rejected without a reload
+#endif
+#ifdef PROFILE
+        if (IS_ACCESSORY_OPC(msg[d0])) {
+            profileEnd(PROF_ACCESSORY);
+        }
+#endif
+        if (handled) {
             longFlicker();      // extend the flicker if we processed the message
+            switch (msg[d0]) {
+            case OPC_EVLRN:
+            case OPC_EVLRNI:
+            case OPC_EVULN:
+#ifdef LEARN_SESSION
+                learnFlashWritten();
+#endif
+                // fall through
+            case OPC_NNCLR:
+            case OPC_NVSET:     // changing the type of an IO changes its events
+                eventTableChanged();
+            }
             return TRUE;
         }
         if (thisNN(msg)) {
             // handle the CANMIO specifics
             switch (msg[d0]) {
+            case OPC_RDGN:  // request diagnostics
+                diagnosticsRequest(msg);
+                return TRUE;
             case OPC_NNRSM: // reset to manufacturer defaults
                 if (flimState == fsFLiMLearn) {
                     factoryReset();
+                    eventTableChanged();
                 }
                 else 
                 {
                     cbusMsg[d3] = CMDERR_NOT_LRN;
-                    cbusSendOpcMyNN( 0, OPC_CMDERR, cbusMsg);
+                    if (cbusSendOpcMyNN( 0, OPC_CMDERR, cbusMsg)) {
+                        busLoadFrame(OPC_CMDERR, TRUE);
+                        TRACE_FRAME(cbusMsg, TRUE);
+                    }
                 }
                 return TRUE;
             case OPC_NNRST: // restart
@@ -489,11 +755,40 @@ BOOL checkCBUS( void ) {
                 Reset();
             }
         }
+        return TRUE;
     }
+    LATENCY_FRAME_TAKEN(FALSE);
     return FALSE;
 }
 
 
+/**
+ * Tell everything which depends upon the event table that it may have changed.
+ */
+static void eventTableChanged(void) {
+#ifdef EV_CACHE
+    evCacheInvalidate();
+#endif
+#ifdef RANGE_EVENTS
+    rangeEventsChanged();
+#endif
+#ifdef CAN_FILTER
+    canFilterChanged();
+#endif
+#ifdef EVENT_INDEX
+    eventIndexChanged();
+#endif
+#ifdef ACTION_PROGRAMS
+    actionProgramChanged();
+#endif
+#ifdef PRODUCER_INDEX
+    producerIndexChanged();
+#endif
+#ifdef EVENT_FILTER
+    eventFilterChanged();
+#endif
+}
+
 /**
  * Set up an IO based upon the specified type.
  * Set the port to input or output then call setOutput for the currently remembered state.
@@ -504,7 +799,7 @@ void configIO(unsigned char i) {
     // If this is an output (OUTPUT, SERVO, BOUNCE) set the value to valued saved in EE
     // servos will also force this in servo.c without checking STARTUP
     if (NV->io[i].flags & FLAG_STARTUP) {
-        setOutputPosition(i, ee_read((WORD)EE_OP_STATE+i), NV->io[i].type);
+        setOutputPosition(i, READ_OUTPUT_STATE(i), NV->io[i].type);
     }
     // Now actually set it
     switch (configs[i].port) {
@@ -576,8 +871,20 @@ void ISRLow(void) {
 #else
     void interrupt low_priority low_isr(void) {
 #endif
+    if (PIR5 & 0x03) {
+        // RXB0IF or RXB1IF, the other CAN flags don't need the main loop
+        pendingWork |= PENDING_CAN;
+        LATENCY_RX_INTERRUPT();
+    }
     tickISR();
     canInterruptHandler();
+    wakeTimerInterruptHandler();
+#ifdef ANALOGUE
+    if (PIR1bits.ADIF) {
+        PIR1bits.ADIF = 0;
+        pendingWork |= PENDING_ADC;
+    }
+#endif
 }
 
 // Interrupt service routines
@@ -598,10 +905,12 @@ void ISRHigh(void) {
     if (PIR1bits.TMR1IF) {
         timer1DoneInterruptHandler();
         PIR1bits.TMR1IF = 0;
+        pendingWork |= PENDING_SERVO;
     }
     if (PIR2bits.TMR3IF) {
         timer3DoneInterruptHandler();
         PIR2bits.TMR3IF = 0;
+        pendingWork |= PENDING_SERVO;
     }
 #endif
 }
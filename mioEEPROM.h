@@ -57,6 +57,11 @@ extern "C" {
      */
 #define EE_OP_STATE         ((WORD)(EE_APPLICATION)-17)    // Space to store current state of up to 16 outputs
                                                  // You'll need to do ee_read(EE_OP_STATE + io)
+    /**
+     * Journal of output state changes, see stateJournal.c
+     */
+#define JOURNAL_SIZE        256
+#define EE_STATE_JOURNAL    ((WORD)(EE_OP_STATE)-JOURNAL_SIZE)
     
 
 #ifdef	__cplusplus
@@ -50,10 +50,18 @@
 #include "actionQueue.h"
 #include "FliM.h"
 #include "analogue.h"
+#include "txQueue.h"
+#include "latency.h"
+#include "evCache.h"
+#include "stateJournal.h"
+#include "actionProgram.h"
+#include "rangeEvents.h"
 
 // forward declarations
 void clearEvents(unsigned char i);
-void doSOD(void);
+static void interpretEVs(BOOL on);
+static void emitAction(CONSUMER_ACTION_T action, BOOL expedite);
+BOOL doSOD(void);
 void doWait(unsigned int duration);
 
 extern void startOutput(unsigned char io, unsigned char action, unsigned char type);
@@ -61,7 +69,6 @@ extern void setOutputState(unsigned char io, unsigned char action, unsigned char
 extern void doAction(unsigned char io, unsigned char state);
 extern void inputScan(BOOL report);
 extern BOOL sendProducedEvent(unsigned char action, BOOL on);
-BOOL sendInvertedProducedEvent(PRODUCER_ACTION_T action, BOOL state, BOOL invert);
 extern BOOL needsStarting(unsigned char io, unsigned char action, unsigned char type);
 extern BOOL completed(unsigned char io, unsigned char action, unsigned char type);
 
@@ -69,9 +76,15 @@ extern BYTE outputState[NUM_IO];
 extern unsigned char currentPos[NUM_IO];
 
 static TickValue startWait;
+static unsigned char sodIo;     // the IO the SOD has reached
+static unsigned char sodStep;   // the event of the IO the SOD has reached
+static BYTE * compileTo;        // the program being compiled, NULL when queueing actions
+static BYTE compiledActions;    // number of actions put in the program so far
 
 void mioEventsInit(void) {
     startWait.Val = 0;
+    sodIo = 0;
+    sodStep = 0;
 }
 
 /**
@@ -212,6 +225,105 @@ void clearEvents(unsigned char io) {
  * The actions are pushed onto the actionQueue for subsequent processing in
  * sequence.
  * 
+ * @param tableIndex the required action to be performed.
+ * @param msg the full CBUS message so that OPC  and DATA can be retrieved.
+ */
+void processEvent(BYTE tableIndex, BYTE * msg) {
+    BOOL on;
+    BYTE error;
+    
+    // check the OPC if this is an ON or OFF event
+    on = ! (msg[d0]&EVENT_ON_MASK);
+#ifdef ACTION_PROGRAMS
+    // use the precompiled actions if they are up to date
+    if (runActionProgram(tableIndex, on)) {
+        return;
+    }
+#endif
+    error = GET_EVS(tableIndex);
+#ifdef SAFETY
+    if (error != 0) {
+        return; // error getting EVs. Can't report the error so just return
+    }
+#endif
+#ifdef RANGE_EVENTS
+    if (evs[1] == ACTION_CONSUMER_RANGE) {
+        expandRange(tableIndex, msg);
+    }
+#endif
+    compileTo = NULL;
+    interpretEVs(on);
+}
+
+#ifdef ACTION_PROGRAMS
+/**
+ * Work out the actions of an event in the order processEvent() would queue
+ * them, without queueing them.
+ * 
+ * The 1Track check of executeAction() depends upon the current state so it
+ * is not done. Action programs must not be used when 1Track is enabled.
+ * 
+ * @param tableIndex the event
+ * @param on TRUE for the ON actions, FALSE for the OFF actions
+ * @param program where to put the program, the expedited bitmap then up to 
+ * MAX_PROGRAM_ACTIONS actions. Unused actions are NO_ACTION
+ * @return FALSE if the EVs couldn't be read or there were too many actions
+ */
+BOOL compileActionProgram(BYTE tableIndex, BOOL on, BYTE * program) {
+    BYTE i;
+    
+    if (getEVs(tableIndex) != 0) {
+        return FALSE;
+    }
+#ifdef RANGE_EVENTS
+    if (evs[1] == ACTION_CONSUMER_RANGE) {
+        return FALSE;   // the actions depend upon the event received
+    }
+#endif
+    program[0] = 0;    // nothing expedited
+    for (i=1; i<=MAX_PROGRAM_ACTIONS; i++) {
+        program[i] = NO_ACTION;
+    }
+    compileTo = program;
+    compiledActions = 0;
+    interpretEVs(on);
+    return compiledActions <= MAX_PROGRAM_ACTIONS;
+}
+#endif
+
+/**
+ * Queue an action, or add it to the program being compiled.
+ * @param action the action
+ * @param expedite TRUE if it goes in the expedited queue
+ */
+static void emitAction(CONSUMER_ACTION_T action, BOOL expedite) {
+    if (compileTo == NULL) {
+        if (expedite) {
+            setExpeditedActions();
+        }
+        pushAction(action);
+        setNormalActions();
+        if ((action&ACTION_MASK) >= ACTION_CONSUMER_IO_BASE) {
+            LATENCY_QUEUED(CONSUMER_IO(action&ACTION_MASK));
+        }
+        return;
+    }
+#ifdef ACTION_PROGRAMS
+    if (compiledActions < MAX_PROGRAM_ACTIONS) {
+        if (expedite) {
+            compileTo[0] |= (1 << compiledActions);
+        }
+        compileTo[1+compiledActions] = action;
+    }
+    if (compiledActions <= MAX_PROGRAM_ACTIONS) {
+        compiledActions++;  // one more than MAX_PROGRAM_ACTIONS means too many
+    }
+#endif
+}
+
+/**
+ * Turn the EVs in evs[] into the actions to be queued.
+ * 
  * If an event is defined to have actions A1, A2, A3, A4 and A2 has the SIMULANEOUS 
  * flag set then the sequence will be executed for ON event: A1, A2&A3, A4 and
  * we therefore put:
@@ -223,28 +335,19 @@ void clearEvents(unsigned char io) {
  * into the action queue. Therefore when doing an OFF Event we need to fiddle
  * with the SIMULTANEOUS bit.
  * 
- * @param tableIndex the required action to be performed.
- * @param msg the full CBUS message so that OPC  and DATA can be retrieved.
+ * @param on TRUE for an ON event
  */
-void processEvent(BYTE tableIndex, BYTE * msg) {
+static void interpretEVs(BOOL on) {
     unsigned char e;
     unsigned char io;
     unsigned char ca;
     int action;
     BOOL executeCheck; //1Track specific
+    BOOL expedite;
 
-    BYTE opc = getEVs(tableIndex);
-#ifdef SAFETY
-    if (opc != 0) {
-        return; // error getting EVs. Can't report the error so just return
-    }
-#endif
-    opc=msg[d0];
-    // check the OPC if this is an ON or OFF event
-    if ( ! (opc&EVENT_ON_MASK)) {
+    if (on) {
         // ON events work up through the EVs
         // EV#0 is for produced event so start at 1
-        // TODO would be more efficient to get all the EVs in one go and then work through them. getEV() isn't quick)
         for (e=1; e<EVperEVT ;e++) { 
             action = evs[e];  // we don't mask out the SEQUENTIAL flag so it could be specified in EVs
             if (action != NO_ACTION) {
@@ -252,17 +355,20 @@ void processEvent(BYTE tableIndex, BYTE * msg) {
                 if ((action&ACTION_MASK) <= NUM_CONSUMER_ACTIONS) {
                     // check global consumed actions
                     if ((action&ACTION_MASK) < ACTION_CONSUMER_IO_BASE) {
-                        pushAction((CONSUMER_ACTION_T)action);
+                        emitAction((CONSUMER_ACTION_T)action, FALSE);
                     } else {
                         io = CONSUMER_IO(action&ACTION_MASK);
                         ca = CONSUMER_ACTION(action&ACTION_MASK);
                         executeCheck = TRUE;//1Track related
+                        expedite = FALSE;
                         switch (NV->io[io].type) {
                             case TYPE_OUTPUT:
                                 if (NV->io[io].flags & FLAG_EXPEDITED_ACTIONS) {
-                                    setExpeditedActions();
+                                    expedite = TRUE;
+                                }
+                                if (compileTo == NULL) {
+                                    executeCheck = executeAction (io, ca, action);//1Track related
                                 }
-                                executeCheck = executeAction (io, ca, action);//1Track related
                                 // fall through
                             case TYPE_SERVO:
                             case TYPE_BOUNCE:
@@ -272,12 +378,11 @@ void processEvent(BYTE tableIndex, BYTE * msg) {
                                 }
                                 //1Track specific addition, will break without any action when the local state requires it
                                 if (executeCheck){
-                                    pushAction((CONSUMER_ACTION_T)action);
+                                    emitAction((CONSUMER_ACTION_T)action, expedite);
                                 }
-                                setNormalActions();
                                 break;
                             case TYPE_MULTI:
-                                pushAction((CONSUMER_ACTION_T)action);
+                                emitAction((CONSUMER_ACTION_T)action, FALSE);
                                 break;
                             default:
                                 // shouldn't happen - just ignore
@@ -289,7 +394,7 @@ void processEvent(BYTE tableIndex, BYTE * msg) {
         } 
     } else {
         // OFF events work down through the EVs
-        int nextAction = getEv(tableIndex, EVperEVT-1);
+        int nextAction = evs[EVperEVT-1];
         for (e=EVperEVT-1; e>=1 ;e--) { 
             unsigned char nextSimultaneous;
             action = nextAction;  // we don't mask out the SIMULTANEOUS flag so it could be specified in EVs
@@ -306,14 +411,15 @@ void processEvent(BYTE tableIndex, BYTE * msg) {
                 if (action <= NUM_CONSUMER_ACTIONS) {
                     // check global consumed actions
                     if (action < ACTION_CONSUMER_IO_BASE) {
-                        pushAction(action|nextSimultaneous);
+                        emitAction(action|nextSimultaneous, FALSE);
                     } else {
                         io = CONSUMER_IO(action);
                         ca = CONSUMER_ACTION(action);
+                        expedite = FALSE;
                         switch (NV->io[io].type) {
                             case TYPE_OUTPUT:
                                 if (NV->io[io].flags & FLAG_EXPEDITED_ACTIONS) {
-                                    setExpeditedActions();
+                                    expedite = TRUE;
                                 }
                                 if (ca == ACTION_IO_CONSUMER_4) {
                                     // action 4 (Flash) must be converted to 3(OFF)
@@ -326,11 +432,10 @@ void processEvent(BYTE tableIndex, BYTE * msg) {
                                     // action 1 (EV) must be converted to 3(OFF)
                                     action += 2;
                                 }
-                                pushAction(action|nextSimultaneous);
-                                setNormalActions();
+                                emitAction(action|nextSimultaneous, expedite);
                                 break;
                             case TYPE_MULTI:
-                                pushAction(action|nextSimultaneous);
+                                emitAction(action|nextSimultaneous, FALSE);
                                 break;
                             default:
                                 // shouldn't happen - just ignore
@@ -339,7 +444,7 @@ void processEvent(BYTE tableIndex, BYTE * msg) {
                     }
                 }
             }
-        } // ignore getEv errors as we expect CMDERR_NO_EV
+        }
     }
 }
 
@@ -364,9 +469,10 @@ void processActions(void) {
     }
     // Check for SOD
     if (action == ACTION_CONSUMER_SOD) {
-        // Do the SOD
-        doSOD();
-        doneAction();
+        // Do the SOD, this may take several calls
+        if (doSOD()) {
+            doneAction();
+        }
         return;
     }
     if (action == ACTION_CONSUMER_WAIT05) {
@@ -398,6 +504,8 @@ void processActions(void) {
         setOutputState(io, ioAction, type);
         if (needsStarting(io, ioAction, type)) {
             startOutput(io, ioAction, type);
+        } else {
+            LATENCY_CANCEL(io);
         }
         // is this the start of a new action?
 //        if (lastAction != action) {
@@ -461,63 +569,141 @@ void doWait(unsigned int duration) {
     }
 }
 /**
- * Do the consumed SOD action. This sends events to indicate current state of the system.
+ * Get one of the events to be sent for SOD. Each IO has a number of steps
+ * depending upon its type, each step being a produced event.
+ * 
+ * @param io the IO
+ * @param step the step for this IO, starting at 0
+ * @param action where to put the produced action
+ * @param state where to put the state to be reported
+ * @return FALSE if there are no more steps for this IO
  */
-void doSOD(void) {
+static BOOL getSODEvent(unsigned char io, unsigned char step, PRODUCER_ACTION_T * action, BOOL * state) {
     unsigned char midway;
-    BOOL state;
-    unsigned char io;
     
-    // Although I agreed with Pete that SOD is only applicable to EV#2 I actually allow it at any EV#
-
-    for (io=0; io < NUM_IO; io++) {
-        unsigned char event_inverted = NV->io[io].flags & FLAG_RESULT_EVENT_INVERTED;
-        switch(NV->io[io].type) {
-            case TYPE_INPUT:
-                /* The TRIGGER_INVERTED has already been taken into account when saved in outputState. No need to check again */
-                while ( ! sendInvertedProducedEvent(ACTION_IO_PRODUCER_INPUT(io), outputState[io], event_inverted)) ;
-                break;
-            case TYPE_OUTPUT:
-                state = ee_read(EE_OP_STATE+io);
-                while ( ! sendInvertedProducedEvent(ACTION_IO_PRODUCER_OUTPUT(io), state!=ACTION_IO_CONSUMER_3, event_inverted));
-                break;
+    switch(NV->io[io].type) {
+        case TYPE_INPUT:
+            if (step > 0) return FALSE;
+            /* The TRIGGER_INVERTED has already been taken into account when saved in outputState. No need to check again */
+            *action = ACTION_IO_PRODUCER_INPUT(io);
+            *state = outputState[io];
+            return TRUE;
+        case TYPE_OUTPUT:
+            if (step > 0) return FALSE;
+            *action = ACTION_IO_PRODUCER_OUTPUT(io);
+            *state = (READ_OUTPUT_STATE(io) != ACTION_IO_CONSUMER_3);
+            return TRUE;
 #ifdef SERVO
-            case TYPE_SERVO:
-                while ( ! sendInvertedProducedEvent(ACTION_IO_PRODUCER_SERVO_START(io), currentPos[io] == NV->io[io].nv_io.nv_servo.servo_start_pos, event_inverted));
-                while ( ! sendInvertedProducedEvent(ACTION_IO_PRODUCER_SERVO_END(io), currentPos[io] == NV->io[io].nv_io.nv_servo.servo_end_pos, event_inverted));
-                // send the last mid
-                midway = (NV->io[io].nv_io.nv_servo.servo_end_pos)/2 + 
-                         (NV->io[io].nv_io.nv_servo.servo_start_pos)/2;
-                while ( ! sendInvertedProducedEvent(ACTION_IO_PRODUCER_SERVO_MID(io), currentPos[io] >= midway, event_inverted));
-                break;
+        case TYPE_SERVO:
+            switch (step) {
+                case 0:
+                    *action = ACTION_IO_PRODUCER_SERVO_START(io);
+                    *state = (currentPos[io] == NV->io[io].nv_io.nv_servo.servo_start_pos);
+                    return TRUE;
+                case 1:
+                    *action = ACTION_IO_PRODUCER_SERVO_END(io);
+                    *state = (currentPos[io] == NV->io[io].nv_io.nv_servo.servo_end_pos);
+                    return TRUE;
+                case 2:
+                    // send the last mid
+                    midway = (NV->io[io].nv_io.nv_servo.servo_end_pos)/2 + 
+                             (NV->io[io].nv_io.nv_servo.servo_start_pos)/2;
+                    *action = ACTION_IO_PRODUCER_SERVO_MID(io);
+                    *state = (currentPos[io] >= midway);
+                    return TRUE;
+            }
+            return FALSE;
 #ifdef BOUNCE
-            case TYPE_BOUNCE:
-                state = ee_read(EE_OP_STATE+io);
-                while ( ! sendInvertedProducedEvent(ACTION_IO_PRODUCER_BOUNCE(io), state, event_inverted));
-                break;
+        case TYPE_BOUNCE:
+            if (step > 0) return FALSE;
+            *action = ACTION_IO_PRODUCER_BOUNCE(io);
+            *state = READ_OUTPUT_STATE(io);
+            return TRUE;
 #endif
 #ifdef MULTI
-            case TYPE_MULTI:
-                while ( ! sendInvertedProducedEvent(ACTION_IO_PRODUCER_MULTI_AT1(io), currentPos[io] == NV->io[io].nv_io.nv_multi.multi_pos1, event_inverted));
-                while ( ! sendInvertedProducedEvent(ACTION_IO_PRODUCER_MULTI_AT2(io), currentPos[io] == NV->io[io].nv_io.nv_multi.multi_pos2, event_inverted));
-                while ( ! sendInvertedProducedEvent(ACTION_IO_PRODUCER_MULTI_AT3(io), currentPos[io] == NV->io[io].nv_io.nv_multi.multi_pos3, event_inverted));
-                if (NV->io[io].nv_io.nv_multi.multi_num_pos > 3) {
-                    while ( ! sendInvertedProducedEvent(ACTION_IO_PRODUCER_MULTI_AT4(io), currentPos[io] == NV->io[io].nv_io.nv_multi.multi_pos4, event_inverted));
-                }
-                break;
+        case TYPE_MULTI:
+            switch (step) {
+                case 0:
+                    *action = ACTION_IO_PRODUCER_MULTI_AT1(io);
+                    *state = (currentPos[io] == NV->io[io].nv_io.nv_multi.multi_pos1);
+                    return TRUE;
+                case 1:
+                    *action = ACTION_IO_PRODUCER_MULTI_AT2(io);
+                    *state = (currentPos[io] == NV->io[io].nv_io.nv_multi.multi_pos2);
+                    return TRUE;
+                case 2:
+                    *action = ACTION_IO_PRODUCER_MULTI_AT3(io);
+                    *state = (currentPos[io] == NV->io[io].nv_io.nv_multi.multi_pos3);
+                    return TRUE;
+                case 3:
+                    if (NV->io[io].nv_io.nv_multi.multi_num_pos > 3) {
+                        *action = ACTION_IO_PRODUCER_MULTI_AT4(io);
+                        *state = (currentPos[io] == NV->io[io].nv_io.nv_multi.multi_pos4);
+                        return TRUE;
+                    }
+            }
+            return FALSE;
 #endif
 #endif
 #ifdef ANALOGUE
-            case TYPE_ANALOGUE_IN:
-            case TYPE_MAGNET:
-                while ( ! sendInvertedProducedEvent(ACTION_IO_PRODUCER_MAGNETL(io), eventState[io] == ANALOGUE_EVENT_LOWER, event_inverted));
-                while ( ! sendInvertedProducedEvent(ACTION_IO_PRODUCER_MAGNETH(io), eventState[io] == ANALOGUE_EVENT_UPPER, event_inverted));
-                break;
+        case TYPE_ANALOGUE_IN:
+        case TYPE_MAGNET:
+            switch (step) {
+                case 0:
+                    *action = ACTION_IO_PRODUCER_MAGNETL(io);
+                    *state = (eventState[io] == ANALOGUE_EVENT_LOWER);
+                    return TRUE;
+                case 1:
+                    *action = ACTION_IO_PRODUCER_MAGNETH(io);
+                    *state = (eventState[io] == ANALOGUE_EVENT_UPPER);
+                    return TRUE;
+            }
+            return FALSE;
 #endif
+    }
+    return FALSE;
+}
+
+/**
+ * Do the consumed SOD action. This sends events to indicate current state of the system.
+ * 
+ * Queues as many events as the SOD transmit queue will take and then returns
+ * so the rest of the main loop can run. The position reached is kept in 
+ * sodIo and sodStep and the next call carries on from there. The SOD queue
+ * has the lowest priority so input and servo changes are sent first.
+ * 
+ * @return TRUE once all the events have been sent
+ */
+BOOL doSOD(void) {
+    PRODUCER_ACTION_T action;
+    BOOL state;
+    
+    // Although I agreed with Pete that SOD is only applicable to EV#2 I actually allow it at any EV#
+    while (sodIo < NUM_IO) {
+        if (getSODEvent(sodIo, sodStep, &action, &state)) {
+            if ( ! txQueueHasSpace(TX_PRIORITY_SOD)) {
+                // transmit queue full, carry on next time
+                return FALSE;
+            }
+            queueInvertedProducedEvent(action, state, NV->io[sodIo].flags & FLAG_RESULT_EVENT_INVERTED, TX_PRIORITY_SOD);
+            sodStep++;
+        } else {
+            // this IO is done
+            sodIo++;
+            sodStep = 0;
         }
     }
+    // finished, ready for the next SOD
+    sodIo = 0;
+    sodStep = 0;
+    return TRUE;
 }
 
-BOOL sendInvertedProducedEvent(PRODUCER_ACTION_T action, BOOL state, BOOL invert) {
-    return sendProducedEvent(action, invert?!state:state);
+/**
+ * Whether a SOD is part way through. The main loop calls processActions() 
+ * more often whilst this is TRUE so the SOD completes quickly.
+ * @return TRUE if a SOD has been started but not finished
+ */
+BOOL sodInProgress(void) {
+    return (sodIo != 0) || (sodStep != 0);
 }
@@ -84,6 +84,7 @@ extern "C" {
 #define ACTION_IO_CONSUMER_4                3
 #define CONSUMER_ACTIONS_PER_IO             4   
 #define NUM_CONSUMER_ACTIONS                (ACTION_CONSUMER_IO_BASE + NUM_IO * CONSUMER_ACTIONS_PER_IO)      
+#define ACTION_CONSUMER_RANGE               ACTION_MASK // only as EV#1, marks a range entry see rangeEvents.c
     
 /* PRODUCED actions */    
 #define ACTION_PRODUCER_BASE                0
@@ -171,17 +172,27 @@ extern void clearEvents(unsigned char i);
 #define AT_EVENTS               0xEF80      //(AT_NV - sizeof(EventTable)*NUM_EVENTS) Size=256 * 22 = 5632(0x1600) bytes
 #endif
 
+#ifdef ACTION_PROGRAMS
+// Each event's precompiled actions, an ON program then an OFF program. 
+// A program is a bitmap of the expedited actions followed by the actions.
+#define MAX_PROGRAM_ACTIONS     7
+#define PROGRAM_SIZE            (2*(1+MAX_PROGRAM_ACTIONS))
+#define AT_PROGRAMS             0xDF80      //(AT_EVENTS - PROGRAM_SIZE*NUM_EVENTS) rounded down to a flash block
+#endif
+
 // We'll also be using configurable produced events
 #define PRODUCED_EVENTS
 #define ConsumedActionType  BYTE;
 
 extern void processEvent(BYTE eventIndex, BYTE* message);
+#ifdef ACTION_PROGRAMS
+extern BOOL compileActionProgram(BYTE tableIndex, BOOL on, BYTE * program);
+#endif
 extern void processActions(void);
+extern BOOL sodInProgress(void);
 
 #include "events.h"
 
-extern BOOL sendInvertedProducedEvent(PRODUCER_ACTION_T action, BOOL state, BOOL invert);
-
 #ifdef	__cplusplus
 }
 #endif
@@ -44,15 +44,14 @@
 #include "events.h"
 #include "romops.h"
 #include "FliM.h"
-#ifdef NV_CACHE
 #include "nvCache.h"
-#endif
 #include "servo.h"
 #include "config.h"
 #include "cbus.h"
 #include "analogue.h"
 
 extern void setType(unsigned char i, unsigned char type);
+extern void setTaskRates(void);
 #ifdef __XC8
 const ModuleNvDefs moduleNvDefs @AT_NV; // = {    //  Allow 128 bytes for NVs. Declared const so it gets put into Flash
 #else
@@ -83,6 +82,23 @@ void mioNvInit(void) {
 BOOL validateNV(unsigned char index, unsigned char oldValue, unsigned char value) {
     // TODO more validations
     unsigned char io;
+    // the rate NVs accept 0 for the default
+    switch (index) {
+        case NV_INPUT_SCAN_PERIOD:
+            return (value <= MAX_INPUT_SCAN_PERIOD);
+        case NV_SERVO_SLOT_PERIOD:
+            return (value == 0) || ((value >= MIN_SERVO_SLOT_PERIOD) && (value <= MAX_SERVO_SLOT_PERIOD));
+        case NV_ACTION_POLL_PERIOD:
+            return (value <= MAX_ACTION_POLL_PERIOD);
+        case NV_ANALOGUE_POLL_PERIOD:
+            return (value <= MAX_ANALOGUE_POLL_PERIOD);
+        case NV_LED_POLL_PERIOD:
+            return (value <= MAX_LED_POLL_PERIOD);
+        case NV_1TRACK_POLL_PERIOD:
+            return (value <= MAX_1TRACK_POLL_PERIOD);
+        case NV_OVERLOAD_LIMIT:
+            return (value == 0) || ((value >= MIN_OVERLOAD_LIMIT) && (value <= MAX_OVERLOAD_LIMIT));
+    }
     if ((index >= NV_IO_START) && IS_NV_TYPE(index)) {
         switch (value) {
 #ifdef ANALOGUE
@@ -118,11 +134,16 @@ void actUponNVchange(unsigned char index, unsigned char oldValue, unsigned char
     // If the IO type is changed then we need to do a bit or work
     unsigned char io;
     unsigned char nv;
+    if ((index >= NV_INPUT_SCAN_PERIOD) && (index <= NV_1TRACK_POLL_PERIOD)) {
+        setTaskRates();
+        return;
+    }
     if (IS_NV_TYPE(index)) {
         io = index-NV_IO_START;
         io /= NVS_PER_IO;
         if (oldValue != value) {
             setType(io, value);
+            FLUSH_NV();
         }
     }
     
@@ -186,90 +207,97 @@ void actUponNVchange(unsigned char index, unsigned char oldValue, unsigned char
 
 
 /**
- * Set NVs back to factory defaults.
+ * Set NVs back to factory defaults. Flush of the NVs must be done external to this function.
  */
 void factoryResetGlobalNv(void) {
-    writeFlashByte((BYTE*)(AT_NV + NV_SOD_DELAY), (BYTE)0);
-    writeFlashByte((BYTE*)(AT_NV + NV_HB_DELAY), (BYTE)0);
-    writeFlashByte((BYTE*)(AT_NV + NV_SERVO_SPEED), (BYTE)PIVOT);
-    writeFlashByte((BYTE*)(AT_NV + NV_PULLUPS), (BYTE)0x33);
-#ifdef NV_CACHE
-    loadNvCache();
-#endif
+    WRITE_NV(NV_SOD_DELAY, 0);
+    WRITE_NV(NV_HB_DELAY, 0);
+    WRITE_NV(NV_SERVO_SPEED, PIVOT);
+    WRITE_NV(NV_PULLUPS, 0x33);
+    // 0 selects the default rate
+    WRITE_NV(NV_INPUT_SCAN_PERIOD, 0);
+    WRITE_NV(NV_SERVO_SLOT_PERIOD, 0);
+    WRITE_NV(NV_ACTION_POLL_PERIOD, 0);
+    WRITE_NV(NV_ANALOGUE_POLL_PERIOD, 0);
+    WRITE_NV(NV_LED_POLL_PERIOD, 0);
+    WRITE_NV(NV_1TRACK_POLL_PERIOD, 0);
+    WRITE_NV(NV_OVERLOAD_LIMIT, 0);
+    // no produced event rate limit
+    WRITE_NV(NV_EVENT_RATE, 0);
+    WRITE_NV(NV_EVENT_BURST, 0);
 }
 
 /**
- * Reset NV for the IO back to default. Flush of the Flash image must be done external to this function.
+ * Reset NV for the IO back to default. Flush of the NVs must be done external to this function.
  * @param i
  */
 void defaultNVs(unsigned char i, unsigned char type) {
     // add the module's default nv for this io
-    writeFlashByte((BYTE*)(AT_NV+NV_IO_FLAGS(i)), (BYTE)(FLAG_CUTOFF | FLAG_STARTUP));
+    WRITE_NV(NV_IO_FLAGS(i), (FLAG_CUTOFF | FLAG_STARTUP));
     switch(type) {
         case TYPE_INPUT:
-            writeFlashByte((BYTE*)(AT_NV+NV_IO_INPUT_ON_DELAY(i)), (BYTE)4);
-            writeFlashByte((BYTE*)(AT_NV+NV_IO_INPUT_OFF_DELAY(i)), (BYTE)4);
+            WRITE_NV(NV_IO_INPUT_ON_DELAY(i), 4);
+            WRITE_NV(NV_IO_INPUT_OFF_DELAY(i), 4);
+            WRITE_NV(NV_IO_INPUT_EVENT_RATE(i), 0);
+            WRITE_NV(NV_IO_INPUT_EVENT_BURST(i), 0);
             break;
         case TYPE_OUTPUT:
-            writeFlashByte((BYTE*)(AT_NV+NV_IO_OUTPUT_PULSE_DURATION(i)), (BYTE)0);
-            writeFlashByte((BYTE*)(AT_NV+NV_IO_OUTPUT_FLASH_PERIOD(i)), (BYTE)0);
+            WRITE_NV(NV_IO_OUTPUT_PULSE_DURATION(i), 0);
+            WRITE_NV(NV_IO_OUTPUT_FLASH_PERIOD(i), 0);
             break;
 #ifdef SERVO
         case TYPE_SERVO:
 #ifdef TEST_DEFAULT_NVS
-            writeFlashByte((BYTE*)(AT_NV+NV_IO_SERVO_START_POS(i)), (BYTE)25);
-            writeFlashByte((BYTE*)(AT_NV+NV_IO_SERVO_END_POS(i)), (BYTE)200);
+            WRITE_NV(NV_IO_SERVO_START_POS(i), 25);
+            WRITE_NV(NV_IO_SERVO_END_POS(i), 200);
 #else
-            writeFlashByte((BYTE*)(AT_NV+NV_IO_SERVO_START_POS(i)), (BYTE)128);
-            writeFlashByte((BYTE*)(AT_NV+NV_IO_SERVO_END_POS(i)), (BYTE)128);
+            WRITE_NV(NV_IO_SERVO_START_POS(i), 128);
+            WRITE_NV(NV_IO_SERVO_END_POS(i), 128);
 #endif
-            writeFlashByte((BYTE*)(AT_NV+NV_IO_SERVO_SE_SPEED(i)), (BYTE)PIVOT+1);
-            writeFlashByte((BYTE*)(AT_NV+NV_IO_SERVO_ES_SPEED(i)), (BYTE)PIVOT+1);
+            WRITE_NV(NV_IO_SERVO_SE_SPEED(i), PIVOT+1);
+            WRITE_NV(NV_IO_SERVO_ES_SPEED(i), PIVOT+1);
             break;
 #endif
 #ifdef BOUNCE
         case TYPE_BOUNCE:
 #ifdef TEST_DEFAULT_NVS
-            writeFlashByte((BYTE*)(AT_NV+NV_IO_BOUNCE_UPPER_POS(i)), (BYTE)200);
-            writeFlashByte((BYTE*)(AT_NV+NV_IO_BOUNCE_LOWER_POS(i)), (BYTE)30);
+            WRITE_NV(NV_IO_BOUNCE_UPPER_POS(i), 200);
+            WRITE_NV(NV_IO_BOUNCE_LOWER_POS(i), 30);
 #else
-            writeFlashByte((BYTE*)(AT_NV+NV_IO_BOUNCE_UPPER_POS(i)), (BYTE)128);
-            writeFlashByte((BYTE*)(AT_NV+NV_IO_BOUNCE_LOWER_POS(i)), (BYTE)127);
+            WRITE_NV(NV_IO_BOUNCE_UPPER_POS(i), 128);
+            WRITE_NV(NV_IO_BOUNCE_LOWER_POS(i), 127);
 #endif
-            writeFlashByte((BYTE*)(AT_NV+NV_IO_BOUNCE_COEFF(i)), (BYTE)64);
-            writeFlashByte((BYTE*)(AT_NV + NV_IO_BOUNCE_PULL_SPEED(i)), (BYTE)3);
-            writeFlashByte((BYTE*)(AT_NV + NV_IO_BOUNCE_PULL_PAUSE(i)), (BYTE)60);
+            WRITE_NV(NV_IO_BOUNCE_COEFF(i), 64);
+            WRITE_NV(NV_IO_BOUNCE_PULL_SPEED(i), 3);
+            WRITE_NV(NV_IO_BOUNCE_PULL_PAUSE(i), 60);
             break;
 #endif
 #ifdef MULTI      
         case TYPE_MULTI:
-            writeFlashByte((BYTE*)(AT_NV+NV_IO_MULTI_NUM_POS(i)), (BYTE)3);
+            WRITE_NV(NV_IO_MULTI_NUM_POS(i), 3);
 #ifdef TEST_DEFAULT_NVS
-            writeFlashByte((BYTE*)(AT_NV+NV_IO_MULTI_POS1(i)), (BYTE)25);
-            writeFlashByte((BYTE*)(AT_NV+NV_IO_MULTI_POS2(i)), (BYTE)110);
-            writeFlashByte((BYTE*)(AT_NV+NV_IO_MULTI_POS3(i)), (BYTE)200);
+            WRITE_NV(NV_IO_MULTI_POS1(i), 25);
+            WRITE_NV(NV_IO_MULTI_POS2(i), 110);
+            WRITE_NV(NV_IO_MULTI_POS3(i), 200);
 #else
-            writeFlashByte((BYTE*)(AT_NV+NV_IO_MULTI_POS1(i)), (BYTE)128);
-            writeFlashByte((BYTE*)(AT_NV+NV_IO_MULTI_POS2(i)), (BYTE)128);
-            writeFlashByte((BYTE*)(AT_NV+NV_IO_MULTI_POS3(i)), (BYTE)128);
+            WRITE_NV(NV_IO_MULTI_POS1(i), 128);
+            WRITE_NV(NV_IO_MULTI_POS2(i), 128);
+            WRITE_NV(NV_IO_MULTI_POS3(i), 128);
 #endif
             break;
 #endif
 #ifdef ANALOGUE
         case TYPE_ANALOGUE_IN:  // use 8 bit ADC
-            writeFlashByte((BYTE*)(AT_NV+NV_IO_ANALOGUE_THRES(i)), (BYTE)0x80);
-            writeFlashByte((BYTE*)(AT_NV+NV_IO_ANALOGUE_HYST(i)), (BYTE)0x10);
+            WRITE_NV(NV_IO_ANALOGUE_THRES(i), 0x80);
+            WRITE_NV(NV_IO_ANALOGUE_HYST(i), 0x10);
             break;
         case TYPE_MAGNET:   // use 12 bit ADC
-            writeFlashByte((BYTE*)(AT_NV+NV_IO_MAGNET_SETUP(i)), (BYTE)0);
-            writeFlashByte((BYTE*)(AT_NV+NV_IO_MAGNET_THRES(i)), (BYTE)123);    // 150mV
-            writeFlashByte((BYTE*)(AT_NV+NV_IO_MAGNET_HYST(i)), (BYTE)32);      // 39mV
-            writeFlashByte((BYTE*)(AT_NV+NV_IO_MAGNET_OFFSETH(i)), (BYTE)0x07);
-            writeFlashByte((BYTE*)(AT_NV+NV_IO_MAGNET_OFFSETL(i)), (BYTE)0xFF);
+            WRITE_NV(NV_IO_MAGNET_SETUP(i), 0);
+            WRITE_NV(NV_IO_MAGNET_THRES(i), 123);    // 150mV
+            WRITE_NV(NV_IO_MAGNET_HYST(i), 32);      // 39mV
+            WRITE_NV(NV_IO_MAGNET_OFFSETH(i), 0x07);
+            WRITE_NV(NV_IO_MAGNET_OFFSETL(i), 0xFF);
             break;
 #endif
     }
-#ifdef NV_CACHE
-    loadNvCache();
-#endif
 }
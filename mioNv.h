@@ -60,18 +60,40 @@ extern "C" {
 #define NV_SERVO_SPEED                  3   // Used for Multi and Bounce types where there isn't an NV to define speed.
 #define NV_PULLUPS                      4
 #define NV_BOUNCE_RANDOM                5
-#define NV_SPARE3                       6
-#define NV_SPARE4                       7
-#define NV_SPARE5                       8
-#define NV_SPARE6                       9
-#define NV_SPARE7                       10
-#define NV_SPARE8                       11
-#define NV_SPARE9                       12
-#define NV_SPARE10                      13
-#define NV_SPARE11                      14
-#define NV_SPARE12                      15
+#define NV_INPUT_SCAN_PERIOD            6   // ms between input scans
+#define NV_SERVO_SLOT_PERIOD            7   // units of 0.5ms, a servo is refreshed every 8 slots
+#define NV_ACTION_POLL_PERIOD           8   // units of 10ms
+#define NV_ANALOGUE_POLL_PERIOD         9   // units of 0.5ms, one analogue input is read each poll
+#define NV_LED_POLL_PERIOD              10  // ms between status LED updates
+#define NV_1TRACK_POLL_PERIOD           11  // ms between runs of the 1Track logic
+#define NV_OVERLOAD_LIMIT               12  // main loop utilisation % above which low priority polls are slowed
+#define NV_EVENT_RATE                   13  // produced events per second allowed for each input/analogue IO, 0 for no limit
+#define NV_EVENT_BURST                  14  // number of events which can be sent in a burst, 0 for default
+#define NV_1TRACK_MODE                  15
 #define NV_IO_START                     16
 #define NVS_PER_IO                      7
+
+/*
+ * Defaults and maximums for the rate NVs. A value of 0 selects the default.
+ * The servo slot must be long enough for the longest pulse (2.1ms).
+ */
+#define DEFAULT_INPUT_SCAN_PERIOD       5
+#define MAX_INPUT_SCAN_PERIOD           50
+#define DEFAULT_SERVO_SLOT_PERIOD       5
+#define MIN_SERVO_SLOT_PERIOD           5
+#define MAX_SERVO_SLOT_PERIOD           10
+#define DEFAULT_ACTION_POLL_PERIOD      10
+#define MAX_ACTION_POLL_PERIOD          50
+#define DEFAULT_ANALOGUE_POLL_PERIOD    1
+#define MAX_ANALOGUE_POLL_PERIOD        200
+#define DEFAULT_LED_POLL_PERIOD         10
+#define MAX_LED_POLL_PERIOD             100
+#define DEFAULT_1TRACK_POLL_PERIOD      1
+#define MAX_1TRACK_POLL_PERIOD          100
+#define DEFAULT_OVERLOAD_LIMIT          80
+#define DEFAULT_EVENT_BURST             4
+#define MIN_OVERLOAD_LIMIT              10
+#define MAX_OVERLOAD_LIMIT              100
     
 // NVs per IO
 #define NV_IO_TYPE_OFFSET               0
@@ -84,6 +106,10 @@ extern "C" {
 #define NV_IO_INPUT_OFF_DELAY_OFFSET    3
 #define NV_IO_INPUT_ON_DELAY(i)         (NV_IO_START + NVS_PER_IO*(i) + NV_IO_INPUT_ON_DELAY_OFFSET)	// units of 5ms
 #define NV_IO_INPUT_OFF_DELAY(i)        (NV_IO_START + NVS_PER_IO*(i) + NV_IO_INPUT_OFF_DELAY_OFFSET)	// units of 5ms
+#define NV_IO_INPUT_EVENT_RATE_OFFSET   4
+#define NV_IO_INPUT_EVENT_BURST_OFFSET  5
+#define NV_IO_INPUT_EVENT_RATE(i)       (NV_IO_START + NVS_PER_IO*(i) + NV_IO_INPUT_EVENT_RATE_OFFSET)	// events per second, 0 to use NV_EVENT_RATE
+#define NV_IO_INPUT_EVENT_BURST(i)      (NV_IO_START + NVS_PER_IO*(i) + NV_IO_INPUT_EVENT_BURST_OFFSET)	// 0 to use NV_EVENT_BURST
 
 #define NV_IO_OUTPUT_PULSE_DURATION_OFFSET 2
 #define NV_IO_OUTPUT_FLASH_PERIOD_OFFSET 3
@@ -167,6 +193,8 @@ typedef struct {
         struct {
             unsigned char input_on_delay;
             unsigned char input_off_delay;
+            unsigned char input_event_rate;
+            unsigned char input_event_burst;
         } nv_input;
         struct {
             unsigned char output_pulse_duration;
@@ -216,11 +244,29 @@ typedef struct {
         BYTE hbDelay;                    // Interval in 100mS for automatic heartbeat. Set to zero for no heartbeat.
         BYTE servo_speed;               // default servo speed
         BYTE pullups;                   // weak pullup resistors
-        BYTE spare[11];
+        BYTE bounce_random;             // not yet used
+        BYTE input_scan_period;         // ms between input scans, 0 for default
+        BYTE servo_slot_period;         // servo slot in 0.5ms, 0 for default
+        BYTE action_poll_period;        // action and output poll in 10ms, 0 for default
+        BYTE analogue_poll_period;      // analogue poll in 0.5ms, 0 for default
+        BYTE led_poll_period;           // status LED poll in ms, 0 for default
+        BYTE track_poll_period;         // 1Track poll in ms, 0 for default
+        BYTE overload_limit;            // loop utilisation % at which low priority polls slow down, 0 for default
+        BYTE event_rate;                // produced events per second per IO, 0 for no limit
+        BYTE event_burst;               // produced event burst per IO, 0 for default
+        BYTE track_mode;                // 1Track mode, STDMODE to THREEMODE or anything else for a standard CANMIO
         NvIo io[NUM_IO];                 // config for each IO
 } ModuleNvDefs;
 
 #define NV_NUM  sizeof(ModuleNvDefs)     // Number of node variables
+
+/*
+ * NV_COMMAND, one past the last NV, is not stored. An NVSET of it in learn 
+ * mode asks the module to do something. Other values are rejected by CBUSlib
+ * as an invalid NV.
+ */
+#define NV_COMMAND                      NV_NUM
+#define NV_COMMAND_COMPACT_EVENTS       1   // compact the event table, see eventCompact.c
 #ifdef __18F25K80
 #define AT_NV   0x7F80                  // Where the NVs are stored. (_ROMSIZE - 128)  Size=128 bytes
 #endif
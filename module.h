@@ -51,8 +51,15 @@ extern "C" {
 // BOOTLOADER
 #define BOOTLOADER_PRESENT
 
+// Whether received events are looked up using the module's perfect hash index
+// which uses less RAM than the CBUSlib hash tables and, once built, takes one
+// compare
+#define EVENT_INDEX
+
+#ifndef EVENT_INDEX
 // We'll be using event hash tables for fast access - at the expense of some RAM
 #define HASH_TABLE
+#endif
 
 // Whether to enable servos
 #define SERVO
@@ -73,12 +80,84 @@ extern "C" {
 
 // Whether NVs are cached in RAM
 #define NV_CACHE
+
+// Whether to collect execution time statistics for the main loop jobs which
+// can be read using RDGN. Adds a little overhead so leave off for production builds.
+//#define PROFILE
+
+// Whether to measure the time from receiving an event to an output acting
+// upon it. Can be read using RDGN.
+//#define LATENCY
+
+// Whether output states are saved to an EEPROM journal rather than rewriting
+// the same EEPROM byte on every change
+#define STATE_JOURNAL
+
+// Whether to enable the hardware watchdog once the module has started. It is
+// only cleared whilst the servo and input scan tasks keep running and the
+// module is reset if they stop even though the main loop is still idling.
+#define WATCHDOG
     
 #define ACTION_NORMAL_QUEUE_SIZE 	64	// The size needs to be big enough to store all the pending actions 
                                 // Need to allow +1 to separate the ends of the cyclic buffer so need to 
                                 // move the next power of two since cyclic wrapping is done with a bitmask.
                                 // 64 is safer as we have wait actions
 #define ACTION_EXPEDITED_QUEUE_SIZE 8
+
+// Produced events waiting for a CAN transmit buffer. Sizes must be a power of two.
+#define TX_INPUT_QUEUE_SIZE     16
+#define TX_OUTPUT_QUEUE_SIZE    32
+#define TX_SOD_QUEUE_SIZE       8
+
+// Whether to keep a trace of the last CAN frames which can be dumped using RDGN.
+// TRACE_SIZE frames of 11 bytes each, at most 39.
+#define TRACE
+#ifdef __18F26K80
+#define TRACE_SIZE      32
+#else
+#define TRACE_SIZE      8
+#endif
+
+// The most CAN frames handled by one call to checkCBUS before the rest of the loop gets a turn
+#define CAN_RX_BUDGET   8
+
+// Whether the ECAN acceptance filters are set up from the learned events so
+// accessory events from other nodes are rejected by the hardware
+#define CAN_FILTER
+
+// Whether the EVLRNs for one event are collected and written to flash together
+#define LEARN_SESSION
+
+// Whether the event table can be compacted in learn mode with an NVSET of NV_COMMAND
+#define EVENT_COMPACTION
+
+// Whether received accessory events are checked against a Bloom filter of the
+// learned events before being looked up. Can be read using RDGN.
+#define EVENT_FILTER
+
+// Whether the EVs of recently consumed events are kept in RAM, and how many
+#define EV_CACHE
+#define EV_CACHE_SIZE   4
+
+// Whether produced events are found using an index by producer action rather
+// than searching the event table
+#define PRODUCER_INDEX
+
+#ifdef __18F26K80
+// Whether each event's EVs are compiled into the actions to queue when it is
+// learned and kept in flash below the event table
+#define ACTION_PROGRAMS
+#endif
+
+// Whether ACON/ACOF/ASON/ASOF are looked up directly by the module rather than going through parseCBUSMsg.
+// tests/bench_accessory.c compares the two paths.
+#define FAST_ACCESSORY_PATH
+
+#ifdef FAST_ACCESSORY_PATH
+// Whether a learned event can cover a range of event numbers operating
+// consecutive IOs. Only the fast accessory path knows about the ranges.
+#define RANGE_EVENTS
+#endif
     
 // Whether we have default settings useful for testing
 #define TEST_DEFAULT_EVENTS
@@ -114,7 +193,11 @@ extern "C" {
 /*
  * FLASH bounds
  */
+#ifdef ACTION_PROGRAMS
+#define MIN_WRITEABLE_FLASH     (AT_PROGRAMS&0xFFC0)
+#else
 #define MIN_WRITEABLE_FLASH     (AT_EVENTS&0xFFC0)
+#endif
 #ifdef __18F25K80
 #define MAX_WRITEABLE_FLASH     0x7FFF
 #endif
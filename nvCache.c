@@ -36,17 +36,73 @@
 #ifdef NV_CACHE
 #include "mioNv.h"
 #include "romops.h"
+#include "nvCache.h"
 static volatile ModuleNvDefs nvCache;        // RAM storage for NVs
+static BOOL nvDirty;                        // RAM has changes not yet written to flash
+static BYTE nvPatch = NV_CACHE_ALL;         // the only NV the next load needs to read
 
 extern const rom near BYTE * NvBytePtr;
 
+/**
+ * Load the cache from flash. Any changes not yet written are written first
+ * so they aren't lost. If nvCacheUpdate() has said which NV has been 
+ * changed only that one is read, otherwise they all are.
+ * @return the cache
+ */
 ModuleNvDefs* loadNvCache(void) {
     BYTE * np = (BYTE*)(&nvCache);
     unsigned char i;
+    if (nvDirty) {
+        flushNvCache();
+    }
+    if (nvPatch < sizeof(ModuleNvDefs)) {
+        *(np+nvPatch) = readFlashBlock((WORD)(NvBytePtr+nvPatch));
+        nvPatch = NV_CACHE_ALL;
+        return &nvCache;
+    }
+    nvPatch = NV_CACHE_ALL;
     // do whole blocks
     for (i=0; i<sizeof(ModuleNvDefs); i++) {
         *(np+i) = readFlashBlock((WORD)(NvBytePtr+i));
     }
     return &nvCache;
 }
+
+/**
+ * Say which NV CBUSlib is about to write to flash so the reload which 
+ * follows only needs to read that NV.
+ * @param index the NV index or NV_CACHE_ALL for a full reload
+ */
+void nvCacheUpdate(BYTE index) {
+    nvPatch = index;
+}
+
+/**
+ * Change an NV in the cache. It is written to flash by flushNvCache().
+ * @param index the NV index
+ * @param value the new value
+ */
+void writeNvCache(BYTE index, BYTE value) {
+    BYTE * np = (BYTE*)(&nvCache);
+    if (index >= sizeof(ModuleNvDefs)) return;
+    np[index] = value;
+    nvDirty = TRUE;
+}
+
+/**
+ * Write the changed NVs to flash. Only bytes which differ are written so 
+ * each flash block of the NVs is erased at most once.
+ */
+void flushNvCache(void) {
+    BYTE * np = (BYTE*)(&nvCache);
+    unsigned char i;
+    if ( ! nvDirty) return;
+    nvDirty = FALSE;
+    for (i=0; i<sizeof(ModuleNvDefs); i++) {
+        if (readFlashBlock((WORD)(NvBytePtr+i)) != np[i]) {
+            writeFlashByte((BYTE*)(AT_NV+i), np[i]);
+        }
+    }
+    flushFlashImage();
+}
 #endif
@@ -15,7 +15,24 @@ extern "C" {
 #include "module.h"
 #include "mioNv.h"
 
+/*
+ * With the cache the RAM copy of the NVs is the master. Changes are made in
+ * RAM and written to flash together by FLUSH_NV().
+ */
+#define NV_CACHE_ALL    0xFF    // reload every NV
+
+#ifdef NV_CACHE
+#define WRITE_NV(index, value)  writeNvCache(index, value)
+#define FLUSH_NV()              flushNvCache()
+#else
+#define WRITE_NV(index, value)  writeFlashByte((BYTE*)(AT_NV+(index)), (BYTE)(value))
+#define FLUSH_NV()              flushFlashImage()
+#endif
+
 extern ModuleNvDefs * loadNvCache(void);
+extern void nvCacheUpdate(BYTE index);
+extern void writeNvCache(BYTE index, BYTE value);
+extern void flushNvCache(void);
 
 #ifdef	__cplusplus
 }
@@ -49,6 +49,7 @@
 #include "servo.h"
 #include "actionQueue.h"
 #include "digitalOut.h"
+#include "latency.h"
 
 // Forward declarations
 
@@ -73,20 +74,24 @@ void startOutput(unsigned char io, CONSUMER_ACTION_T action, unsigned char type)
             return;
         case TYPE_OUTPUT:
             startDigitalOutput(io, action);
+            LATENCY_ACTUATED(io);
             return;
 #ifdef BOUNCE
         case TYPE_BOUNCE:
             startBounceOutput(io, action);
+            LATENCY_STARTED(io);
             return;
 #endif
 #ifdef SERVO
         case TYPE_SERVO:
             startServoOutput(io, action);
+            LATENCY_STARTED(io);
             return;
 #endif
 #ifdef MULTI
         case TYPE_MULTI:
             startMultiOutput(io, action);
+            LATENCY_STARTED(io);
             return;
 #endif
     }
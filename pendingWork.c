@@ -0,0 +1,188 @@
+/*
+ Routines for CBUS FLiM operations - part of CBUS libraries for PIC 18F
+  This work is licensed under the:
+      Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International License.
+   To view a copy of this license, visit:
+      http://creativecommons.org/licenses/by-nc-sa/4.0/
+   or send a letter to Creative Commons, PO Box 1866, Mountain View, CA 94042, USA.
+   License summary:
+    You are free to:
+      Share, copy and redistribute the material in any medium or format
+      Adapt, remix, transform, and build upon the material
+    The licensor cannot revoke these freedoms as long as you follow the license terms.
+    Attribution : You must give appropriate credit, provide a link to the license,
+                   and indicate if changes were made. You may do so in any reasonable manner,
+                   but not in any way that suggests the licensor endorses you or your use.
+    NonCommercial : You may not use the material for commercial purposes. **(see note below)
+    ShareAlike : If you remix, transform, or build upon the material, you must distribute
+                  your contributions under the same license as the original.
+    No additional restrictions : You may not apply legal terms or technological measures that
+                                  legally restrict others from doing anything the license permits.
+   ** For commercial use, please contact the original copyright holder(s) to agree licensing terms
+**************************************************************************************************************
+	The FLiM routines have no code or definitions that are specific to any
+	module, so they can be used to provide FLiM facilities for any module 
+	using these libraries.
+	
+*/ 
+/*
+ * File:   pendingWork.c
+ *
+ * Created on 18 October 2026, 16:05
+ *
+ * The work flags set by the ISRs, the idle handling of the main loop and the 
+ * loop utilisation statistics.
+ * 
+ * Timer2 is used as a 0.5ms wake up timer so the time based jobs still get 
+ * run when there is no other interrupt activity. Timer2 isn't used by 
+ * anything else.
+ * 
+ * The loop utilisation is the proportion of time the main loop spent doing 
+ * work rather than idling. It is calculated once a second and can be read 
+ * using RDGN with the DIAG_LOOP service.
+ * 
+ * If the utilisation reaches the overload limit the stretch factor is doubled,
+ * up to MAX_STRETCH. The low priority polls are slowed by this factor so the
+ * servo pulses and CAN handling keep their time. Once the utilisation falls 
+ * below half the limit the stretch factor is halved again.
+ */
+
+#include "devincs.h"
+#include "module.h"
+#include "TickTime.h"
+#include "pendingWork.h"
+
+volatile BYTE pendingWork;
+
+static TickValue windowStart;   // start of the current utilisation window
+static DWORD busyTicks;         // ticks busy in the current window
+static WORD wakeups;            // wakeups in the current window
+static BYTE utilisation;        // utilisation of the last complete window
+static BYTE peakUtilisation;
+static WORD lastWakeups;
+static BYTE stretch;            // factor to slow the low priority polls
+
+/**
+ * Set up the wake timer and clear the statistics.
+ * Interrupts are enabled later by initialise().
+ */
+void initPendingWork(void) {
+    pendingWork = 0;
+    busyTicks = 0;
+    wakeups = 0;
+    utilisation = 0;
+    peakUtilisation = 0;
+    lastWakeups = 0;
+    stretch = 1;
+    windowStart.Val = tickGet();
+    
+    // Timer2 from Fosc/4 = 16MHz, 1:16 prescale, PR2=249 gives 250us, 1:2 postscale gives 500us
+    T2CONbits.T2CKPS = 2;       // 1:16 prescaler
+    T2CONbits.T2OUTPS = 1;      // 1:2 postscaler
+    PR2 = 249;
+    TMR2 = 0;
+    IPR1bits.TMR2IP = 0;        // low priority
+    PIR1bits.TMR2IF = 0;
+    PIE1bits.TMR2IE = 1;        // enable interrupt
+    T2CONbits.TMR2ON = 1;       // enable Timer2
+}
+
+/**
+ * Get the pending work flags and clear them. Interrupts are disabled whilst
+ * doing so, so a flag set by an ISR cannot be lost.
+ * @return the PENDING_xxx flags
+ */
+BYTE takePendingWork(void) {
+    BYTE work;
+    
+    INTCONbits.GIEH = 0;
+    work = pendingWork;
+    pendingWork = 0;
+    INTCONbits.GIEH = 1;
+    return work;
+}
+
+/**
+ * Put the processor into IDLE mode until an interrupt occurs. The peripherals
+ * keep running in IDLE mode, only the CPU is stopped.
+ * 
+ * Interrupts are disabled before checking pendingWork so there is no window
+ * for an ISR to flag work between the check and the SLEEP. An enabled 
+ * interrupt still wakes the processor with the global enable clear, the ISR
+ * then runs as soon as interrupts are re-enabled.
+ */
+void idleUntilWork(void) {
+    INTCONbits.GIEH = 0;
+    if (pendingWork == 0) {
+        OSCCONbits.IDLEN = 1;   // SLEEP instruction enters IDLE mode
+        Sleep();
+    }
+    INTCONbits.GIEH = 1;
+}
+
+/**
+ * Record a pass of the main loop which did some work and update the 
+ * utilisation and the overload stretch factor when the window is complete.
+ * @param ticks the number of ticks spent working
+ * @param overloadLimit the utilisation percentage considered to be overload
+ * @return TRUE if the stretch factor has changed
+ */
+BOOL loopBusy(WORD ticks, BYTE overloadLimit) {
+    DWORD elapsed;
+    BOOL changed = FALSE;
+    
+    busyTicks += ticks;
+    wakeups++;
+    elapsed = tickTimeSince(windowStart);
+    if (elapsed >= ONE_SECOND) {
+        utilisation = (BYTE)((busyTicks * 100) / elapsed);
+        if (utilisation > peakUtilisation) {
+            peakUtilisation = utilisation;
+        }
+        lastWakeups = wakeups;
+        busyTicks = 0;
+        wakeups = 0;
+        windowStart.Val = tickGet();
+        
+        if ((utilisation >= overloadLimit) && (stretch < MAX_STRETCH)) {
+            stretch <<= 1;
+            changed = TRUE;
+        } else if ((utilisation < overloadLimit/2) && (stretch > 1)) {
+            stretch >>= 1;
+            changed = TRUE;
+        }
+    }
+    return changed;
+}
+
+/**
+ * Get the factor by which the low priority polls should be slowed.
+ * @return the stretch factor, 1 when not overloaded
+ */
+BYTE getLoopStretch(void) {
+    return stretch;
+}
+
+/**
+ * Get a DIAG_LOOP diagnostic.
+ * @param code the LOOP_xxx code
+ * @param value where to put the value
+ * @return TRUE if a valid code
+ */
+BOOL getLoopDiagnostic(BYTE code, WORD * value) {
+    switch (code) {
+        case LOOP_UTILISATION:
+            *value = utilisation;
+            return TRUE;
+        case LOOP_PEAK_UTILISATION:
+            *value = peakUtilisation;
+            return TRUE;
+        case LOOP_WAKEUPS:
+            *value = lastWakeups;
+            return TRUE;
+        case LOOP_STRETCH:
+            *value = stretch;
+            return TRUE;
+    }
+    return FALSE;
+}
@@ -0,0 +1,89 @@
+/*
+ Routines for CBUS FLiM operations - part of CBUS libraries for PIC 18F
+  This work is licensed under the:
+      Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International License.
+   To view a copy of this license, visit:
+      http://creativecommons.org/licenses/by-nc-sa/4.0/
+   or send a letter to Creative Commons, PO Box 1866, Mountain View, CA 94042, USA.
+   License summary:
+    You are free to:
+      Share, copy and redistribute the material in any medium or format
+      Adapt, remix, transform, and build upon the material
+    The licensor cannot revoke these freedoms as long as you follow the license terms.
+    Attribution : You must give appropriate credit, provide a link to the license,
+                   and indicate if changes were made. You may do so in any reasonable manner,
+                   but not in any way that suggests the licensor endorses you or your use.
+    NonCommercial : You may not use the material for commercial purposes. **(see note below)
+    ShareAlike : If you remix, transform, or build upon the material, you must distribute
+                  your contributions under the same license as the original.
+    No additional restrictions : You may not apply legal terms or technological measures that
+                                  legally restrict others from doing anything the license permits.
+   ** For commercial use, please contact the original copyright holder(s) to agree licensing terms
+**************************************************************************************************************
+	The FLiM routines have no code or definitions that are specific to any
+	module, so they can be used to provide FLiM facilities for any module 
+	using these libraries.
+	
+*/ 
+/* 
+ * File:   pendingWork.h
+ *
+ * Created on 18 October 2026, 16:05
+ *
+ * The interrupt service routines flag the work they have made ready in
+ * pendingWork and the main loop only runs the subsystems which have been
+ * flagged. When there is nothing to do the processor idles until the next
+ * interrupt.
+ */
+
+#ifndef PENDINGWORK_H
+#define	PENDINGWORK_H
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+#include "GenericTypeDefs.h"
+
+/*
+ * The pendingWork bits.
+ */
+#define PENDING_CAN     0x01    // CAN frame received or transmit buffer freed
+#define PENDING_TICK    0x02    // the 0.5ms wake timer has expired
+#define PENDING_ADC     0x04    // an analogue conversion has completed
+#define PENDING_SERVO   0x08    // a servo pulse has finished
+
+/*
+ * Codes for the DIAG_LOOP diagnostic service
+ */
+#define LOOP_UTILISATION        1   // percentage of the last second the main loop was busy
+#define LOOP_PEAK_UTILISATION   2   // highest LOOP_UTILISATION seen
+#define LOOP_WAKEUPS            3   // number of times the loop woke in the last second
+#define LOOP_STRETCH            4   // factor the low priority polls are currently slowed by
+
+#define MAX_STRETCH             8
+
+extern volatile BYTE pendingWork;
+
+extern void initPendingWork(void);
+extern BYTE takePendingWork(void);
+extern void idleUntilWork(void);
+extern BOOL loopBusy(WORD ticks, BYTE overloadLimit);
+extern BYTE getLoopStretch(void);
+extern BOOL getLoopDiagnostic(BYTE code, WORD * value);
+
+/*
+ * Handle the wake timer interrupt. Call from the low priority ISR.
+ */
+#define wakeTimerInterruptHandler() {   \
+    if (PIR1bits.TMR2IF) {              \
+        PIR1bits.TMR2IF = 0;            \
+        pendingWork |= PENDING_TICK;    \
+    }                                   \
+}
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif	/* PENDINGWORK_H */
@@ -0,0 +1,217 @@
+/*
+ Routines for CBUS FLiM operations - part of CBUS libraries for PIC 18F
+  This work is licensed under the:
+      Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International License.
+   To view a copy of this license, visit:
+      http://creativecommons.org/licenses/by-nc-sa/4.0/
+   or send a letter to Creative Commons, PO Box 1866, Mountain View, CA 94042, USA.
+   License summary:
+    You are free to:
+      Share, copy and redistribute the material in any medium or format
+      Adapt, remix, transform, and build upon the material
+    The licensor cannot revoke these freedoms as long as you follow the license terms.
+    Attribution : You must give appropriate credit, provide a link to the license,
+                   and indicate if changes were made. You may do so in any reasonable manner,
+                   but not in any way that suggests the licensor endorses you or your use.
+    NonCommercial : You may not use the material for commercial purposes. **(see note below)
+    ShareAlike : If you remix, transform, or build upon the material, you must distribute
+                  your contributions under the same license as the original.
+    No additional restrictions : You may not apply legal terms or technological measures that
+                                  legally restrict others from doing anything the license permits.
+   ** For commercial use, please contact the original copyright holder(s) to agree licensing terms
+**************************************************************************************************************
+	The FLiM routines have no code or definitions that are specific to any
+	module, so they can be used to provide FLiM facilities for any module 
+	using these libraries.
+	
+*/ 
+/*
+ * File:   producerIndex.c
+ *
+ * Created on 20 October 2026, 14:20
+ *
+ * Without the CBUSlib hash tables sendProducedEvent() searches the whole 
+ * event table for the entry whose EV#0 is the producer action before 
+ * falling back to getDefaultProducedEvent(). That is done for every event 
+ * of a SOD and for each servo start, mid and end event.
+ * 
+ * Here a table of NUM_PRODUCER_ACTIONS bytes gives the event table index 
+ * for each producer action, so producing an event takes the same time 
+ * however full the event table is. The table is built at start up and 
+ * once learning or unlearning has finished for a second. Until then, and
+ * when PRODUCER_INDEX is not defined, the event table is searched.
+ * 
+ * CBUSlib has no entry point which sends the event of a given table entry so 
+ * the lookup of sendProducedEvent() in events.c of the C18Ian branch is 
+ * repeated here using only its public functions:
+ * - the first valid entry whose EV#0 is the action is used
+ * - otherwise getDefaultProducedEvent() of mioEvents.c gives the event
+ * - an EN of 0 means the action has no event
+ * - the event is sent with cbusSendEvent()
+ * If CBUSlib changes that lookup this must be changed to match. 
+ * tests/test_producerIndex.c holds a copy of it and checks both send the 
+ * same event for every action.
+ * 
+ * As the NN and EN are known here each event sent is recorded by the bus 
+ * load meter and the trace as the frame cbusSendEvent() puts on the bus.
+ */
+
+#include "module.h"
+#include "events.h"
+#include "cbus.h"
+#include "TickTime.h"
+#include "busLoad.h"
+#include "trace.h"
+#include "producerIndex.h"
+
+extern BOOL getDefaultProducedEvent(PRODUCER_ACTION_T paction);
+
+// forward declarations
+static BYTE searchTable(PRODUCER_ACTION_T action);
+static void recordFrame(WORD nn, WORD en, BOOL on);
+
+#ifdef PRODUCER_INDEX
+
+#define PRODUCER_SETTLE_TIME    ONE_SECOND
+
+static BYTE producerSlot[NUM_PRODUCER_ACTIONS];     // event table index, NO_INDEX if not learned
+static BOOL indexValid;
+static BOOL changed;
+static TickValue changeTime;
+
+// forward declarations
+static void buildIndex(void);
+
+/**
+ * Build the index from the event table. Called during initialisation after
+ * the event table is ready.
+ */
+void producerIndexInit(void) {
+    changed = FALSE;
+    buildIndex();
+}
+
+/**
+ * Called after the event table may have been changed by learning or 
+ * unlearning. The index is no longer used until it has been rebuilt.
+ */
+void producerIndexChanged(void) {
+    indexValid = FALSE;
+    changeTime.Val = tickGet();
+    changed = TRUE;
+}
+
+/**
+ * Rebuild the index once learning has finished. Called from the main loop.
+ */
+void pollProducerIndex(void) {
+    if (changed && (tickTimeSince(changeTime) > PRODUCER_SETTLE_TIME)) {
+        changed = FALSE;
+        buildIndex();
+    }
+}
+
+/**
+ * Find the event table entry of each producer action. If more than one 
+ * entry has the same action the first is used, as sendProducedEvent() does.
+ */
+static void buildIndex(void) {
+    BYTE tableIndex;
+    int action;
+    
+    for (action=0; action<NUM_PRODUCER_ACTIONS; action++) {
+        producerSlot[action] = NO_INDEX;
+    }
+    for (tableIndex=0; tableIndex<NUM_EVENTS; tableIndex++) {
+        if ( ! validStart(tableIndex)) continue;
+        action = getEv(tableIndex, 0);
+        if ((action > NO_ACTION) && (action < NUM_PRODUCER_ACTIONS) && (producerSlot[action] == NO_INDEX)) {
+            producerSlot[action] = tableIndex;
+        }
+    }
+    indexValid = TRUE;
+}
+
+#endif
+
+/**
+ * Send the event for a producer action. The same as sendProducedEvent() 
+ * but uses the index, if it has been built, to find the event.
+ * 
+ * @param action the producer action
+ * @param on TRUE for an ON event
+ * @return PRODUCE_SENT, PRODUCE_BUSY if the transmit buffers are full or 
+ * PRODUCE_NOTHING if the action has no event
+ */
+BYTE producerIndexSend(PRODUCER_ACTION_T action, BOOL on) {
+    BYTE tableIndex;
+    WORD nn;
+    WORD en;
+    
+#ifdef PRODUCER_INDEX
+    if (indexValid && (action < NUM_PRODUCER_ACTIONS)) {
+        tableIndex = producerSlot[action];
+    } else {
+        tableIndex = searchTable(action);
+    }
+#else
+    tableIndex = searchTable(action);
+#endif
+    if (tableIndex != NO_INDEX) {
+        nn = getNN(tableIndex);
+        en = getEN(tableIndex);
+    } else if (getDefaultProducedEvent(action)) {
+        nn = producedEvent.NN;      // where getDefaultProducedEvent() puts it
+        en = producedEvent.EN;
+    } else {
+        return PRODUCE_NOTHING;
+    }
+    if (en == 0) {
+        return PRODUCE_NOTHING;     // defaults with no event
+    }
+    if ( ! cbusSendEvent(0, nn, en, on)) {
+        return PRODUCE_BUSY;
+    }
+    recordFrame(nn, en, on);
+    return PRODUCE_SENT;
+}
+
+/**
+ * Search the event table for the first entry which produces an action.
+ * @param action the producer action
+ * @return the event table index or NO_INDEX if none
+ */
+static BYTE searchTable(PRODUCER_ACTION_T action) {
+    BYTE tableIndex;
+    
+    for (tableIndex=0; tableIndex<NUM_EVENTS; tableIndex++) {
+        if (validStart(tableIndex) && (getEv(tableIndex, 0) == action)) {
+            return tableIndex;
+        }
+    }
+    return NO_INDEX;
+}
+
+/**
+ * Record a sent event with the bus load meter and the trace. A short event,
+ * NN of 0, goes on the bus as ASON/ASOF with this module's node number.
+ * @param nn the event's node number
+ * @param en the event number
+ * @param on TRUE for an ON event
+ */
+static void recordFrame(WORD nn, WORD en, BOOL on) {
+    BYTE frame[d4+1];
+    
+    if (nn == 0) {
+        frame[d0] = on ? OPC_ASON : OPC_ASOF;
+        nn = nodeID;
+    } else {
+        frame[d0] = on ? OPC_ACON : OPC_ACOF;
+    }
+    frame[d1] = nn >> 8;
+    frame[d2] = nn & 0xFF;
+    frame[d3] = en >> 8;
+    frame[d4] = en & 0xFF;
+    busLoadFrame(frame[d0], TRUE);
+    TRACE_FRAME(frame, TRUE);
+}
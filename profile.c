@@ -0,0 +1,149 @@
+/*
+ Routines for CBUS FLiM operations - part of CBUS libraries for PIC 18F
+  This work is licensed under the:
+      Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International License.
+   To view a copy of this license, visit:
+      http://creativecommons.org/licenses/by-nc-sa/4.0/
+   or send a letter to Creative Commons, PO Box 1866, Mountain View, CA 94042, USA.
+   License summary:
+    You are free to:
+      Share, copy and redistribute the material in any medium or format
+      Adapt, remix, transform, and build upon the material
+    The licensor cannot revoke these freedoms as long as you follow the license terms.
+    Attribution : You must give appropriate credit, provide a link to the license,
+                   and indicate if changes were made. You may do so in any reasonable manner,
+                   but not in any way that suggests the licensor endorses you or your use.
+    NonCommercial : You may not use the material for commercial purposes. **(see note below)
+    ShareAlike : If you remix, transform, or build upon the material, you must distribute
+                  your contributions under the same license as the original.
+    No additional restrictions : You may not apply legal terms or technological measures that
+                                  legally restrict others from doing anything the license permits.
+   ** For commercial use, please contact the original copyright holder(s) to agree licensing terms
+**************************************************************************************************************
+	The FLiM routines have no code or definitions that are specific to any
+	module, so they can be used to provide FLiM facilities for any module 
+	using these libraries.
+	
+*/ 
+/*
+ * File:   profile.c
+ *
+ * Created on 18 October 2026, 14:30
+ *
+ * Keeps min/max/mean and a log2 histogram of the execution time of each of
+ * the jobs run from the main loop. The results are read with RDGN using the
+ * DIAG_PROFILE service.
+ * 
+ * Times are measured with tickGet(). Its low word is the raw TMR0 count so a 
+ * single read gives both the tick timer and the TMR0 count, at a resolution
+ * of one TMR0 increment.
+ */
+
+#include "module.h"
+#ifdef PROFILE
+#include "TickTime.h"
+#include "profile.h"
+
+typedef struct {
+    WORD count;
+    WORD min;
+    WORD max;
+    DWORD total;                    // sum of times, used for the mean
+    WORD histogram[PROFILE_BUCKETS];
+    WORD startTime;                 // when the current call started
+} ProfileStats;
+
+static ProfileStats profiles[NUM_PROFILES];
+
+/**
+ * Clear the statistics.
+ */
+void profileInit(void) {
+    unsigned char job;
+    unsigned char b;
+    for (job=0; job<NUM_PROFILES; job++) {
+        profiles[job].count = 0;
+        profiles[job].min = 0xFFFF;
+        profiles[job].max = 0;
+        profiles[job].total = 0;
+        for (b=0; b<PROFILE_BUCKETS; b++) {
+            profiles[job].histogram[b] = 0;
+        }
+    }
+}
+
+/**
+ * Timestamp the start of a job. Each job has its own timestamp so jobs may
+ * be nested.
+ * @param job the PROF_xxx job number
+ */
+void profileBegin(unsigned char job) {
+    profiles[job].startTime = (WORD)tickGet();
+}
+
+/**
+ * Timestamp the end of a job and add it to the statistics.
+ * @param job the PROF_xxx job number
+ */
+void profileEnd(unsigned char job) {
+    WORD elapsed;
+    WORD t;
+    unsigned char b;
+    ProfileStats * p;
+    
+    p = &(profiles[job]);
+    elapsed = (WORD)tickGet() - p->startTime;
+    if (p->count == 0xFFFF) {
+        // halve the totals so the mean keeps tracking
+        p->count >>= 1;
+        p->total >>= 1;
+    }
+    p->count++;
+    p->total += elapsed;
+    if (elapsed < p->min) p->min = elapsed;
+    if (elapsed > p->max) p->max = elapsed;
+    // log2 bucket
+    b = 0;
+    for (t = elapsed>>1; t && (b < PROFILE_BUCKETS-1); t >>= 1) {
+        b++;
+    }
+    if (p->histogram[b] != 0xFFFF) {
+        p->histogram[b]++;
+    }
+}
+
+/**
+ * Get a DIAG_PROFILE diagnostic.
+ * @param code the job number in the upper nibble and PROFILE_xxx in the lower nibble
+ * @param value where to put the value
+ * @return TRUE if a valid code
+ */
+BOOL getProfileDiagnostic(BYTE code, WORD * value) {
+    unsigned char job = code >> 4;
+    unsigned char stat = code & 0x0F;
+    ProfileStats * p;
+    
+    if (job >= NUM_PROFILES) return FALSE;
+    p = &(profiles[job]);
+    switch (stat) {
+        case PROFILE_COUNT:
+            *value = p->count;
+            return TRUE;
+        case PROFILE_MIN:
+            *value = (p->count) ? p->min : 0;
+            return TRUE;
+        case PROFILE_MAX:
+            *value = p->max;
+            return TRUE;
+        case PROFILE_MEAN:
+            *value = (p->count) ? (WORD)(p->total / p->count) : 0;
+            return TRUE;
+        default:
+            if ((stat >= PROFILE_BUCKET0) && (stat < PROFILE_BUCKET0+PROFILE_BUCKETS)) {
+                *value = p->histogram[stat-PROFILE_BUCKET0];
+                return TRUE;
+            }
+    }
+    return FALSE;
+}
+#endif
@@ -0,0 +1,84 @@
+/*
+ Routines for CBUS FLiM operations - part of CBUS libraries for PIC 18F
+  This work is licensed under the:
+      Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International License.
+   To view a copy of this license, visit:
+      http://creativecommons.org/licenses/by-nc-sa/4.0/
+   or send a letter to Creative Commons, PO Box 1866, Mountain View, CA 94042, USA.
+   License summary:
+    You are free to:
+      Share, copy and redistribute the material in any medium or format
+      Adapt, remix, transform, and build upon the material
+    The licensor cannot revoke these freedoms as long as you follow the license terms.
+    Attribution : You must give appropriate credit, provide a link to the license,
+                   and indicate if changes were made. You may do so in any reasonable manner,
+                   but not in any way that suggests the licensor endorses you or your use.
+    NonCommercial : You may not use the material for commercial purposes. **(see note below)
+    ShareAlike : If you remix, transform, or build upon the material, you must distribute
+                  your contributions under the same license as the original.
+    No additional restrictions : You may not apply legal terms or technological measures that
+                                  legally restrict others from doing anything the license permits.
+   ** For commercial use, please contact the original copyright holder(s) to agree licensing terms
+**************************************************************************************************************
+	The FLiM routines have no code or definitions that are specific to any
+	module, so they can be used to provide FLiM facilities for any module 
+	using these libraries.
+	
+*/ 
+/* 
+ * File:   profile.h
+ *
+ * Created on 18 October 2026, 14:30
+ *
+ * Execution time profiling of the jobs run from the main loop.
+ * Only compiled when PROFILE is defined in module.h.
+ */
+
+#ifndef PROFILE_H
+#define	PROFILE_H
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+#include "GenericTypeDefs.h"
+#include "scheduler.h"
+
+/*
+ * The profiled jobs. The scheduled tasks use their task number.
+ */
+#define PROF_CBUS           NUM_TASKS       // checkCBUS
+#define PROF_ACCESSORY      (NUM_TASKS+1)   // an ACON/ACOF/ASON/ASOF from received to actions queued
+#define NUM_PROFILES        (NUM_TASKS+2)
+
+#define PROFILE_BUCKETS     8   // log2 histogram buckets
+
+/*
+ * The statistic part of a DIAG_PROFILE diagnostic code.
+ */
+#define PROFILE_COUNT       1   // number of calls
+#define PROFILE_MIN         2   // shortest call in ticks
+#define PROFILE_MAX         3   // longest call in ticks
+#define PROFILE_MEAN        4   // mean call in ticks
+#define PROFILE_BUCKET0     5   // histogram, calls taking less than 2 ticks
+                                // bucket n is calls taking 2^n to 2^(n+1)-1 ticks
+                                // the last bucket also holds everything longer
+
+#ifdef PROFILE
+#define PROFILE_BEGIN(job)      profileBegin(job)
+#define PROFILE_END(job)        profileEnd(job)
+#else
+#define PROFILE_BEGIN(job)
+#define PROFILE_END(job)
+#endif
+
+extern void profileInit(void);
+extern void profileBegin(unsigned char job);
+extern void profileEnd(unsigned char job);
+extern BOOL getProfileDiagnostic(BYTE code, WORD * value);
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif	/* PROFILE_H */
@@ -0,0 +1,175 @@
+/*
+ Routines for CBUS FLiM operations - part of CBUS libraries for PIC 18F
+  This work is licensed under the:
+      Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International License.
+   To view a copy of this license, visit:
+      http://creativecommons.org/licenses/by-nc-sa/4.0/
+   or send a letter to Creative Commons, PO Box 1866, Mountain View, CA 94042, USA.
+   License summary:
+    You are free to:
+      Share, copy and redistribute the material in any medium or format
+      Adapt, remix, transform, and build upon the material
+    The licensor cannot revoke these freedoms as long as you follow the license terms.
+    Attribution : You must give appropriate credit, provide a link to the license,
+                   and indicate if changes were made. You may do so in any reasonable manner,
+                   but not in any way that suggests the licensor endorses you or your use.
+    NonCommercial : You may not use the material for commercial purposes. **(see note below)
+    ShareAlike : If you remix, transform, or build upon the material, you must distribute
+                  your contributions under the same license as the original.
+    No additional restrictions : You may not apply legal terms or technological measures that
+                                  legally restrict others from doing anything the license permits.
+   ** For commercial use, please contact the original copyright holder(s) to agree licensing terms
+**************************************************************************************************************
+	The FLiM routines have no code or definitions that are specific to any
+	module, so they can be used to provide FLiM facilities for any module 
+	using these libraries.
+	
+*/ 
+/*
+ * File:   rangeEvents.c
+ *
+ * Created on 21 October 2026, 09:30
+ *
+ * A range entry is one learned event which also stands for the following 
+ * event numbers of the same node, so 16 servos operated by EN 1 to 16 need
+ * one event table entry rather than 16. Its EVs are:
+ * 
+ *  EV#1 ACTION_CONSUMER_RANGE
+ *  EV#2 the number of events covered, 2 to NUM_IO
+ *  EV#3 onwards the actions for the learned event
+ * 
+ * Event EN+k of the range does the same actions but with each IO action 
+ * moved k IOs up. Actions which would move past the last IO are dropped.
+ * 
+ * The range entries are found when the event table changes and kept in RAM
+ * so that an event which isn't in the table can be checked against them 
+ * arithmetically. A range is one entry of the event table as far as the 
+ * configuration tools are concerned: NUMEV counts it once, NERD reports it
+ * with one ENRSP for its first event and REVAL of that index reads its EVs,
+ * with the number of events covered in EV#2. The other events of the range
+ * are not reported so that every ENRSP index is a real table entry.
+ * 
+ * Ranges are only recognised on the fast accessory path, which is used for
+ * ACON/ACOF/ASON/ASOF in FLiM outside learn mode, so RANGE_EVENTS depends 
+ * upon FAST_ACCESSORY_PATH in module.h. Everywhere else, in SLiM, in learn
+ * mode and for AREQ/ASRQ, CBUSlib looks events up with findEvent() which 
+ * only knows the table entries, so only the range entry's own event works.
+ * 
+ * ACTION_CONSUMER_RANGE is above NUM_CONSUMER_ACTIONS so if a range entry's
+ * EVs are ever processed without being expanded EV#1 is ignored rather than
+ * taken as a global action.
+ */
+
+#include "module.h"
+#include "events.h"
+#include "cbus.h"
+#include "rangeEvents.h"
+
+#ifdef RANGE_EVENTS
+
+#define RANGE_EVS   2   // EVs used to describe the range
+
+static WORD rangeNN[MAX_RANGES];
+static WORD rangeEN[MAX_RANGES];
+static BYTE rangeCount[MAX_RANGES];
+static BYTE rangeIndex[MAX_RANGES];
+static BYTE ranges;
+
+/**
+ * Find the range entries. Called during initialisation after the event 
+ * table is ready.
+ */
+void rangeEventsInit(void) {
+    rangeEventsChanged();
+}
+
+/**
+ * Find the range entries again after the event table may have changed.
+ * Only EV#1 and EV#2 of each event are read so this is quick enough to do
+ * straight away.
+ */
+void rangeEventsChanged(void) {
+    BYTE tableIndex;
+    int count;
+    
+    ranges = 0;
+    for (tableIndex=0; (tableIndex<NUM_EVENTS) && (ranges<MAX_RANGES); tableIndex++) {
+        if ( ! validStart(tableIndex)) continue;
+        if (getEv(tableIndex, 1) != ACTION_CONSUMER_RANGE) continue;
+        count = getEv(tableIndex, 2);
+        if ((count < 2) || (count > NUM_IO)) continue;
+        rangeNN[ranges] = getNN(tableIndex);
+        rangeEN[ranges] = getEN(tableIndex);
+        rangeCount[ranges] = count;
+        rangeIndex[ranges] = tableIndex;
+        ranges++;
+    }
+}
+
+/**
+ * Find a received event in the event table or within a range.
+ * @param nn the event's node number, 0 for a short event
+ * @param en the event number
+ * @return the event table index of the event or its range entry, NO_INDEX if not found
+ */
+BYTE rangeFind(WORD nn, WORD en) {
+    BYTE tableIndex;
+    BYTE r;
+    
+    tableIndex = FIND_EVENT(nn, en);
+    if (tableIndex != NO_INDEX) {
+        return tableIndex;
+    }
+    for (r=0; r<ranges; r++) {
+        if ((rangeNN[r] == nn) && (en > rangeEN[r]) && (en - rangeEN[r] < rangeCount[r])) {
+            return rangeIndex[r];
+        }
+    }
+    return NO_INDEX;
+}
+
+/**
+ * Turn the EVs of a range entry in evs[] into the EVs of the received 
+ * event so they can be processed like any other event.
+ * @param tableIndex the range entry
+ * @param msg the received event
+ */
+void expandRange(BYTE tableIndex, BYTE * msg) {
+    BYTE offset;
+    BYTE e;
+    BYTE action;
+    
+    offset = (BYTE)((((WORD)msg[d3] << 8) | msg[d4]) - getEN(tableIndex));
+    for (e=1; e<EVperEVT-RANGE_EVS; e++) {
+        action = evs[e+RANGE_EVS];
+        if (((action&ACTION_MASK) >= ACTION_CONSUMER_IO_BASE) && (offset > 0)) {
+            if ((action&ACTION_MASK) + (WORD)offset*CONSUMER_ACTIONS_PER_IO < NUM_CONSUMER_ACTIONS) {
+                action += offset*CONSUMER_ACTIONS_PER_IO;
+            } else {
+                action = NO_ACTION;
+            }
+        }
+        evs[e] = action;
+    }
+    for ( ; e<EVperEVT; e++) {
+        evs[e] = NO_ACTION;
+    }
+}
+
+/**
+ * Get a range.
+ * @param range the range, 0 to MAX_RANGES-1
+ * @param nn where to put the NN
+ * @param en where to put the first EN
+ * @return the number of events covered, 0 if there is no such range
+ */
+BYTE getRange(BYTE range, WORD * nn, WORD * en) {
+    if (range >= ranges) {
+        return 0;
+    }
+    *nn = rangeNN[range];
+    *en = rangeEN[range];
+    return rangeCount[range];
+}
+
+#endif
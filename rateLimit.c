@@ -0,0 +1,221 @@
+/*
+ Routines for CBUS FLiM operations - part of CBUS libraries for PIC 18F
+  This work is licensed under the:
+      Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International License.
+   To view a copy of this license, visit:
+      http://creativecommons.org/licenses/by-nc-sa/4.0/
+   or send a letter to Creative Commons, PO Box 1866, Mountain View, CA 94042, USA.
+   License summary:
+    You are free to:
+      Share, copy and redistribute the material in any medium or format
+      Adapt, remix, transform, and build upon the material
+    The licensor cannot revoke these freedoms as long as you follow the license terms.
+    Attribution : You must give appropriate credit, provide a link to the license,
+                   and indicate if changes were made. You may do so in any reasonable manner,
+                   but not in any way that suggests the licensor endorses you or your use.
+    NonCommercial : You may not use the material for commercial purposes. **(see note below)
+    ShareAlike : If you remix, transform, or build upon the material, you must distribute
+                  your contributions under the same license as the original.
+    No additional restrictions : You may not apply legal terms or technological measures that
+                                  legally restrict others from doing anything the license permits.
+   ** For commercial use, please contact the original copyright holder(s) to agree licensing terms
+**************************************************************************************************************
+	The FLiM routines have no code or definitions that are specific to any
+	module, so they can be used to provide FLiM facilities for any module 
+	using these libraries.
+	
+*/ 
+/*
+ * File:   rateLimit.c
+ *
+ * Created on 18 October 2026, 21:05
+ *
+ * Each IO has a token bucket. Sending a produced event uses a token and the
+ * tokens are refilled every 100ms at the configured rate up to the burst
+ * size. The rate and burst come from the IO's own NVs for INPUTs if set, 
+ * otherwise from the global NV_EVENT_RATE and NV_EVENT_BURST. A rate of 0 
+ * means no limit.
+ * 
+ * When an IO has run out of tokens its events are not sent but the latest 
+ * state of each of its producer actions is remembered. Once tokens are 
+ * available again that latest state is sent, so a chattering input ends up
+ * reporting its final state rather than every transition. The number of 
+ * events replaced by a later one is counted for each IO and can be read 
+ * using RDGN with the DIAG_RATE_LIMIT service, code is IO+1.
+ * 
+ * Tokens are held in tenths so that the refill every 100ms of rate/10 tokens
+ * is a whole number.
+ */
+
+#include "module.h"
+#include "mioNv.h"
+#include "mioEvents.h"
+#include "FliM.h"
+#include "TickTime.h"
+#include "txQueue.h"
+#include "rateLimit.h"
+
+#define TOKEN       10      // tokens are held in tenths
+
+static WORD tokens[NUM_IO];
+static BYTE pending[NUM_IO];    // bit per producer action waiting, upper nibble has their state
+static WORD suppressed[NUM_IO];
+static TickValue lastRefill;
+
+// forward declarations
+static BYTE getRate(unsigned char io);
+static WORD getBucketSize(unsigned char io);
+static void flushPending(unsigned char io, BOOL all);
+static BYTE getPriority(unsigned char io);
+
+/**
+ * Start with full buckets.
+ */
+void rateLimitInit(void) {
+    unsigned char io;
+    for (io=0; io<NUM_IO; io++) {
+        tokens[io] = getBucketSize(io);
+        pending[io] = 0;
+        suppressed[io] = 0;
+    }
+    lastRefill.Val = tickGet();
+}
+
+/**
+ * Send a produced event from an input or analogue IO subject to the IO's 
+ * rate limit.
+ * @param action the producer action
+ * @param on TRUE (any non zero value) for an ON event
+ * @return FALSE if the event was lost because the transmit queue was full
+ */
+BOOL queueLimitedEvent(PRODUCER_ACTION_T action, BOOL on) {
+    unsigned char io;
+    BYTE bit;
+    
+    if (action < ACTION_PRODUCER_IO_BASE) {
+        return queueProducedEvent(action, on, TX_PRIORITY_OUTPUT);
+    }
+    io = PRODUCER_IO(action);
+    if (getRate(io) == 0) {
+        return queueProducedEvent(action, on, getPriority(io));
+    }
+    if (((pending[io] & 0x0F) == 0) && (tokens[io] >= TOKEN)) {
+        tokens[io] -= TOKEN;
+        return queueProducedEvent(action, on, getPriority(io));
+    }
+    // out of tokens so remember the latest state
+    bit = 1 << PRODUCER_ACTION(action);
+    if (pending[io] & bit) {
+        // previous state is overwritten
+        if (suppressed[io] != 0xFFFF) suppressed[io]++;
+    }
+    pending[io] |= bit;
+    if (on) {
+        pending[io] |= (bit << 4);
+    } else {
+        pending[io] &= ~(bit << 4);
+    }
+    return TRUE;
+}
+
+/**
+ * Refill the buckets and send any waiting events. Called from the main loop,
+ * does nothing until 100ms has passed since the last refill.
+ */
+void pollRateLimit(void) {
+    unsigned char io;
+    BYTE rate;
+    WORD bucketSize;
+    
+    if (tickTimeSince(lastRefill) < HUNDRED_MILI_SECOND) return;
+    lastRefill.Val = tickGet();
+    
+    for (io=0; io<NUM_IO; io++) {
+        rate = getRate(io);
+        bucketSize = getBucketSize(io);
+        tokens[io] += rate;
+        if (tokens[io] > bucketSize) {
+            tokens[io] = bucketSize;
+        }
+        if (pending[io]) {
+            // a rate of 0 means the limit has been turned off so send everything
+            flushPending(io, (rate == 0));
+        }
+    }
+}
+
+/**
+ * Send the waiting events of an IO whilst there are tokens. An event the 
+ * transmit queue has no room for stays pending, and keeps its token, until
+ * the next refill.
+ * @param io the IO
+ * @param all TRUE to send them regardless of tokens
+ */
+static void flushPending(unsigned char io, BOOL all) {
+    unsigned char a;
+    BYTE bit;
+    
+    for (a=0; a<PRODUCER_ACTIONS_PER_IO; a++) {
+        bit = 1 << a;
+        if ( ! (pending[io] & bit)) continue;
+        if (( ! all) && (tokens[io] < TOKEN)) return;
+        if ( ! queueProducedEvent(ACTION_IO_PRODUCER_BASE(io)+a, pending[io] & (bit << 4), getPriority(io))) {
+            return;     // transmit queue full
+        }
+        if ( ! all) {
+            tokens[io] -= TOKEN;
+        }
+        pending[io] &= ~(bit | (bit << 4));
+    }
+}
+
+/**
+ * Get the transmit queue priority for events produced by an IO.
+ * @param io the IO
+ * @return TX_PRIORITY_INPUT for inputs otherwise TX_PRIORITY_OUTPUT
+ */
+static BYTE getPriority(unsigned char io) {
+    return (NV->io[io].type == TYPE_INPUT) ? TX_PRIORITY_INPUT : TX_PRIORITY_OUTPUT;
+}
+
+/**
+ * Get the rate limit for an IO.
+ * @param io the IO
+ * @return events per second, 0 for no limit
+ */
+static BYTE getRate(unsigned char io) {
+    if ((NV->io[io].type == TYPE_INPUT) && (NV->io[io].nv_io.nv_input.input_event_rate != 0)) {
+        return NV->io[io].nv_io.nv_input.input_event_rate;
+    }
+    return NV->event_rate;
+}
+
+/**
+ * Get the bucket size for an IO.
+ * @param io the IO
+ * @return maximum tokens in tenths
+ */
+static WORD getBucketSize(unsigned char io) {
+    BYTE burst;
+    if ((NV->io[io].type == TYPE_INPUT) && (NV->io[io].nv_io.nv_input.input_event_burst != 0)) {
+        burst = NV->io[io].nv_io.nv_input.input_event_burst;
+    } else {
+        burst = NV->event_burst;
+    }
+    if (burst == 0) {
+        burst = DEFAULT_EVENT_BURST;
+    }
+    return (WORD)burst * TOKEN;
+}
+
+/**
+ * Get a DIAG_RATE_LIMIT diagnostic.
+ * @param code IO+1
+ * @param value where to put the number of events suppressed for the IO
+ * @return TRUE if a valid code
+ */
+BOOL getRateLimitDiagnostic(BYTE code, WORD * value) {
+    if ((code == 0) || (code > NUM_IO)) return FALSE;
+    *value = suppressed[code-1];
+    return TRUE;
+}
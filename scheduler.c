@@ -0,0 +1,204 @@
+/*
+ Routines for CBUS FLiM operations - part of CBUS libraries for PIC 18F
+  This work is licensed under the:
+      Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International License.
+   To view a copy of this license, visit:
+      http://creativecommons.org/licenses/by-nc-sa/4.0/
+   or send a letter to Creative Commons, PO Box 1866, Mountain View, CA 94042, USA.
+   License summary:
+    You are free to:
+      Share, copy and redistribute the material in any medium or format
+      Adapt, remix, transform, and build upon the material
+    The licensor cannot revoke these freedoms as long as you follow the license terms.
+    Attribution : You must give appropriate credit, provide a link to the license,
+                   and indicate if changes were made. You may do so in any reasonable manner,
+                   but not in any way that suggests the licensor endorses you or your use.
+    NonCommercial : You may not use the material for commercial purposes. **(see note below)
+    ShareAlike : If you remix, transform, or build upon the material, you must distribute
+                  your contributions under the same license as the original.
+    No additional restrictions : You may not apply legal terms or technological measures that
+                                  legally restrict others from doing anything the license permits.
+   ** For commercial use, please contact the original copyright holder(s) to agree licensing terms
+**************************************************************************************************************
+	The FLiM routines have no code or definitions that are specific to any
+	module, so they can be used to provide FLiM facilities for any module 
+	using these libraries.
+	
+*/ 
+/*
+ * File:   scheduler.c
+ *
+ * Created on 18 October 2026, 10:12
+ *
+ * Runs the periodic jobs of the main loop from a static task table.
+ * 
+ * Each task has a period, a phase offset and the tick of its next deadline.
+ * When a task is dispatched its deadline is advanced by exactly one period
+ * from the previous deadline, not from the time the job finished, so the
+ * job's own runtime does not make the period drift. The phase offsets spread
+ * the tasks out so they don't all fall due on the same pass of the loop.
+ * 
+ * The scheduler doesn't read the tick itself, the caller passes the current
+ * tick in. This keeps the module free of hardware dependencies.
+ */
+
+#include <stddef.h>
+#include "GenericTypeDefs.h"
+#include "scheduler.h"
+#include "module.h"
+#include "profile.h"
+
+static Task tasks[NUM_TASKS];
+static BYTE runTasks;           // bit per task that has run since last taken
+static BYTE startedTasks;       // bit per task that has been started
+
+// forward declarations
+static BOOL reached(DWORD now, DWORD deadline);
+
+/**
+ * Set up an entry in the task table. Must be called before schedulerStart().
+ * @param id the task number TASK_xxx
+ * @param task the job to be run, or NULL to disable the entry
+ * @param period ticks between runs
+ * @param phase ticks after the scheduler start that the first run is due
+ */
+void schedulerSetTask(unsigned char id, void (*task)(void), WORD period, WORD phase) {
+    if (id >= NUM_TASKS) return;
+    tasks[id].task = task;
+    tasks[id].period = period;
+    tasks[id].phase = phase;
+    tasks[id].deadline = 0;
+    tasks[id].missed = 0;
+    startedTasks &= ~(1<<id);
+}
+
+/**
+ * Change the period of a task. The change takes effect from the next run so
+ * this may be called whilst the scheduler is running.
+ * @param id the task number TASK_xxx
+ * @param period ticks between runs
+ */
+void schedulerSetPeriod(unsigned char id, WORD period) {
+    if (id >= NUM_TASKS) return;
+    tasks[id].period = period;
+}
+
+/**
+ * Start a single task. Its first deadline is its phase offset from now.
+ * Tasks which haven't been started are not run.
+ * @param id the task number TASK_xxx
+ * @param now the current tick
+ */
+void schedulerStartTask(unsigned char id, DWORD now) {
+    if (id >= NUM_TASKS) return;
+    tasks[id].deadline = now + tasks[id].phase;
+    startedTasks |= (1<<id);
+}
+
+/**
+ * Start all the tasks.
+ * @param now the current tick
+ */
+void schedulerStart(DWORD now) {
+    unsigned char id;
+    for (id=0; id<NUM_TASKS; id++) {
+        schedulerStartTask(id, now);
+    }
+}
+
+/**
+ * Dispatch the tasks that are due. Called on every pass of the main loop.
+ * If a task has fallen more than a whole period behind the missed runs are
+ * skipped rather than run back to back, keeping the task on its phase.
+ * 
+ * @param now the current tick
+ */
+void schedulerRun(DWORD now) {
+    unsigned char id;
+    Task * t;
+    
+    for (id=0; id<NUM_TASKS; id++) {
+        t = &(tasks[id]);
+        if (t->task == NULL) continue;
+        if ( ! (startedTasks & (1<<id))) continue;
+        if ( ! reached(now, t->deadline)) continue;
+        if (t->period == 0) {
+            // run on every pass
+            t->deadline = now;
+            PROFILE_BEGIN(id);
+            (*t->task)();
+            PROFILE_END(id);
+            runTasks |= (1<<id);
+            continue;
+        }
+        t->deadline += t->period;
+        while (reached(now, t->deadline)) {
+            // more than a period late so skip the slot
+            t->deadline += t->period;
+            if (t->missed != 0xFFFF) t->missed++;
+        }
+        PROFILE_BEGIN(id);
+        (*t->task)();
+        PROFILE_END(id);
+        runTasks |= (1<<id);
+    }
+}
+
+/**
+ * Check whether a task is due to run.
+ * @param id the task number TASK_xxx
+ * @param now the current tick
+ * @return TRUE if the task is set up, started and its deadline has passed
+ */
+BOOL schedulerDue(unsigned char id, DWORD now) {
+    if (id >= NUM_TASKS) return FALSE;
+    if (tasks[id].task == NULL) return FALSE;
+    if ( ! (startedTasks & (1<<id))) return FALSE;
+    return reached(now, tasks[id].deadline);
+}
+
+/**
+ * Check whether a deadline has been reached. Deadlines are never more than 
+ * half the tick range away so the difference taken as signed copes with the
+ * tick wrapping. Done without a cast to long so that it doesn't depend upon
+ * the size of long.
+ * @param now the current tick
+ * @param deadline the deadline
+ * @return TRUE if now is at or after the deadline
+ */
+static BOOL reached(DWORD now, DWORD deadline) {
+    return ((DWORD)(now - deadline) & 0x80000000UL) == 0;
+}
+
+/**
+ * Get the number of slots a task has missed since it was set up.
+ * @param id the task number TASK_xxx
+ * @return the number of missed slots
+ */
+WORD schedulerMissed(unsigned char id) {
+    if (id >= NUM_TASKS) return 0;
+    return tasks[id].missed;
+}
+
+/**
+ * Get the tasks which have been set up.
+ * @return a bit per task number
+ */
+BYTE schedulerEnabledTasks(void) {
+    unsigned char id;
+    BYTE enabled = 0;
+    for (id=0; id<NUM_TASKS; id++) {
+        if (tasks[id].task != NULL) enabled |= (1<<id);
+    }
+    return enabled;
+}
+
+/**
+ * Get the tasks which have run since the last call and clear the record.
+ * @return a bit per task number
+ */
+BYTE schedulerTakeRunTasks(void) {
+    BYTE ran = runTasks;
+    runTasks = 0;
+    return ran;
+}
@@ -0,0 +1,79 @@
+/*
+ Routines for CBUS FLiM operations - part of CBUS libraries for PIC 18F
+  This work is licensed under the:
+      Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International License.
+   To view a copy of this license, visit:
+      http://creativecommons.org/licenses/by-nc-sa/4.0/
+   or send a letter to Creative Commons, PO Box 1866, Mountain View, CA 94042, USA.
+   License summary:
+    You are free to:
+      Share, copy and redistribute the material in any medium or format
+      Adapt, remix, transform, and build upon the material
+    The licensor cannot revoke these freedoms as long as you follow the license terms.
+    Attribution : You must give appropriate credit, provide a link to the license,
+                   and indicate if changes were made. You may do so in any reasonable manner,
+                   but not in any way that suggests the licensor endorses you or your use.
+    NonCommercial : You may not use the material for commercial purposes. **(see note below)
+    ShareAlike : If you remix, transform, or build upon the material, you must distribute
+                  your contributions under the same license as the original.
+    No additional restrictions : You may not apply legal terms or technological measures that
+                                  legally restrict others from doing anything the license permits.
+   ** For commercial use, please contact the original copyright holder(s) to agree licensing terms
+**************************************************************************************************************
+	The FLiM routines have no code or definitions that are specific to any
+	module, so they can be used to provide FLiM facilities for any module 
+	using these libraries.
+	
+*/ 
+/* 
+ * File:   scheduler.h
+ *
+ * Created on 18 October 2026, 10:12
+ *
+ * A small cooperative scheduler for the periodic jobs run from the main loop.
+ */
+
+#ifndef SCHEDULER_H
+#define	SCHEDULER_H
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+#include "GenericTypeDefs.h"
+
+/*
+ * The periodic tasks. The table is scanned in this order so lower numbers
+ * get serviced first when several tasks become due together.
+ */
+#define TASK_SERVO          0   // start the next block of servo pulses
+#define TASK_INPUTS         1   // scan the inputs
+#define TASK_ACTIONS        2   // process the action queue and pulse/flash outputs
+#define TASK_ANALOGUE       3   // low priority, read the next analogue input
+#define TASK_LEDS           4   // low priority, update the status LEDs
+#define TASK_1TRACK         5   // low priority, run the 1Track logic
+#define NUM_TASKS           6
+
+typedef struct {
+    void (*task)(void);         // the job to run, NULL if not used
+    WORD period;                // ticks between successive runs
+    WORD phase;                 // offset of the first run from the scheduler start
+    DWORD deadline;             // tick at which the task is next due
+    WORD missed;                // number of slots skipped because the task was late
+} Task;
+
+extern void schedulerSetTask(unsigned char id, void (*task)(void), WORD period, WORD phase);
+extern void schedulerSetPeriod(unsigned char id, WORD period);
+extern void schedulerStartTask(unsigned char id, DWORD now);
+extern void schedulerStart(DWORD now);
+extern void schedulerRun(DWORD now);
+extern BOOL schedulerDue(unsigned char id, DWORD now);
+extern WORD schedulerMissed(unsigned char id);
+extern BYTE schedulerEnabledTasks(void);
+extern BYTE schedulerTakeRunTasks(void);
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif	/* SCHEDULER_H */
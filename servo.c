@@ -66,6 +66,9 @@
 #include "servo.h"
 #include "actionQueue.h"
 #include "bounce.h"
+#include "txQueue.h"
+#include "latency.h"
+#include "stateJournal.h"
 
 #define POS2TICK_OFFSET         3600    // change this to affect the min pulse width
 #define POS2TICK_MULTIPLIER     19      // change this to affect the max pulse width
@@ -84,7 +87,6 @@ void setupTimer4(unsigned char io);
 
 // Externs
 extern void setOutputPin(unsigned char io, BOOL state);
-extern TickValue   lastServoStartTime;
 
 // Variables
 ServoState servoState[NUM_IO];
@@ -119,7 +121,7 @@ void initServos(void) {
             servoState[io] = OFF;
         }
         ticksWhenStopped[io].Val = tickGet();
-        currentPos[io] = targetPos[io] = ee_read(EE_OP_STATE+io);   // restore last known positions
+        currentPos[io] = targetPos[io] = READ_OUTPUT_STATE(io);   // restore last known positions
         stepsPerPollSpeed[io] = 0;
     }
     
@@ -196,6 +198,7 @@ void setupTimer1(unsigned char io) {
     // turn on output
     setOutputPin(io, !(NV->io[io].flags & FLAG_RESULT_ACTION_INVERTED));
     T1CONbits.TMR1ON = 1;       // enable Timer1
+    LATENCY_PULSE(io);
 }
 void setupTimer3(unsigned char io) {
     WORD ticks = 0xFFFF -(POS2TICK_OFFSET + (WORD)POS2TICK_MULTIPLIER * currentPos[io]);
@@ -208,6 +211,7 @@ void setupTimer3(unsigned char io) {
     // turn on output
     setOutputPin(io, !(NV->io[io].flags & FLAG_RESULT_ACTION_INVERTED));
     T3CONbits.TMR3ON = 1;       // enable Timer3
+    LATENCY_PULSE(io);
 }
 
 
@@ -250,9 +254,9 @@ void pollServos(void) {
                 switch (servoState[io]) {
                     case STARTING:
                         if (currentPos[io]==NV->io[io].nv_io.nv_servo.servo_start_pos) {
-                            sendProducedEvent(ACTION_IO_PRODUCER_SERVO_START(io), NV->io[io].flags & FLAG_RESULT_EVENT_INVERTED);
+                            queueProducedEvent(ACTION_IO_PRODUCER_SERVO_START(io), NV->io[io].flags & FLAG_RESULT_EVENT_INVERTED, TX_PRIORITY_OUTPUT);
                         } else {
-                            sendProducedEvent(ACTION_IO_PRODUCER_SERVO_END(io), NV->io[io].flags & FLAG_RESULT_EVENT_INVERTED);
+                            queueProducedEvent(ACTION_IO_PRODUCER_SERVO_END(io), NV->io[io].flags & FLAG_RESULT_EVENT_INVERTED, TX_PRIORITY_OUTPUT);
                         }
                         servoState[io] = MOVING;
                         // fall through
@@ -284,7 +288,7 @@ void pollServos(void) {
                                 // passed through midway point
                                 // we send an ACON/ACOF depending upon direction servo was moving
                                 // This can then be used to drive frog switching relays
-                                sendProducedEvent(ACTION_IO_PRODUCER_SERVO_MID(io), !(NV->io[io].flags & FLAG_RESULT_EVENT_INVERTED));
+                                queueProducedEvent(ACTION_IO_PRODUCER_SERVO_MID(io), !(NV->io[io].flags & FLAG_RESULT_EVENT_INVERTED), TX_PRIORITY_OUTPUT);
                             }
                         } else if (targetPos[io] < currentPos[io]) {
                             if (currentPos[io] > midway) {
@@ -311,7 +315,7 @@ void pollServos(void) {
                             }
                             if ((currentPos[io] <= midway) && beforeMidway) {
                                 // passed through midway point
-                                sendProducedEvent(ACTION_IO_PRODUCER_SERVO_MID(io), NV->io[io].flags & FLAG_RESULT_EVENT_INVERTED);
+                                queueProducedEvent(ACTION_IO_PRODUCER_SERVO_MID(io), NV->io[io].flags & FLAG_RESULT_EVENT_INVERTED, TX_PRIORITY_OUTPUT);
                             }
                         }
                         if (targetPos[io] == currentPos[io]) {
@@ -319,11 +323,11 @@ void pollServos(void) {
                             ticksWhenStopped[io].Val = tickGet();
                             // send ON event or OFF
                             if (currentPos[io] == NV->io[io].nv_io.nv_servo.servo_start_pos) { //ON means move to End
-                                sendProducedEvent(ACTION_IO_PRODUCER_SERVO_START(io), !(NV->io[io].flags & FLAG_RESULT_EVENT_INVERTED));
+                                queueProducedEvent(ACTION_IO_PRODUCER_SERVO_START(io), !(NV->io[io].flags & FLAG_RESULT_EVENT_INVERTED), TX_PRIORITY_OUTPUT);
                             } else {
-                                sendProducedEvent(ACTION_IO_PRODUCER_SERVO_END(io), !(NV->io[io].flags & FLAG_RESULT_EVENT_INVERTED));
+                                queueProducedEvent(ACTION_IO_PRODUCER_SERVO_END(io), !(NV->io[io].flags & FLAG_RESULT_EVENT_INVERTED), TX_PRIORITY_OUTPUT);
                             }
-                            ee_write(EE_OP_STATE+io, currentPos[io]);
+                            SAVE_OUTPUT_STATE(io, currentPos[io]);
                         }
                         break;
                 }
@@ -342,8 +346,8 @@ void pollServos(void) {
                             servoState[io] = STOPPED;
                             ticksWhenStopped[io].Val = tickGet();
                             currentPos[io] = targetPos[io];
-                            sendProducedEvent(ACTION_IO_PRODUCER_BOUNCE(io), !(NV->io[io].flags & FLAG_RESULT_EVENT_INVERTED));
-                            ee_write(EE_OP_STATE+io, currentPos[io]);
+                            queueProducedEvent(ACTION_IO_PRODUCER_BOUNCE(io), !(NV->io[io].flags & FLAG_RESULT_EVENT_INVERTED), TX_PRIORITY_OUTPUT);
+                            SAVE_OUTPUT_STATE(io, currentPos[io]);
                             break;
                         }
                         // Implement the bounce algorithm here
@@ -356,16 +360,16 @@ void pollServos(void) {
                                 servoState[io] = STOPPED;
                                 ticksWhenStopped[io].Val = tickGet();
                                 currentPos[io] = targetPos[io];
-                                sendProducedEvent(ACTION_IO_PRODUCER_BOUNCE(io), !(NV->io[io].flags & FLAG_RESULT_EVENT_INVERTED));
-                                ee_write(EE_OP_STATE+io, currentPos[io]);
+                                queueProducedEvent(ACTION_IO_PRODUCER_BOUNCE(io), !(NV->io[io].flags & FLAG_RESULT_EVENT_INVERTED), TX_PRIORITY_OUTPUT);
+                                SAVE_OUTPUT_STATE(io, currentPos[io]);
                             }
                         } else {
                             if (bounceDown(io)) {
                                 servoState[io] = STOPPED;
                                 ticksWhenStopped[io].Val = tickGet();
                                 currentPos[io] = targetPos[io];
-                                sendProducedEvent(ACTION_IO_PRODUCER_BOUNCE(io), NV->io[io].flags & FLAG_RESULT_EVENT_INVERTED);
-                                ee_write(EE_OP_STATE+io, currentPos[io]);
+                                queueProducedEvent(ACTION_IO_PRODUCER_BOUNCE(io), NV->io[io].flags & FLAG_RESULT_EVENT_INVERTED, TX_PRIORITY_OUTPUT);
+                                SAVE_OUTPUT_STATE(io, currentPos[io]);
                             }
                         }
                         break;
@@ -375,16 +379,16 @@ void pollServos(void) {
                 switch (servoState[io]) {
                     case STARTING:
                         if (currentPos[io] == NV->io[io].nv_io.nv_multi.multi_pos1) {
-                            sendProducedEvent(ACTION_IO_PRODUCER_MULTI_AT1(io), NV->io[io].flags & FLAG_RESULT_EVENT_INVERTED);
+                            queueProducedEvent(ACTION_IO_PRODUCER_MULTI_AT1(io), NV->io[io].flags & FLAG_RESULT_EVENT_INVERTED, TX_PRIORITY_OUTPUT);
                         }
                         if (currentPos[io] == NV->io[io].nv_io.nv_multi.multi_pos2) {
-                            sendProducedEvent(ACTION_IO_PRODUCER_MULTI_AT2(io), NV->io[io].flags & FLAG_RESULT_EVENT_INVERTED);
+                            queueProducedEvent(ACTION_IO_PRODUCER_MULTI_AT2(io), NV->io[io].flags & FLAG_RESULT_EVENT_INVERTED, TX_PRIORITY_OUTPUT);
                         }
                         if (currentPos[io] == NV->io[io].nv_io.nv_multi.multi_pos3) {
-                            sendProducedEvent(ACTION_IO_PRODUCER_MULTI_AT3(io), NV->io[io].flags & FLAG_RESULT_EVENT_INVERTED);
+                            queueProducedEvent(ACTION_IO_PRODUCER_MULTI_AT3(io), NV->io[io].flags & FLAG_RESULT_EVENT_INVERTED, TX_PRIORITY_OUTPUT);
                         }
                         if (currentPos[io] == NV->io[io].nv_io.nv_multi.multi_pos4) {
-                            sendProducedEvent(ACTION_IO_PRODUCER_MULTI_AT4(io), NV->io[io].flags & FLAG_RESULT_EVENT_INVERTED);
+                            queueProducedEvent(ACTION_IO_PRODUCER_MULTI_AT4(io), NV->io[io].flags & FLAG_RESULT_EVENT_INVERTED, TX_PRIORITY_OUTPUT);
                         }
                         servoState[io] = MOVING;
                         // fall through
@@ -422,18 +426,18 @@ void pollServos(void) {
                             ticksWhenStopped[io].Val = tickGet();
                             // MULTI only sends ON events. Work out which event
                             if (currentPos[io] == NV->io[io].nv_io.nv_multi.multi_pos1) {
-                                sendProducedEvent(ACTION_IO_PRODUCER_MULTI_AT1(io), !(NV->io[io].flags & FLAG_RESULT_EVENT_INVERTED));
+                                queueProducedEvent(ACTION_IO_PRODUCER_MULTI_AT1(io), !(NV->io[io].flags & FLAG_RESULT_EVENT_INVERTED), TX_PRIORITY_OUTPUT);
                             }
                             if (currentPos[io] == NV->io[io].nv_io.nv_multi.multi_pos2) {
-                                sendProducedEvent(ACTION_IO_PRODUCER_MULTI_AT2(io), !(NV->io[io].flags & FLAG_RESULT_EVENT_INVERTED));
+                                queueProducedEvent(ACTION_IO_PRODUCER_MULTI_AT2(io), !(NV->io[io].flags & FLAG_RESULT_EVENT_INVERTED), TX_PRIORITY_OUTPUT);
                             }
                             if (currentPos[io] == NV->io[io].nv_io.nv_multi.multi_pos3) {
-                                sendProducedEvent(ACTION_IO_PRODUCER_MULTI_AT3(io), !(NV->io[io].flags & FLAG_RESULT_EVENT_INVERTED));
+                                queueProducedEvent(ACTION_IO_PRODUCER_MULTI_AT3(io), !(NV->io[io].flags & FLAG_RESULT_EVENT_INVERTED), TX_PRIORITY_OUTPUT);
                             }
                             if (currentPos[io] == NV->io[io].nv_io.nv_multi.multi_pos4) {
-                                sendProducedEvent(ACTION_IO_PRODUCER_MULTI_AT4(io), !(NV->io[io].flags & FLAG_RESULT_EVENT_INVERTED));
+                                queueProducedEvent(ACTION_IO_PRODUCER_MULTI_AT4(io), !(NV->io[io].flags & FLAG_RESULT_EVENT_INVERTED), TX_PRIORITY_OUTPUT);
                             }
-                            ee_write(EE_OP_STATE+io, currentPos[io]);
+                            SAVE_OUTPUT_STATE(io, currentPos[io]);
                         }
                         break;
                 }
@@ -0,0 +1,240 @@
+/*
+ Routines for CBUS FLiM operations - part of CBUS libraries for PIC 18F
+  This work is licensed under the:
+      Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International License.
+   To view a copy of this license, visit:
+      http://creativecommons.org/licenses/by-nc-sa/4.0/
+   or send a letter to Creative Commons, PO Box 1866, Mountain View, CA 94042, USA.
+   License summary:
+    You are free to:
+      Share, copy and redistribute the material in any medium or format
+      Adapt, remix, transform, and build upon the material
+    The licensor cannot revoke these freedoms as long as you follow the license terms.
+    Attribution : You must give appropriate credit, provide a link to the license,
+                   and indicate if changes were made. You may do so in any reasonable manner,
+                   but not in any way that suggests the licensor endorses you or your use.
+    NonCommercial : You may not use the material for commercial purposes. **(see note below)
+    ShareAlike : If you remix, transform, or build upon the material, you must distribute
+                  your contributions under the same license as the original.
+    No additional restrictions : You may not apply legal terms or technological measures that
+                                  legally restrict others from doing anything the license permits.
+   ** For commercial use, please contact the original copyright holder(s) to agree licensing terms
+**************************************************************************************************************
+	The FLiM routines have no code or definitions that are specific to any
+	module, so they can be used to provide FLiM facilities for any module 
+	using these libraries.
+	
+*/ 
+/*
+ * File:   stateJournal.c
+ *
+ * Created on 22 October 2026, 15:40
+ *
+ * The state of each output is saved in EEPROM whenever a digital output 
+ * changes or a servo, bounce or multi stops so it can be restored at power
+ * up. Saving each in its own EEPROM byte means a busy output rewrites the
+ * same byte thousands of times a day.
+ * 
+ * Instead the states are kept in RAM and the changes appended to a journal
+ * of JOURNAL_RECORDS records in EEPROM at EE_STATE_JOURNAL. Each record is:
+ * 
+ *  sequence number, one more than the previous record
+ *  IO
+ *  state
+ *  check, the complement of the other three XORed together
+ * 
+ * The records are written from the start of the journal and when it is 
+ * full it starts again from the start. Before record 0 is rewritten the 
+ * states are checkpointed to the EE_OP_STATE bytes, which is only done if
+ * they have changed. At power up the states are read from the checkpoint 
+ * and then the valid records from record 0 with consecutive sequence 
+ * numbers are applied in order.
+ * 
+ * A state is only written if it differs from the last one written for the
+ * IO, and only once that IO has been unchanged for JOURNAL_COMMIT_DELAY, so
+ * an output which changes back and forth quickly is written once it settles.
+ * 
+ * An EEPROM write takes about 4ms so only one byte is written per poll, 
+ * both for records and for the checkpoint. A record's sequence number is 
+ * written last so a record part written when the power fails either has a 
+ * bad check or doesn't follow on from the record before, and is ignored.
+ * The records aren't written while checkpointing so the journal still 
+ * holds every change since the last checkpoint if the power fails part way.
+ * 
+ * Each journal byte is written once per JOURNAL_RECORDS changes. A level
+ * crossing output changing 1000 times a day would use up the 100k write 
+ * endurance of a single byte in about 100 days but takes about 17 years 
+ * with the journal. tests/model_stateJournal.c simulates this and power 
+ * failures at every point of writing.
+ */
+
+#include "module.h"
+#include "romops.h"
+#include "TickTime.h"
+#include "stateJournal.h"
+
+#ifdef STATE_JOURNAL
+
+#define RECORD_SIZE             4
+#define JOURNAL_RECORDS         (JOURNAL_SIZE/RECORD_SIZE)  // must be less than 256
+#define JOURNAL_COMMIT_DELAY    ONE_SECOND
+
+#define RECORD_ADDRESS(r)       ((WORD)EE_STATE_JOURNAL + (WORD)(r)*RECORD_SIZE)
+#define RECORD_CHECK(seq, io, state)    ((BYTE)~((seq) ^ (io) ^ (state)))
+
+static BYTE state[NUM_IO];          // the current state of each output
+static BYTE written[NUM_IO];        // the state last written to EEPROM
+static WORD pending;                // bit set for each IO whose state is waiting to be written
+static TickValue changeTime[NUM_IO];    // when each IO's state last changed
+static BYTE nextRecord;             // where the next record is written
+static BYTE nextSequence;
+static BYTE recordByte;             // next byte of the record being written, RECORD_SIZE if none
+static BYTE recordIo;               // the IO of the record being written
+static BYTE recordValue;            // the state of the record being written
+static BYTE checkpointIo;           // next IO to checkpoint, NUM_IO if not checkpointing
+
+// forward declarations
+static BOOL readRecord(BYTE r, BYTE * seq, BYTE * io, BYTE * value);
+static void writeRecordByte(void);
+
+/**
+ * Recover the output states from the EEPROM. Called at the start of 
+ * initialisation before anything reads the output states.
+ */
+void stateJournalInit(void) {
+    BYTE io;
+    BYTE r;
+    BYTE seq;
+    BYTE value;
+    
+    for (io=0; io<NUM_IO; io++) {
+        state[io] = written[io] = ee_read((WORD)EE_OP_STATE+io);
+    }
+    pending = 0;
+    nextRecord = 0;
+    nextSequence = 0;
+    for (r=0; r<JOURNAL_RECORDS; r++) {
+        if ( ! readRecord(r, &seq, &io, &value)) break;
+        if ((r > 0) && (seq != nextSequence)) break;    // a record from before the last checkpoint
+        if (io < NUM_IO) {
+            state[io] = written[io] = value;
+        }
+        nextSequence = seq + 1;
+        nextRecord = r + 1;
+    }
+    if (nextRecord >= JOURNAL_RECORDS) {
+        nextRecord = 0;
+    }
+    recordByte = RECORD_SIZE;
+    // checkpoint before record 0 is written
+    checkpointIo = (nextRecord == 0) ? 0 : NUM_IO;
+}
+
+/**
+ * Get the current state of an output.
+ * @param io the IO
+ * @return the state as previously saved
+ */
+BYTE getOutputState(BYTE io) {
+    return state[io];
+}
+
+/**
+ * Save the state of an output. It is written to EEPROM later.
+ * @param io the IO
+ * @param value the state
+ */
+void saveOutputState(BYTE io, BYTE value) {
+    if (io >= NUM_IO) return;
+    state[io] = value;
+    if (value == written[io]) {
+        pending &= ~(1 << io);      // changed back before being written
+    } else {
+        pending |= (1 << io);
+        changeTime[io].Val = tickGet();
+    }
+}
+
+/**
+ * Write one EEPROM byte of a record of a state which has settled, or of the
+ * checkpoint. Called from the main loop.
+ */
+void pollStateJournal(void) {
+    BYTE io;
+    
+    if (recordByte < RECORD_SIZE) {
+        writeRecordByte();
+        return;
+    }
+    if (checkpointIo < NUM_IO) {
+        if (ee_read((WORD)EE_OP_STATE+checkpointIo) != written[checkpointIo]) {
+            ee_write((WORD)EE_OP_STATE+checkpointIo, written[checkpointIo]);
+        }
+        checkpointIo++;
+        return;
+    }
+    if (pending == 0) {
+        return;
+    }
+    for (io=0; io<NUM_IO; io++) {
+        if ((pending & (1 << io)) && (tickTimeSince(changeTime[io]) > JOURNAL_COMMIT_DELAY)) {
+            pending &= ~(1 << io);
+            recordIo = io;
+            recordValue = state[io];
+            recordByte = 0;
+            writeRecordByte();
+            return;
+        }
+    }
+}
+
+/**
+ * Read a record.
+ * @param r the record number
+ * @param seq where to put the sequence number
+ * @param io where to put the IO
+ * @param value where to put the state
+ * @return TRUE if the record is valid
+ */
+static BOOL readRecord(BYTE r, BYTE * seq, BYTE * io, BYTE * value) {
+    WORD address = RECORD_ADDRESS(r);
+    
+    *seq = ee_read(address);
+    *io = ee_read(address+1);
+    *value = ee_read(address+2);
+    return ee_read(address+3) == RECORD_CHECK(*seq, *io, *value);
+}
+
+/**
+ * Write the next byte of the record being appended. The sequence number is
+ * written last.
+ */
+static void writeRecordByte(void) {
+    WORD address;
+    
+    address = RECORD_ADDRESS(nextRecord);
+    switch (recordByte++) {
+        case 0:
+            ee_write(address+1, recordIo);
+            return;
+        case 1:
+            ee_write(address+2, recordValue);
+            return;
+        case 2:
+            ee_write(address+3, RECORD_CHECK(nextSequence, recordIo, recordValue));
+            return;
+    }
+    ee_write(address, nextSequence);
+    written[recordIo] = recordValue;
+    if (state[recordIo] != recordValue) {
+        pending |= (1 << recordIo);     // changed whilst being written
+    }
+    nextSequence++;
+    nextRecord++;
+    if (nextRecord >= JOURNAL_RECORDS) {
+        nextRecord = 0;
+        checkpointIo = 0;   // before the oldest records are overwritten
+    }
+}
+
+#endif
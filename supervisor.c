@@ -0,0 +1,157 @@
+/*
+ Routines for CBUS FLiM operations - part of CBUS libraries for PIC 18F
+  This work is licensed under the:
+      Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International License.
+   To view a copy of this license, visit:
+      http://creativecommons.org/licenses/by-nc-sa/4.0/
+   or send a letter to Creative Commons, PO Box 1866, Mountain View, CA 94042, USA.
+   License summary:
+    You are free to:
+      Share, copy and redistribute the material in any medium or format
+      Adapt, remix, transform, and build upon the material
+    The licensor cannot revoke these freedoms as long as you follow the license terms.
+    Attribution : You must give appropriate credit, provide a link to the license,
+                   and indicate if changes were made. You may do so in any reasonable manner,
+                   but not in any way that suggests the licensor endorses you or your use.
+    NonCommercial : You may not use the material for commercial purposes. **(see note below)
+    ShareAlike : If you remix, transform, or build upon the material, you must distribute
+                  your contributions under the same license as the original.
+    No additional restrictions : You may not apply legal terms or technological measures that
+                                  legally restrict others from doing anything the license permits.
+   ** For commercial use, please contact the original copyright holder(s) to agree licensing terms
+**************************************************************************************************************
+	The FLiM routines have no code or definitions that are specific to any
+	module, so they can be used to provide FLiM facilities for any module 
+	using these libraries.
+	
+*/ 
+/*
+ * File:   supervisor.c
+ *
+ * Created on 18 October 2026, 17:20
+ *
+ * The supervisor records the longest pass of the main loop and the number of
+ * passes which took longer than a servo slot. The slots missed by each 
+ * scheduled task are counted by the scheduler.
+ * 
+ * If WATCHDOG is defined in module.h the hardware watchdog is enabled once 
+ * the module has started. The watchdog is only cleared once both the servo 
+ * and the input scan tasks have run since it was last cleared, so a blocked
+ * subsystem stops it being cleared and the module resets. The watchdog period
+ * is set by WDTPS in hwsettings.c.
+ * 
+ * The SLEEP instruction used to idle also clears the watchdog, and a watchdog
+ * timeout whilst idle only wakes the processor, so a loop which keeps idling
+ * while a supervised task has stopped running would never be reset by the
+ * hardware. So before idling the loop calls supervisorIdle() which does a
+ * software reset if there hasn't been a complete check-in for CHECK_IN_TIMEOUT.
+ * SUPER_WDT_RESET only reports hardware watchdog resets.
+ */
+
+#include "devincs.h"
+#include "module.h"
+#include "TickTime.h"
+#include "scheduler.h"
+#include "supervisor.h"
+
+static WORD worstLoop;
+static WORD overruns;
+static BOOL wdtReset;
+#ifdef WATCHDOG
+static BYTE checkedIn;          // the tasks which have run since the watchdog was cleared
+static BYTE supervisedTasks;    // the tasks which must run before the watchdog is cleared
+static TickValue lastCheckIn;   // when the watchdog was last cleared
+#endif
+
+/**
+ * Clear the statistics and find out whether the watchdog caused the reset.
+ * Must be called before anything executes a CLRWDT or SLEEP.
+ */
+void initSupervisor(void) {
+    worstLoop = 0;
+    overruns = 0;
+    // TO is cleared by a watchdog timeout
+    wdtReset = ! RCONbits.TO;
+#ifdef WATCHDOG
+    checkedIn = 0;
+    supervisedTasks = 0;
+#endif
+}
+
+/**
+ * Start supervising. Called once the scheduled tasks have started.
+ */
+void supervisorStart(void) {
+#ifdef WATCHDOG
+    supervisedTasks = schedulerEnabledTasks() & ((1<<TASK_SERVO) | (1<<TASK_INPUTS));
+    schedulerTakeRunTasks();
+    checkedIn = 0;
+    lastCheckIn.Val = tickGet();
+    ClrWdt();
+    WDTCONbits.SWDTEN = 1;      // enable the watchdog
+#endif
+}
+
+/**
+ * Called after each working pass of the main loop.
+ * @param loopTicks the time taken by the pass
+ */
+void supervisorPoll(WORD loopTicks) {
+    if (loopTicks > worstLoop) {
+        worstLoop = loopTicks;
+    }
+    if ((loopTicks > 5*HALF_MILLI_SECOND) && (overruns != 0xFFFF)) {
+        overruns++;
+    }
+#ifdef WATCHDOG
+    checkedIn |= schedulerTakeRunTasks();
+    if ((supervisedTasks != 0) && ((checkedIn & supervisedTasks) == supervisedTasks)) {
+        ClrWdt();
+        checkedIn = 0;
+        lastCheckIn.Val = tickGet();
+    }
+#endif
+}
+
+/**
+ * Called by the main loop before it idles. Resets the module if the 
+ * supervised tasks haven't all run within CHECK_IN_TIMEOUT, as idling 
+ * clears the watchdog.
+ */
+void supervisorIdle(void) {
+#ifdef WATCHDOG
+    if ((supervisedTasks != 0) && (tickTimeSince(lastCheckIn) > CHECK_IN_TIMEOUT)) {
+        Reset();
+    }
+#endif
+}
+
+/**
+ * Get a DIAG_SUPERVISOR diagnostic.
+ * @param code the SUPER_xxx code
+ * @param value where to put the value
+ * @return TRUE if a valid code
+ */
+BOOL getSupervisorDiagnostic(BYTE code, WORD * value) {
+    switch (code) {
+        case SUPER_WORST_LOOP:
+            *value = worstLoop;
+            return TRUE;
+        case SUPER_OVERRUNS:
+            *value = overruns;
+            return TRUE;
+        case SUPER_MISSED_SERVO:
+            *value = schedulerMissed(TASK_SERVO);
+            return TRUE;
+        case SUPER_MISSED_INPUTS:
+            *value = schedulerMissed(TASK_INPUTS);
+            return TRUE;
+        case SUPER_MISSED_ACTIONS:
+            *value = schedulerMissed(TASK_ACTIONS);
+            return TRUE;
+        case SUPER_WDT_RESET:
+            *value = wdtReset;
+            return TRUE;
+    }
+    return FALSE;
+}
@@ -0,0 +1,68 @@
+/*
+ Routines for CBUS FLiM operations - part of CBUS libraries for PIC 18F
+  This work is licensed under the:
+      Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International License.
+   To view a copy of this license, visit:
+      http://creativecommons.org/licenses/by-nc-sa/4.0/
+   or send a letter to Creative Commons, PO Box 1866, Mountain View, CA 94042, USA.
+   License summary:
+    You are free to:
+      Share, copy and redistribute the material in any medium or format
+      Adapt, remix, transform, and build upon the material
+    The licensor cannot revoke these freedoms as long as you follow the license terms.
+    Attribution : You must give appropriate credit, provide a link to the license,
+                   and indicate if changes were made. You may do so in any reasonable manner,
+                   but not in any way that suggests the licensor endorses you or your use.
+    NonCommercial : You may not use the material for commercial purposes. **(see note below)
+    ShareAlike : If you remix, transform, or build upon the material, you must distribute
+                  your contributions under the same license as the original.
+    No additional restrictions : You may not apply legal terms or technological measures that
+                                  legally restrict others from doing anything the license permits.
+   ** For commercial use, please contact the original copyright holder(s) to agree licensing terms
+**************************************************************************************************************
+	The FLiM routines have no code or definitions that are specific to any
+	module, so they can be used to provide FLiM facilities for any module 
+	using these libraries.
+	
+*/ 
+/* 
+ * File:   supervisor.h
+ *
+ * Created on 18 October 2026, 17:20
+ *
+ * Watches the main loop for stalls and overruns and optionally uses the
+ * hardware watchdog to reset the module if it stops.
+ */
+
+#ifndef SUPERVISOR_H
+#define	SUPERVISOR_H
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+#include "GenericTypeDefs.h"
+
+/*
+ * Codes for the DIAG_SUPERVISOR diagnostic service
+ */
+#define SUPER_WORST_LOOP        1   // longest main loop pass in ticks
+#define SUPER_OVERRUNS          2   // main loop passes longer than a servo slot
+#define SUPER_MISSED_SERVO      3   // servo slots skipped
+#define SUPER_MISSED_INPUTS     4   // input scans skipped
+#define SUPER_MISSED_ACTIONS    5   // action polls skipped
+#define SUPER_WDT_RESET         6   // 1 if the last reset was caused by the watchdog
+
+#define CHECK_IN_TIMEOUT        (2*ONE_SECOND)  // same as the hardware watchdog period
+
+extern void initSupervisor(void);
+extern void supervisorStart(void);
+extern void supervisorPoll(WORD loopTicks);
+extern void supervisorIdle(void);
+extern BOOL getSupervisorDiagnostic(BYTE code, WORD * value);
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif	/* SUPERVISOR_H */
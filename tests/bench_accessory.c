@@ -0,0 +1,338 @@
+/*
+ Routines for CBUS FLiM operations - part of CBUS libraries for PIC 18F
+  This work is licensed under the:
+      Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International License.
+   To view a copy of this license, visit:
+      http://creativecommons.org/licenses/by-nc-sa/4.0/
+   or send a letter to Creative Commons, PO Box 1866, Mountain View, CA 94042, USA.
+   License summary:
+    You are free to:
+      Share, copy and redistribute the material in any medium or format
+      Adapt, remix, transform, and build upon the material
+    The licensor cannot revoke these freedoms as long as you follow the license terms.
+    Attribution : You must give appropriate credit, provide a link to the license,
+                   and indicate if changes were made. You may do so in any reasonable manner,
+                   but not in any way that suggests the licensor endorses you or your use.
+    NonCommercial : You may not use the material for commercial purposes. **(see note below)
+    ShareAlike : If you remix, transform, or build upon the material, you must distribute
+                  your contributions under the same license as the original.
+    No additional restrictions : You may not apply legal terms or technological measures that
+                                  legally restrict others from doing anything the license permits.
+   ** For commercial use, please contact the original copyright holder(s) to agree licensing terms
+**************************************************************************************************************
+	The FLiM routines have no code or definitions that are specific to any
+	module, so they can be used to provide FLiM facilities for any module 
+	using these libraries.
+	
+*/ 
+/*
+ * File:   bench_accessory.c
+ *
+ * Created on 23 October 2026, 10:40
+ *
+ * Host benchmark of receiveCBUS() for accessory events, from the frame being
+ * taken to processEvent() queueing its actions, before and after 
+ * FAST_ACCESSORY_PATH. The tick is too coarse to time this with 
+ * PROF_ACCESSORY so both paths are run on the host over the same frames:
+ * 
+ *  before: parseCBUSMsg(), modelled below as CBUSlib does it. The FLiM 
+ *      command parser is offered the frame first and doesn't handle it, then
+ *      the event parser looks it up with findEvent() in the chained hash 
+ *      table of HASH_LENGTH chains of up to CHAIN_LENGTH entries.
+ *  after: the fast path in receiveCBUS() which looks the event up with 
+ *      LOOKUP_EVENT(), the real eventFilter.c and eventIndex.c.
+ * 
+ * Both then call the same stand-in for processEvent(), which reads the 
+ * entry's EVs and queues an action. The event table reads (getNN(), getEN()
+ * and the EVs), which read flash on the PIC, are counted and the host time 
+ * per frame measured, separately for learned events and for events from 
+ * other modules. The CBUSlib model follows its getHash() and findEvent() 
+ * chain walk so it should be checked whenever CBUSlib is updated.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "devincs.h"
+#include "module.h"
+#include "events.h"
+#include "cbus.h"
+#include "FliM.h"
+#include "TickTime.h"
+#include "eventIndex.h"
+#include "eventFilter.h"
+
+#define STREAM_FRAMES       5000
+#define LEARNED_SHARE       20      // percent of the frames which are learned events
+#define TIMED_PASSES        200
+#define NUM_FLIM_OPCODES    (sizeof(flimOpcodes)/sizeof(flimOpcodes[0]))
+
+// as main.c
+#define IS_ACCESSORY_OPC(opc)   (((opc) & 0xF6) == OPC_ACON)
+#define ACCESSORY_SHORT_MASK    0x08
+
+BYTE flimState = fsFLiM;
+static Event table[NUM_EVENTS];
+static int tableSize;
+static BYTE chains[HASH_LENGTH][CHAIN_LENGTH];
+static BYTE frames[STREAM_FRAMES][5];
+static BOOL learned[STREAM_FRAMES];
+static long tableReads;
+static long actionsQueued;
+
+BOOL validStart(BYTE tableIndex) {
+    return tableIndex < tableSize;
+}
+
+WORD getNN(BYTE tableIndex) {
+    tableReads++;
+    return table[tableIndex].NN;
+}
+
+WORD getEN(BYTE tableIndex) {
+    tableReads++;
+    return table[tableIndex].EN;
+}
+
+BYTE getRange(BYTE range, WORD * nn, WORD * en) {
+    return 0;
+}
+
+BYTE rangeFind(WORD nn, WORD en) {
+    return eventIndexFind(nn, en);
+}
+
+DWORD tickGet(void) {
+    return 0;
+}
+
+DWORD tickTimeSince(TickValue t) {
+    return 0;
+}
+
+/*
+ * CBUSlib's chained hash table
+ */
+static BYTE getHash(WORD nn, WORD en) {
+    BYTE hash;
+    
+    hash = (BYTE)(nn ^ (nn >> 8));
+    hash = 7*hash + (BYTE)(en ^ (en >> 8));
+    return hash % HASH_LENGTH;
+}
+
+void rebuildHashtable(void) {
+    BYTE hash;
+    BYTE chainIdx;
+    int tableIndex;
+    
+    for (hash=0; hash<HASH_LENGTH; hash++) {
+        for (chainIdx=0; chainIdx<CHAIN_LENGTH; chainIdx++) {
+            chains[hash][chainIdx] = NO_INDEX;
+        }
+    }
+    for (tableIndex=0; tableIndex<tableSize; tableIndex++) {
+        hash = getHash(table[tableIndex].NN, table[tableIndex].EN);
+        for (chainIdx=0; chainIdx<CHAIN_LENGTH; chainIdx++) {
+            if (chains[hash][chainIdx] == NO_INDEX) {
+                chains[hash][chainIdx] = tableIndex;
+                break;
+            }
+        }
+    }
+}
+
+BYTE findEvent(WORD nn, WORD en) {
+    BYTE hash;
+    BYTE chainIdx;
+    BYTE tableIndex;
+    
+    hash = getHash(nn, en);
+    for (chainIdx=0; chainIdx<CHAIN_LENGTH; chainIdx++) {
+        tableIndex = chains[hash][chainIdx];
+        if (tableIndex == NO_INDEX) return NO_INDEX;
+        if ((getNN(tableIndex) == nn) && (getEN(tableIndex) == en)) return tableIndex;
+    }
+    return NO_INDEX;
+}
+
+/*
+ * The same processEvent() for both paths: read the EVs of the entry and 
+ * queue the first action.
+ */
+void processEvent(BYTE tableIndex, BYTE * msg) {
+    BYTE e;
+    
+    for (e=0; e<EVENT_TABLE_WIDTH; e++) {
+        tableReads++;
+    }
+    actionsQueued++;
+}
+
+/*
+ * The path before FAST_ACCESSORY_PATH, through parseCBUSMsg()
+ */
+static const BYTE flimOpcodes[] = {
+    OPC_NNLRN, OPC_NNULN, OPC_NNCLR, OPC_NERD, OPC_RQEVN, OPC_NVSET, OPC_EVLRN,
+    OPC_EVULN, OPC_REVAL, OPC_REQEV, OPC_NENRD, OPC_EVLRNI, 0x0D, 0x10, 0x11, 
+    0x42, 0x71, 0x73, 0x75, 0x5C, 0x5D
+};
+
+static BOOL parseFLiMCmd(BYTE * msg) {
+    BYTE i;
+    
+    // C18 compiles the FLiM parser's switch into a chain of compares
+    for (i=0; i<NUM_FLIM_OPCODES; i++) {
+        if (msg[d0] == flimOpcodes[i]) return TRUE;
+    }
+    return FALSE;
+}
+
+static BOOL parseCbusEvent(BYTE * msg) {
+    BYTE tableIndex;
+    
+    switch (msg[d0]) {
+        case OPC_ACON:
+        case OPC_ACOF:
+        case OPC_ASON:
+        case OPC_ASOF:
+            tableIndex = findEvent((msg[d0] & ACCESSORY_SHORT_MASK) ? 0 : ((WORD)msg[d1] << 8) | msg[d2], 
+                    ((WORD)msg[d3] << 8) | msg[d4]);
+            if (tableIndex != NO_INDEX) {
+                processEvent(tableIndex, msg);
+            }
+            return TRUE;
+    }
+    return FALSE;
+}
+
+static BOOL libraryPath(BYTE * msg) {
+    if (parseFLiMCmd(msg)) return TRUE;
+    return parseCbusEvent(msg);
+}
+
+/*
+ * The fast path in receiveCBUS()
+ */
+static BOOL fastPath(BYTE * msg) {
+    BYTE tableIndex;
+    
+    if (IS_ACCESSORY_OPC(msg[d0]) && (flimState == fsFLiM)) {
+        tableIndex = LOOKUP_EVENT((msg[d0] & ACCESSORY_SHORT_MASK) ? 0 : ((WORD)msg[d1] << 8) | msg[d2], 
+                ((WORD)msg[d3] << 8) | msg[d4]);
+        if (tableIndex != NO_INDEX) {
+            processEvent(tableIndex, msg);
+        }
+        return TRUE;
+    }
+    return libraryPath(msg);
+}
+
+/**
+ * Make a table of consecutive ENs from a few NNs, as a layout is usually 
+ * set up, and a stream of frames for it.
+ * @param size the number of events
+ */
+static void makeLayout(int size) {
+    int i;
+    int t;
+    WORD nn = 0;
+    WORD en = 0;
+    
+    tableSize = 0;
+    while (tableSize < size) {
+        if ((tableSize % 40) == 0) {
+            nn = 256 + rand() % 64;
+            en = rand() % 100;
+        }
+        en++;
+        if (findEvent(nn, en) != NO_INDEX) continue;
+        table[tableSize].NN = nn;
+        table[tableSize].EN = en;
+        tableSize++;
+        rebuildHashtable();
+    }
+    for (i=0; i<STREAM_FRAMES; i++) {
+        learned[i] = (rand() % 100) < LEARNED_SHARE;
+        if (learned[i]) {
+            t = rand() % tableSize;
+            nn = table[t].NN;
+            en = table[t].EN;
+        } else {
+            do {
+                nn = 256 + rand() % 64;
+                en = 1 + rand() % 400;
+            } while (findEvent(nn, en) != NO_INDEX);
+        }
+        frames[i][d0] = (rand() & 1) ? OPC_ACON : OPC_ACOF;
+        frames[i][d1] = nn >> 8;
+        frames[i][d2] = nn & 0xFF;
+        frames[i][d3] = en >> 8;
+        frames[i][d4] = en & 0xFF;
+    }
+}
+
+/**
+ * Run one path over the frames of one kind.
+ * @param fast TRUE for the fast path
+ * @param wantLearned which frames to take
+ * @param reads where to put the event table reads per frame
+ * @return the host time per frame in ns
+ */
+static double runPath(BOOL fast, BOOL wantLearned, double * reads) {
+    clock_t start;
+    int pass;
+    int i;
+    long n = 0;
+    
+    tableReads = 0;
+    start = clock();
+    for (pass=0; pass<TIMED_PASSES; pass++) {
+        for (i=0; i<STREAM_FRAMES; i++) {
+            if (learned[i] != wantLearned) continue;
+            if (fast) {
+                fastPath(frames[i]);
+            } else {
+                libraryPath(frames[i]);
+            }
+            n++;
+        }
+    }
+    *reads = (double)tableReads / n;
+    return 1e9 * (clock() - start) / CLOCKS_PER_SEC / n;
+}
+
+int main(void) {
+    static const int sizes[] = {50, 128, 255};
+    BYTE s;
+    BYTE kind;
+    double readsBefore;
+    double readsAfter;
+    double nsBefore;
+    double nsAfter;
+    long queued;
+    
+    srand(7);
+    printf("events  frames         before            after\n");
+    printf("                    reads     ns     reads     ns\n");
+    for (s=0; s<sizeof(sizes)/sizeof(sizes[0]); s++) {
+        makeLayout(sizes[s]);
+        eventIndexInit();
+        eventFilterInit();
+        for (kind=0; kind<2; kind++) {
+            actionsQueued = 0;
+            nsBefore = runPath(FALSE, kind == 0, &readsBefore);
+            queued = actionsQueued;
+            actionsQueued = 0;
+            nsAfter = runPath(TRUE, kind == 0, &readsAfter);
+            if (actionsQueued != queued) {
+                printf("FAIL the paths queued %ld and %ld actions\n", queued, actionsQueued);
+                return 1;
+            }
+            printf("%6d  %-8s  %7.2f %6.1f   %7.2f %6.1f\n", sizes[s], 
+                    (kind == 0) ? "learned" : "other", 
+                    readsBefore, nsBefore, readsAfter, nsAfter);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,199 @@
+/*
+ Routines for CBUS FLiM operations - part of CBUS libraries for PIC 18F
+  This work is licensed under the:
+      Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International License.
+   To view a copy of this license, visit:
+      http://creativecommons.org/licenses/by-nc-sa/4.0/
+   or send a letter to Creative Commons, PO Box 1866, Mountain View, CA 94042, USA.
+   License summary:
+    You are free to:
+      Share, copy and redistribute the material in any medium or format
+      Adapt, remix, transform, and build upon the material
+    The licensor cannot revoke these freedoms as long as you follow the license terms.
+    Attribution : You must give appropriate credit, provide a link to the license,
+                   and indicate if changes were made. You may do so in any reasonable manner,
+                   but not in any way that suggests the licensor endorses you or your use.
+    NonCommercial : You may not use the material for commercial purposes. **(see note below)
+    ShareAlike : If you remix, transform, or build upon the material, you must distribute
+                  your contributions under the same license as the original.
+    No additional restrictions : You may not apply legal terms or technological measures that
+                                  legally restrict others from doing anything the license permits.
+   ** For commercial use, please contact the original copyright holder(s) to agree licensing terms
+**************************************************************************************************************
+	The FLiM routines have no code or definitions that are specific to any
+	module, so they can be used to provide FLiM facilities for any module 
+	using these libraries.
+	
+*/ 
+/*
+ * File:   bench_canRx.c
+ *
+ * Created on 19 October 2026, 12:20
+ *
+ * Host benchmark of canRx.c. A burst of BURST_FRAMES back to back frames, 
+ * such as another node's SOD, arrives while the servo task runs every 2.5ms.
+ * The main loop is modelled with the costs below. Each loop pass which 
+ * handles CAN work also pays for the polls after checkCBUS. The real 
+ * checkCBUS() is compared with handling one frame per pass, as before 
+ * CAN_RX_BUDGET.
+ * 
+ * The receive path holds RX_HOLD frames, the ECAN buffers plus the CBUSlib 
+ * receive FIFO. Frames arriving when it is full are lost and set RXBnOVFL.
+ * Results are given for a few sizes as the FIFO size depends on CBUSlib.
+ * 
+ * The costs are estimates in 16us ticks, not measurements. Use DIAG_PROFILE 
+ * on a real node to get them.
+ */
+
+#include <stdio.h>
+#include "devincs.h"
+#include "module.h"
+#include "TickTime.h"
+#include "scheduler.h"
+#include "diagnostics.h"
+#include "canRx.h"
+
+#define BURST_FRAMES        200
+#define FRAME_TICKS         48      // an ACON with 4 data bytes at 125kbit/s with some stuffing, 768us
+#define RECEIVE_TICKS       20      // taking a learned event and queueing its actions, 320us
+#define POLL_TICKS          40      // the polls after checkCBUS on each pass, 640us
+#define SERVO_TICKS         10      // starting a block of servo pulses, 160us
+#define SERVO_PERIOD        (5*HALF_MILLI_SECOND)
+
+#define STRATEGY_SINGLE     0       // one frame per pass
+#define STRATEGY_BUDGET     1       // checkCBUS()
+
+static DWORD now;
+static DWORD burstStart;
+static int arrived;             // frames of the burst which have reached the module
+static int held;                // frames waiting in the receive path
+static int holdSize;
+static int lost;
+static int received;
+static DWORD worstServoLate;
+static DWORD lastServo;
+
+DWORD tickGet(void) {
+    return now;
+}
+
+DWORD tickTimeSince(TickValue t) {
+    return tickGet() - t.Val;
+}
+
+void traceFreeze(BYTE reason) {
+}
+
+WORD getCanFilterState(void) {
+    return 0;
+}
+
+WORD getCanFilterFailures(void) {
+    return 0;
+}
+
+/**
+ * Put the frames which have arrived by now into the receive path.
+ */
+static void arrive(void) {
+    while ((arrived < BURST_FRAMES) && ((DWORD)(now - burstStart) >= (DWORD)arrived * FRAME_TICKS)) {
+        arrived++;
+        if (held < holdSize) {
+            held++;
+        } else {
+            lost++;
+            COMSTAT |= 0x40;
+        }
+    }
+}
+
+/**
+ * Take one frame from the receive path and handle it.
+ * @return TRUE if there was a frame
+ */
+BOOL receiveCBUS(void) {
+    arrive();
+    if (held == 0) return FALSE;
+    held--;
+    received++;
+    now += RECEIVE_TICKS;
+    return TRUE;
+}
+
+/**
+ * The servo task. Records how long after its slot it started.
+ */
+static void servoTask(void) {
+    DWORD late = (DWORD)(now - burstStart) % SERVO_PERIOD;
+    
+    if (late > worstServoLate) worstServoLate = late;
+    lastServo = now;
+    now += SERVO_TICKS;
+}
+
+/**
+ * Run the main loop over a burst.
+ * @param strategy STRATEGY_xxx
+ * @param hold frames the receive path holds
+ */
+static void burst(BYTE strategy, int hold) {
+    BOOL more = FALSE;
+    DWORD drained = 0;
+    WORD backlog;
+    WORD exhausted;
+    WORD overflows;
+    
+    now = 1000;
+    burstStart = now;
+    arrived = 0;
+    held = 0;
+    holdSize = hold;
+    lost = 0;
+    received = 0;
+    worstServoLate = 0;
+    COMSTAT = 0;
+    canRxInit();
+    schedulerSetTask(TASK_SERVO, servoTask, SERVO_PERIOD, 0);
+    schedulerStartTask(TASK_SERVO, now);
+    while ((arrived < BURST_FRAMES) || (held > 0) || more) {
+        arrive();
+        if ((held > 0) || more) {
+            if (strategy == STRATEGY_SINGLE) {
+                more = receiveCBUS();
+            } else {
+                more = checkCBUS();
+            }
+            now += POLL_TICKS;
+            drained = now;
+        } else {
+            now++;      // asleep until the next interrupt
+        }
+        schedulerRun(now);
+    }
+    if (strategy == STRATEGY_SINGLE) {
+        printf("one frame per pass   %5d  %5d  %8lu       -       -  %8lu  %6u\n", hold, lost,
+                (unsigned long)((drained - burstStart) * 16 / 1000), 
+                (unsigned long)(worstServoLate * 16), schedulerMissed(TASK_SERVO));
+    } else {
+        getCanDiagnostic(CAN_MAX_BACKLOG, &backlog);
+        getCanDiagnostic(CAN_BUDGET_EXHAUSTED, &exhausted);
+        getCanDiagnostic(CAN_RX_OVERFLOWS, &overflows);
+        printf("checkCBUS budget %2d  %5d  %5d  %8lu  %6u  %6u  %8lu  %6u\n", CAN_RX_BUDGET, hold, lost,
+                (unsigned long)((drained - burstStart) * 16 / 1000), backlog, exhausted,
+                (unsigned long)(worstServoLate * 16), schedulerMissed(TASK_SERVO));
+    }
+}
+
+int main(void) {
+    static const int holds[] = {4, 8, 16, 32};
+    BYTE h;
+    
+    printf("%d frame burst, %dus per frame on the bus, %dus to handle a frame, %dus of polls per pass\n",
+            BURST_FRAMES, FRAME_TICKS*16, RECEIVE_TICKS*16, POLL_TICKS*16);
+    printf("                      hold   lost  drain ms  backlog exhausted  servo late us  missed\n");
+    for (h=0; h<sizeof(holds)/sizeof(holds[0]); h++) {
+        burst(STRATEGY_SINGLE, holds[h]);
+        burst(STRATEGY_BUDGET, holds[h]);
+    }
+    return 0;
+}
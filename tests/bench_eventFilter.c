@@ -0,0 +1,297 @@
+/*
+ Routines for CBUS FLiM operations - part of CBUS libraries for PIC 18F
+  This work is licensed under the:
+      Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International License.
+   To view a copy of this license, visit:
+      http://creativecommons.org/licenses/by-nc-sa/4.0/
+   or send a letter to Creative Commons, PO Box 1866, Mountain View, CA 94042, USA.
+   License summary:
+    You are free to:
+      Share, copy and redistribute the material in any medium or format
+      Adapt, remix, transform, and build upon the material
+    The licensor cannot revoke these freedoms as long as you follow the license terms.
+    Attribution : You must give appropriate credit, provide a link to the license,
+                   and indicate if changes were made. You may do so in any reasonable manner,
+                   but not in any way that suggests the licensor endorses you or your use.
+    NonCommercial : You may not use the material for commercial purposes. **(see note below)
+    ShareAlike : If you remix, transform, or build upon the material, you must distribute
+                  your contributions under the same license as the original.
+    No additional restrictions : You may not apply legal terms or technological measures that
+                                  legally restrict others from doing anything the license permits.
+   ** For commercial use, please contact the original copyright holder(s) to agree licensing terms
+**************************************************************************************************************
+	The FLiM routines have no code or definitions that are specific to any
+	module, so they can be used to provide FLiM facilities for any module 
+	using these libraries.
+	
+*/ 
+/*
+ * File:   bench_eventFilter.c
+ *
+ * Created on 19 October 2026, 13:30
+ *
+ * Host benchmark of eventFilter.c. For event tables of different sizes and
+ * shapes the filter is built and a stream of events which are not learned,
+ * as from other modules, is looked up. The fraction which pass the filter 
+ * and still have to be looked up is reported from the DIAG_EVENT_FILTER 
+ * counters, with the (1-e^(-kn/m))^k expected of an ideal Bloom filter of 
+ * m bits and k hashes holding n events. Every learned event must still be
+ * found.
+ * 
+ * The work for each foreign event is then reported with and without the 
+ * filter, looking up through eventIndex.c as the module does: the hashes 
+ * worked out, the event table reads (getNN() and getEN(), which read flash)
+ * and the host time per event. Without the filter a miss costs one index
+ * hash and a table read whenever its slot is in use, which is n/256 of the
+ * time. The filter replaces that with its own hash for the events it 
+ * rejects, so it saves the table reads but adds a hash for every event which
+ * passes. It pays off while a table read costs more than the extra hashes
+ * per table read saved, the "even at" column.
+ * 
+ * One case has a range entry of RANGE_SIZE events besides the table.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <time.h>
+#include "devincs.h"
+#include "module.h"
+#include "events.h"
+#include "TickTime.h"
+#include "eventIndex.h"
+#include "eventFilter.h"
+
+#define FILTER_BITS         512     // as eventFilter.c
+#define FILTER_HASHES       3
+#define FOREIGN_EVENTS      20000
+#define TRIALS              20
+#define RANGE_SIZE          32
+#define TIMED_PASSES        10      // passes over the foreign events when timing
+
+#define SHAPE_RANDOM        0   // random NN and EN
+#define SHAPE_LAYOUT        1   // consecutive ENs from a few NNs, as a layout is usually set up
+#define NUM_SHAPES          2
+
+static const char * shapeNames[NUM_SHAPES] = {"random", "layout"};
+
+static Event table[NUM_EVENTS];
+static int tableSize;
+static WORD rangeNN;
+static WORD rangeEN;
+static BYTE rangeCount;
+static WORD foreignNN[FOREIGN_EVENTS];
+static WORD foreignEN[FOREIGN_EVENTS];
+static long tableReads;
+static long indexLookups;
+
+BOOL validStart(BYTE tableIndex) {
+    return tableIndex < tableSize;
+}
+
+WORD getNN(BYTE tableIndex) {
+    tableReads++;
+    return table[tableIndex].NN;
+}
+
+WORD getEN(BYTE tableIndex) {
+    tableReads++;
+    return table[tableIndex].EN;
+}
+
+BYTE findEvent(WORD nn, WORD en) {
+    int i;
+    
+    for (i=0; i<tableSize; i++) {
+        if ((table[i].NN == nn) && (table[i].EN == en)) return i;
+    }
+    return NO_INDEX;
+}
+
+BYTE getRange(BYTE range, WORD * nn, WORD * en) {
+    if (range != 0) return 0;
+    *nn = rangeNN;
+    *en = rangeEN;
+    return rangeCount;
+}
+
+BYTE rangeFind(WORD nn, WORD en) {
+    BYTE tableIndex;
+    
+    indexLookups++;
+    tableIndex = eventIndexFind(nn, en);
+    if (tableIndex != NO_INDEX) return tableIndex;
+    if (rangeCount && (nn == rangeNN) && (en >= rangeEN) && (en < rangeEN + rangeCount)) {
+        return 0;
+    }
+    return NO_INDEX;
+}
+
+DWORD tickGet(void) {
+    return 0;
+}
+
+DWORD tickTimeSince(TickValue t) {
+    return 0;
+}
+
+/**
+ * Make an event table. An event is only learned once.
+ * @param shape SHAPE_xxx
+ * @param size the number of events
+ */
+static void makeTable(BYTE shape, int size) {
+    WORD nn = 0;
+    WORD en = 0;
+    
+    tableSize = 0;
+    while (tableSize < size) {
+        if (shape == SHAPE_RANDOM) {
+            nn = rand() & 0xFFFF;
+            en = rand() & 0xFFFF;
+        } else {
+            if ((tableSize % 40) == 0) {
+                nn = 1 + rand() % 500;
+                en = 1 + rand() % 100;
+            }
+            en++;
+        }
+        if (findEvent(nn, en) != NO_INDEX) continue;
+        table[tableSize].NN = nn;
+        table[tableSize].EN = en;
+        tableSize++;
+    }
+}
+
+/**
+ * Make an event which is not learned, like the learned ones.
+ * @param shape SHAPE_xxx
+ * @param nn where to put the node number
+ * @param en where to put the event number
+ */
+static void foreignEvent(BYTE shape, WORD * nn, WORD * en) {
+    do {
+        if (shape == SHAPE_RANDOM) {
+            *nn = rand() & 0xFFFF;
+            *en = rand() & 0xFFFF;
+        } else {
+            *nn = 1 + rand() % 500;
+            *en = 1 + rand() % 400;
+        }
+    } while (findEvent(*nn, *en) != NO_INDEX || 
+            (rangeCount && (*nn == rangeNN) && (*en >= rangeEN) && (*en < rangeEN + rangeCount)));
+}
+
+/**
+ * Time looking up all the foreign events.
+ * @param filtered TRUE to look up through the filter
+ * @return the host time per event in ns
+ */
+static double timeLookups(BOOL filtered) {
+    clock_t start;
+    int pass;
+    int i;
+    
+    start = clock();
+    for (pass=0; pass<TIMED_PASSES; pass++) {
+        for (i=0; i<FOREIGN_EVENTS; i++) {
+            if (filtered) {
+                eventFilterFind(foreignNN[i], foreignEN[i]);
+            } else {
+                rangeFind(foreignNN[i], foreignEN[i]);
+            }
+        }
+    }
+    return 1e9 * (clock() - start) / CLOCKS_PER_SEC / ((double)TIMED_PASSES * FOREIGN_EVENTS);
+}
+
+/**
+ * Build the filter for tables of one size and shape and look up foreign
+ * events.
+ * @param shape SHAPE_xxx
+ * @param size the number of events
+ * @param range the events in a range entry
+ * @return the number of learned events not found
+ */
+static int bench(BYTE shape, int size, BYTE range) {
+    int trial;
+    int i;
+    WORD passed;
+    WORD falsePositives;
+    long totalPassed = 0;
+    long readsWithout = 0;
+    long readsWith = 0;
+    long hashesWith = 0;
+    double nsWithout = 0;
+    double nsWith = 0;
+    int missed = 0;
+    int n = size + (range ? range-1 : 0);
+    
+    for (trial=0; trial<TRIALS; trial++) {
+        makeTable(shape, size);
+        rangeNN = 600;
+        rangeEN = 1;
+        rangeCount = range;
+        eventIndexInit();
+        eventFilterInit();
+        for (i=0; i<size; i++) {
+            if (eventFilterFind(table[i].NN, table[i].EN) == NO_INDEX) missed++;
+        }
+        for (i=1; i<range; i++) {
+            if (eventFilterFind(rangeNN, rangeEN+i) == NO_INDEX) missed++;
+        }
+        eventFilterInit();      // clear the counters
+        for (i=0; i<FOREIGN_EVENTS; i++) {
+            foreignEvent(shape, &foreignNN[i], &foreignEN[i]);
+        }
+        tableReads = 0;
+        for (i=0; i<FOREIGN_EVENTS; i++) {
+            if (rangeFind(foreignNN[i], foreignEN[i]) != NO_INDEX) missed++;
+        }
+        readsWithout += tableReads;
+        tableReads = 0;
+        indexLookups = 0;
+        for (i=0; i<FOREIGN_EVENTS; i++) {
+            eventFilterFind(foreignNN[i], foreignEN[i]);
+        }
+        readsWith += tableReads;
+        hashesWith += FOREIGN_EVENTS + indexLookups;
+        getEventFilterDiagnostic(EVENT_FILTER_PASSED, &passed);
+        getEventFilterDiagnostic(EVENT_FILTER_FALSE, &falsePositives);
+        if (passed != falsePositives) missed++;
+        totalPassed += passed;
+        nsWithout += timeLookups(FALSE);
+        nsWith += timeLookups(TRUE);
+    }
+    printf("%-8s %6d %6d %8.1f%% %8.1f%%    1.00  %5.3f  %5.1f    %5.2f  %5.3f  %5.1f   %5.2f\n", 
+            shapeNames[shape], size, range, 
+            100.0 * totalPassed / ((double)TRIALS * FOREIGN_EVENTS),
+            100.0 * pow(1 - exp(-(double)FILTER_HASHES * n / FILTER_BITS), FILTER_HASHES),
+            (double)readsWithout / ((double)TRIALS * FOREIGN_EVENTS), nsWithout / TRIALS,
+            (double)hashesWith / ((double)TRIALS * FOREIGN_EVENTS),
+            (double)readsWith / ((double)TRIALS * FOREIGN_EVENTS), nsWith / TRIALS,
+            (double)(hashesWith - (long)TRIALS * FOREIGN_EVENTS) / (readsWithout - readsWith));
+    return missed;
+}
+
+int main(void) {
+    static const int sizes[] = {10, 25, 50, 100, 150, 200, 255};
+    BYTE shape;
+    BYTE s;
+    int missed = 0;
+    
+    srand(19);
+    printf("                                           without filter         with filter      even at\n");
+    printf("shape    events  range   passed    ideal  hashes  reads     ns   hashes  reads     ns  hash/read\n");
+    for (shape=0; shape<NUM_SHAPES; shape++) {
+        for (s=0; s<sizeof(sizes)/sizeof(sizes[0]); s++) {
+            missed += bench(shape, sizes[s], 0);
+        }
+    }
+    missed += bench(SHAPE_LAYOUT, 50, RANGE_SIZE);
+    if (missed) {
+        printf("FAIL %d learned events not found\n", missed);
+        return 1;
+    }
+    return 0;
+}
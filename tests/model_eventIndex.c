@@ -0,0 +1,258 @@
+/*
+ Routines for CBUS FLiM operations - part of CBUS libraries for PIC 18F
+  This work is licensed under the:
+      Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International License.
+   To view a copy of this license, visit:
+      http://creativecommons.org/licenses/by-nc-sa/4.0/
+   or send a letter to Creative Commons, PO Box 1866, Mountain View, CA 94042, USA.
+   License summary:
+    You are free to:
+      Share, copy and redistribute the material in any medium or format
+      Adapt, remix, transform, and build upon the material
+    The licensor cannot revoke these freedoms as long as you follow the license terms.
+    Attribution : You must give appropriate credit, provide a link to the license,
+                   and indicate if changes were made. You may do so in any reasonable manner,
+                   but not in any way that suggests the licensor endorses you or your use.
+    NonCommercial : You may not use the material for commercial purposes. **(see note below)
+    ShareAlike : If you remix, transform, or build upon the material, you must distribute
+                  your contributions under the same license as the original.
+    No additional restrictions : You may not apply legal terms or technological measures that
+                                  legally restrict others from doing anything the license permits.
+   ** For commercial use, please contact the original copyright holder(s) to agree licensing terms
+**************************************************************************************************************
+	The FLiM routines have no code or definitions that are specific to any
+	module, so they can be used to provide FLiM facilities for any module 
+	using these libraries.
+	
+*/ 
+/*
+ * File:   model_eventIndex.c
+ *
+ * Created on 18 October 2026, 11:30
+ *
+ * Host model of eventIndex.c. Builds the perfect hash index for many event
+ * tables of different shapes and sizes and reports how often each seed was
+ * needed and how often no seed worked. Every event must be found and events
+ * not in the table must not be. It also checks that a rebuild done a slice
+ * at a time from pollEventIndex() gives a working index and that lookups 
+ * made before it has finished fall back to findEvent(). A table with the 
+ * same event twice can't be placed by any seed and must leave the lookups 
+ * falling back rather than using the index of the previous table.
+ * 
+ * For the sliced rebuild each event table entry read is taken to cost one
+ * tick (16us), about what reading and hashing an entry takes on the PIC.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "devincs.h"
+#include "module.h"
+#include "events.h"
+#include "TickTime.h"
+#include "eventIndex.h"
+#include "test.h"
+
+#define TRIALS      300
+
+#define SHAPE_RANDOM        0   // random NN and EN
+#define SHAPE_CONSECUTIVE   1   // consecutive ENs from up to 300 NNs
+#define SHAPE_FEW_NNS       2   // random ENs from 3 NNs and short events
+#define NUM_SHAPES          3
+
+static const char * shapeNames[NUM_SHAPES] = {"random", "consecutive", "few NNs"};
+
+static Event table[NUM_EVENTS];
+static BYTE tableSize;
+static DWORD now;
+static DWORD reads;
+
+BOOL validStart(BYTE tableIndex) {
+    return tableIndex < tableSize;
+}
+
+WORD getNN(BYTE tableIndex) {
+    now++;
+    reads++;
+    return table[tableIndex].NN;
+}
+
+WORD getEN(BYTE tableIndex) {
+    return table[tableIndex].EN;
+}
+
+BYTE findEvent(WORD nn, WORD en) {
+    BYTE i;
+    
+    for (i=0; i<tableSize; i++) {
+        if ((table[i].NN == nn) && (table[i].EN == en)) return i;
+    }
+    return NO_INDEX;
+}
+
+DWORD tickGet(void) {
+    return now;
+}
+
+DWORD tickTimeSince(TickValue t) {
+    return tickGet() - t.Val;
+}
+
+static BOOL inTable(WORD nn, WORD en) {
+    BYTE i;
+    
+    for (i=0; i<tableSize; i++) {
+        if ((table[i].NN == nn) && (table[i].EN == en)) return TRUE;
+    }
+    return FALSE;
+}
+
+static void makeTable(BYTE shape, BYTE size) {
+    static const WORD fewNNs[] = {101, 102, 103, 0};
+    WORD nn;
+    WORD en;
+    
+    tableSize = 0;
+    while (tableSize < size) {
+        switch (shape) {
+            case SHAPE_RANDOM:
+                nn = 1 + rand() % 65535;
+                en = 1 + rand() % 65535;
+                break;
+            case SHAPE_CONSECUTIVE:
+                nn = 1 + rand() % 300;
+                en = 1 + tableSize;
+                break;
+            default:
+                nn = fewNNs[rand() % 4];
+                en = 1 + rand() % 400;
+                break;
+        }
+        if (inTable(nn, en)) continue;
+        table[tableSize].NN = nn;
+        table[tableSize].EN = en;
+        tableSize++;
+    }
+}
+
+/**
+ * Check every event is found and some which aren't there are not.
+ */
+static BOOL lookupsCorrect(void) {
+    BYTE i;
+    WORD nn;
+    WORD en;
+    
+    for (i=0; i<tableSize; i++) {
+        if (eventIndexFind(table[i].NN, table[i].EN) != i) return FALSE;
+    }
+    for (i=0; i<200; i++) {
+        nn = rand() % 400;
+        en = rand() % 500;
+        if ( ! inTable(nn, en) && (eventIndexFind(nn, en) != NO_INDEX)) return FALSE;
+    }
+    return TRUE;
+}
+
+static void modelBuild(void) {
+    static const BYTE sizes[] = {64, 128, 255};
+    BYTE shape;
+    BYTE s;
+    int t;
+    WORD seed;
+    int seeds[5];
+    int wrong;
+    
+    printf("%-12s %6s %8s %8s %8s %8s %8s\n", "shape", "events", "seed 0", "seed 1", "seed 2", "seed 3", "failed");
+    for (shape=0; shape<NUM_SHAPES; shape++) {
+        for (s=0; s<sizeof(sizes); s++) {
+            for (t=0; t<5; t++) seeds[t] = 0;
+            wrong = 0;
+            for (t=0; t<TRIALS; t++) {
+                makeTable(shape, sizes[s]);
+                eventIndexInit();
+                getEventIndexDiagnostic(EVENT_INDEX_SEED, &seed);
+                seeds[(seed == 0xFFFF) ? 4 : seed]++;
+                if ( ! lookupsCorrect()) wrong++;
+            }
+            printf("%-12s %6d %8d %8d %8d %8d %8d\n", shapeNames[shape], sizes[s], 
+                    seeds[0], seeds[1], seeds[2], seeds[3], seeds[4]);
+            CHECK("lookups correct", wrong == 0);
+            CHECK("index built", seeds[4] <= TRIALS/100);
+        }
+    }
+}
+
+static void modelSlicedRebuild(void) {
+    WORD fallbacks;
+    WORD before;
+    int polls;
+    DWORD maxReads;
+    DWORD totalReads;
+    
+    makeTable(SHAPE_RANDOM, 200);
+    eventIndexInit();
+    makeTable(SHAPE_CONSECUTIVE, 255);
+    eventIndexChanged();
+    getEventIndexDiagnostic(EVENT_INDEX_FALLBACKS, &before);
+    CHECK("sliced: found while changed", eventIndexFind(table[10].NN, table[10].EN) == 10);
+    getEventIndexDiagnostic(EVENT_INDEX_FALLBACKS, &fallbacks);
+    CHECK("sliced: fallback counted", fallbacks == before + 1);
+    now += 2*ONE_SECOND;
+    maxReads = 0;
+    totalReads = 0;
+    for (polls=0; polls<100000; polls++) {
+        reads = 0;
+        pollEventIndex();
+        totalReads += reads;
+        if (reads > maxReads) maxReads = reads;
+        getEventIndexDiagnostic(EVENT_INDEX_SEED, &fallbacks);
+        if (fallbacks != 0xFFFF) break;
+    }
+    printf("sliced rebuild of 255 events: %d polls, %lu entries read, at most %lu in one poll\n", 
+            polls + 1, (unsigned long)totalReads, (unsigned long)maxReads);
+    CHECK("sliced: each poll limited", maxReads <= ONE_MILI_SECOND + 32);
+    CHECK("sliced: took more than one poll", polls > 0);
+    getEventIndexDiagnostic(EVENT_INDEX_FALLBACKS, &before);
+    CHECK("sliced: lookups correct", lookupsCorrect());
+    getEventIndexDiagnostic(EVENT_INDEX_FALLBACKS, &fallbacks);
+    CHECK("sliced: no fallbacks once built", fallbacks == before);
+}
+
+static void modelDuplicateEvent(void) {
+    WORD seed;
+    WORD failures;
+    BYTE i;
+    BOOL found;
+    int polls;
+    
+    makeTable(SHAPE_RANDOM, 200);
+    eventIndexInit();
+    makeTable(SHAPE_CONSECUTIVE, 100);
+    table[99] = table[50];
+    eventIndexInit();
+    getEventIndexDiagnostic(EVENT_INDEX_SEED, &seed);
+    CHECK("duplicate: no seed works", seed == 0xFFFF);
+    found = TRUE;
+    for (i=0; i<tableSize; i++) {
+        if (eventIndexFind(table[i].NN, table[i].EN) != findEvent(table[i].NN, table[i].EN)) found = FALSE;
+    }
+    CHECK("duplicate: lookups fall back", found);
+    getEventIndexDiagnostic(EVENT_INDEX_FAILURES, &failures);
+    eventIndexChanged();
+    now += 2*ONE_SECOND;
+    for (polls=0; polls<100000; polls++) {
+        pollEventIndex();
+        getEventIndexDiagnostic(EVENT_INDEX_FAILURES, &seed);
+        if (seed != failures) break;
+    }
+    CHECK("duplicate: sliced rebuild fails", seed == failures + 1);
+    CHECK("duplicate: sliced rebuild took more than one poll", polls > 0);
+}
+
+int main(void) {
+    srand(1);
+    modelBuild();
+    modelSlicedRebuild();
+    modelDuplicateEvent();
+    return testResult("eventIndex");
+}
@@ -0,0 +1,238 @@
+/*
+ Routines for CBUS FLiM operations - part of CBUS libraries for PIC 18F
+  This work is licensed under the:
+      Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International License.
+   To view a copy of this license, visit:
+      http://creativecommons.org/licenses/by-nc-sa/4.0/
+   or send a letter to Creative Commons, PO Box 1866, Mountain View, CA 94042, USA.
+   License summary:
+    You are free to:
+      Share, copy and redistribute the material in any medium or format
+      Adapt, remix, transform, and build upon the material
+    The licensor cannot revoke these freedoms as long as you follow the license terms.
+    Attribution : You must give appropriate credit, provide a link to the license,
+                   and indicate if changes were made. You may do so in any reasonable manner,
+                   but not in any way that suggests the licensor endorses you or your use.
+    NonCommercial : You may not use the material for commercial purposes. **(see note below)
+    ShareAlike : If you remix, transform, or build upon the material, you must distribute
+                  your contributions under the same license as the original.
+    No additional restrictions : You may not apply legal terms or technological measures that
+                                  legally restrict others from doing anything the license permits.
+   ** For commercial use, please contact the original copyright holder(s) to agree licensing terms
+**************************************************************************************************************
+	The FLiM routines have no code or definitions that are specific to any
+	module, so they can be used to provide FLiM facilities for any module 
+	using these libraries.
+	
+*/ 
+/*
+ * File:   model_stateJournal.c
+ *
+ * Created on 18 October 2026, 13:10
+ *
+ * Host simulation of stateJournal.c on a simulated EEPROM.
+ * 
+ * Lifetime: a level crossing output changing LC_CHANGES_PER_DAY times a day
+ * and a few other outputs changing now and then are simulated for SIM_DAYS
+ * days. The most written EEPROM byte gives the expected life for an 
+ * endurance of EE_ENDURANCE writes, compared with saving each state in its
+ * own byte.
+ * 
+ * Power failures: the power fails after a random poll, which is at every 
+ * possible point of writing a record or the checkpoint as each poll writes 
+ * at most one byte. The states recovered at power up must be those of the 
+ * records completed before the failure. The simulation then carries on 
+ * from the recovered states.
+ * 
+ * It also checks that no poll writes more than one byte and that an IO 
+ * which settles is written even though another keeps changing.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "devincs.h"
+#include "module.h"
+#include "romops.h"
+#include "TickTime.h"
+#include "stateJournal.h"
+#include "test.h"
+
+#define EE_SIZE             1024
+#define EE_ENDURANCE        100000UL
+#define POLL_TICKS          (HALF_MILLI_SECOND)     // the main loop tick
+#define LC_IO               3
+#define LC_CHANGES_PER_DAY  1000
+#define SIM_DAYS            30
+#define POWER_FAILS         2000
+
+static BYTE eeprom[EE_SIZE];
+static DWORD eeWrites[EE_SIZE];
+static DWORD writesThisPoll;
+static DWORD now;
+static BYTE committed[NUM_IO];      // states of the completed records
+static BYTE inFlightIo;             // IO of the record being written, 0xFF if none
+
+BYTE ee_read(WORD address) {
+    return eeprom[address];
+}
+
+/**
+ * Write a byte and note the records completed. A record is complete once 
+ * its sequence number, its first byte, is written.
+ */
+void ee_write(WORD address, BYTE data) {
+    WORD offset;
+    
+    eeprom[address] = data;
+    eeWrites[address]++;
+    writesThisPoll++;
+    if ((address >= EE_STATE_JOURNAL) && (address < EE_STATE_JOURNAL + JOURNAL_SIZE)) {
+        offset = (address - EE_STATE_JOURNAL) % 4;
+        if (offset == 1) {
+            inFlightIo = data;
+        } else if (offset == 0) {
+            committed[eeprom[address+1]] = eeprom[address+2];
+            inFlightIo = 0xFF;
+        }
+    }
+}
+
+DWORD tickGet(void) {
+    return now;
+}
+
+DWORD tickTimeSince(TickValue t) {
+    return now - t.Val;
+}
+
+static DWORD maxWritesPerPoll;
+
+static void poll(void) {
+    writesThisPoll = 0;
+    pollStateJournal();
+    if (writesThisPoll > maxWritesPerPoll) maxWritesPerPoll = writesThisPoll;
+    now += POLL_TICKS;
+}
+
+static void pollFor(DWORD ticks) {
+    DWORD end = now + ticks;
+    
+    while (now < end) {
+        poll();
+    }
+}
+
+static void powerUp(void) {
+    BYTE io;
+    
+    stateJournalInit();
+    for (io=0; io<NUM_IO; io++) {
+        committed[io] = getOutputState(io);
+    }
+    inFlightIo = 0xFF;
+}
+
+static void freshEeprom(void) {
+    memset(eeprom, 0xFF, sizeof(eeprom));
+    memset(eeWrites, 0, sizeof(eeWrites));
+    now = 0;
+    powerUp();
+}
+
+static void simulateLifetime(void) {
+    DWORD day;
+    DWORD change;
+    DWORD maxWrites;
+    WORD address;
+    BYTE value;
+    
+    freshEeprom();
+    value = 0;
+    for (day=0; day<SIM_DAYS; day++) {
+        for (change=0; change<LC_CHANGES_PER_DAY; change++) {
+            value = ! value;
+            saveOutputState(LC_IO, value);
+            if ((change % 100) == 0) {
+                saveOutputState(rand() % NUM_IO, rand() % 3);
+            }
+            pollFor(ONE_SECOND + ONE_SECOND/5);
+        }
+    }
+    maxWrites = 0;
+    for (address=0; address<EE_SIZE; address++) {
+        if (eeWrites[address] > maxWrites) maxWrites = eeWrites[address];
+    }
+    printf("%d days of %d changes a day: most written byte %lu times, %.1f a day\n",
+            SIM_DAYS, LC_CHANGES_PER_DAY, (unsigned long)maxWrites, (double)maxWrites/SIM_DAYS);
+    printf("life for %lu writes: %.1f years with the journal, %.1f years with one byte per output\n",
+            (unsigned long)EE_ENDURANCE, EE_ENDURANCE/((double)maxWrites/SIM_DAYS)/365, 
+            EE_ENDURANCE/(double)LC_CHANGES_PER_DAY/365);
+    CHECK("lifetime: at least 10 years", EE_ENDURANCE/((double)maxWrites/SIM_DAYS)/365 > 10.0);
+}
+
+static void simulatePowerFails(void) {
+    int fail;
+    int step;
+    int steps;
+    BYTE io;
+    BYTE recovered[NUM_IO];
+    int wrong;
+    
+    freshEeprom();
+    wrong = 0;
+    for (fail=0; fail<POWER_FAILS; fail++) {
+        steps = rand() % 400;
+        for (step=0; step<steps; step++) {
+            if ((rand() % 4) == 0) {
+                saveOutputState(rand() % NUM_IO, rand() % 256);
+            }
+            if ((rand() % 20) == 0) {
+                pollFor(ONE_SECOND + rand() % ONE_SECOND);  // let the changes settle
+            } else {
+                pollFor(POLL_TICKS * (1 + rand() % 8));
+            }
+        }
+        // the power fails and comes back
+        for (io=0; io<NUM_IO; io++) {
+            recovered[io] = committed[io];
+        }
+        powerUp();
+        for (io=0; io<NUM_IO; io++) {
+            if (getOutputState(io) != recovered[io]) wrong++;
+        }
+    }
+    printf("%d power failures: %d states recovered wrongly\n", POWER_FAILS, wrong);
+    CHECK("power fails: states recovered", wrong == 0);
+}
+
+static void simulateBusyNeighbour(void) {
+    DWORD start;
+    BYTE value;
+    
+    freshEeprom();
+    pollFor(ONE_SECOND);
+    saveOutputState(1, 1);
+    start = now;
+    value = 0;
+    while ((committed[1] != 1) && (now - start < 10*ONE_SECOND)) {
+        value = ! value;
+        saveOutputState(2, value);  // keeps changing
+        pollFor(ONE_SECOND/2);
+    }
+    printf("IO settled whilst another kept changing written after %lu ms\n", 
+            (unsigned long)((now - start) / ONE_MILI_SECOND));
+    CHECK("busy neighbour: settled IO written", committed[1] == 1);
+    CHECK("busy neighbour: written promptly", now - start < 2*ONE_SECOND);
+}
+
+int main(void) {
+    srand(1);
+    maxWritesPerPoll = 0;
+    simulateLifetime();
+    simulatePowerFails();
+    simulateBusyNeighbour();
+    printf("most EEPROM bytes written in one poll: %lu\n", (unsigned long)maxWritesPerPoll);
+    CHECK("one byte per poll", maxWritesPerPoll <= 1);
+    return testResult("stateJournal");
+}
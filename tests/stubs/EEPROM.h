@@ -0,0 +1,7 @@
+#define EE_TOP 0x3FF
+#define EE_BOOT_FLAG EE_TOP
+#define EE_CAN_ID (EE_TOP-1)
+#define EE_NODE_ID (EE_TOP-3)
+#define EE_FLIM_MODE (EE_TOP-4)
+#define EE_VERSION (EE_TOP-5)
+#define EE_APPLICATION (EE_TOP-8)
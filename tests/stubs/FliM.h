@@ -0,0 +1,20 @@
+#ifndef FLIM_H
+#define FLIM_H
+#include "GenericTypeDefs.h"
+#include "module.h"
+#include "events.h"
+#include "cbus.h"
+#include "romops.h"
+#include "TickTime.h"
+extern ModuleNvDefs * NV;
+#define fsFLiMLearn 3
+#define fsFLiM 2
+#define fsSLiM 0
+#define DEFAULT_CANID 0
+#define DEFAULT_NN 0
+extern BYTE flimState; extern void flimInit(void); extern void FLiMSWCheck(void);
+typedef struct { BYTE a[20]; } ParamVals; typedef struct { BYTE a; } SpareParams; typedef struct { BYTE a; DWORD b; WORD c; } FCUParams;
+extern const char module_type[];
+#define CPU 1
+#define CPUM_MICROCHIP 1
+#endif
@@ -0,0 +1,6 @@
+#ifndef GTD
+#define GTD
+typedef unsigned char BYTE; typedef unsigned short WORD; typedef unsigned int DWORD; typedef unsigned char BOOL;
+#define TRUE 1
+#define FALSE 0
+#endif
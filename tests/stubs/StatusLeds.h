@@ -0,0 +1 @@
+extern void initStatusLeds(void); extern void checkFlashing(void);
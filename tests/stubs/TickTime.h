@@ -0,0 +1,12 @@
+#ifndef TT
+#define TT
+#include "GenericTypeDefs.h"
+typedef union { DWORD Val; struct { BYTE b0,b1,b2,b3; } byte; } TickValue;
+extern DWORD tickGet(void); extern DWORD tickTimeSince(TickValue t); extern void initTicker(BYTE); extern void tickISR(void);
+extern BYTE clkMHz;
+#define ONE_SECOND ((DWORD)62500)
+#define TWO_SECOND (2*ONE_SECOND)
+#define HUNDRED_MILI_SECOND (ONE_SECOND/10)
+#define ONE_MILI_SECOND (ONE_SECOND/1000)
+#define HALF_MILLI_SECOND (ONE_SECOND/2000)
+#endif
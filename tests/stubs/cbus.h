@@ -0,0 +1,14 @@
+#include "GenericTypeDefs.h"
+#define d0 0
+#define d1 1
+#define d2 2
+#define d3 3
+#define d4 4
+#define d5 5
+#define d6 6
+#define d7 7
+#define ALL_CBUS 0
+extern BYTE cbusMsg[]; extern BOOL cbusMsgReceived(BYTE, BYTE*); extern BOOL parseCBUSMsg(BYTE*); extern BOOL thisNN(BYTE*);
+extern BOOL cbusSendOpcMyNN(BYTE, BYTE, BYTE*); extern BOOL cbusSendOpcNN(BYTE, BYTE, WORD, BYTE*); extern BOOL cbusSendEvent(BYTE, WORD, WORD, BOOL); extern BOOL cbusSendMsg(BYTE, BYTE*);
+extern void shortFlicker(void); extern void longFlicker(void);
+extern void canInterruptHandler(void);
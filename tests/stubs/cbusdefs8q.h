@@ -0,0 +1,47 @@
+#define MANU_MERG 165
+#define MTYP_CANMIO 32
+#define PF_COMBI 3
+#define PF_BOOT 8
+#define PF_COE 64
+#define PB_CAN 1
+#define OPC_NNRSM 0x4F
+#define OPC_NNRST 0x5E
+#define OPC_CMDERR 0x6F
+#define OPC_ARSON3 0xFD
+#define OPC_ACON 0x90
+#define OPC_ACOF 0x91
+#define OPC_ASON 0x98
+#define OPC_ASOF 0x99
+#define OPC_ACON1 0xB0
+#define OPC_ACOF1 0xB1
+#define OPC_ASON1 0xB8
+#define OPC_ASOF1 0xB9
+#define OPC_ACON2 0xD0
+#define OPC_ACOF2 0xD1
+#define OPC_ASON2 0xD8
+#define OPC_ASOF2 0xD9
+#define OPC_ACON3 0xF0
+#define OPC_ACOF3 0xF1
+#define OPC_ASON3 0xF8
+#define OPC_ASOF3 0xF9
+#define OPC_EVLRN 0xD2
+#define OPC_EVULN 0x95
+#define OPC_NNCLR 0x55
+#define OPC_NNLRN 0x53
+#define OPC_NNULN 0x54
+#define OPC_NERD 0x57
+#define OPC_NENRD 0x72
+#define OPC_REVAL 0x9C
+#define OPC_RQEVN 0x58
+#define OPC_EVLRI 0xF5
+#define OPC_REQEV 0xB2
+#define OPC_ENRSP 0xF2
+#define OPC_WRACK 0x59
+#define OPC_AREQ 0x92
+#define OPC_ASRQ 0x9A
+#define CMDERR_NOT_LRN 2
+#define CMDERR_INV_EV_IDX 6
+#define CMDERR_INV_NV_IDX 10
+#define CMDERR_NO_EV 11
+#define OPC_NVSET 0x96
+#define OPC_EVLRNI 0xF5
@@ -0,0 +1,104 @@
+/*
+ * File:   devincs.h
+ *
+ * Host stand-in for the processor header. The special function registers
+ * used by the module are ordinary variables so tests can set and inspect
+ * them. They are defined in sfr.c.
+ */
+
+#ifndef DEVINCS_H
+#define DEVINCS_H
+
+#define rom
+#define near
+#define __18F26K80
+
+#ifndef SFR
+#define SFR extern
+#endif
+
+typedef struct { unsigned TMR1ON:1, TMR1CS:2, T1CKPS:2, SOSCEN:1, RD16:1, TMR3ON:1, TMR3CS:2, T3CKPS:2; } T1CONbits_t;
+typedef struct { unsigned TMR1GE:1, TMR3GE:1; } T1GCONbits_t;
+typedef struct { unsigned TMR1IE:1, TMR1IF:1, TMR3IE:1, TMR3IF:1, ADIF:1, ADIE:1, TMR2IF:1, TMR2IE:1, TMR2IP:1, ADIP:1; } PIRbits_t;
+typedef struct { unsigned GO:1, ADON:1, CHS:5; } ADCON0bits_t;
+typedef struct { unsigned VCFG:2, VNCFG:1, TRIGSEL:2, CHSN:3, ADFM:1, ACQT:3, ADCS:3; } ADCON1bits_t;
+typedef struct { unsigned PLLEN:1; } OSCTUNEbits_t;
+typedef struct { unsigned RBPU:1; } INTCON2bits_t;
+typedef struct { unsigned IPEN:1, TO:1, PD:1, POR:1, BOR:1, RI:1; } RCONbits_t;
+typedef struct { unsigned IDLEN:1; } OSCCONbits_t;
+typedef struct { unsigned SWDTEN:1; } WDTCONbits_t;
+typedef struct { unsigned GIEH:1, GIEL:1, GIE:1, PEIE:1; } INTCONbits_t;
+typedef struct { unsigned T2CKPS:2, T2OUTPS:4, TMR2ON:1; } T2CONbits_t;
+typedef struct { unsigned REQOP:3; } CANCONbits_t;
+typedef struct { unsigned OPMODE:3; } CANSTATbits_t;
+typedef struct { unsigned MDSEL:2; } ECANCONbits_t;
+typedef struct { unsigned RXB1OVFL:1, RXB0OVFL:1; } COMSTATbits_t;
+typedef struct { unsigned RC0:1, RC1:1, RC2:1, RC4:1, RC5:1, RC6:1; } PORTCbits_t;
+typedef struct { unsigned RB0:1, RB1:1, RB5:1; } PORTBbits_t;
+typedef struct { unsigned RA0:1, RA1:1, RA3:1; } PORTAbits_t;
+typedef struct { unsigned LATC2:1, LATC6:1; } LATCbits_t;
+typedef struct { unsigned LATB5:1; } LATBbits_t;
+typedef struct { unsigned LATA3:1; } LATAbits_t;
+typedef struct { unsigned TRISC2:1, TRISC6:1; } TRISCbits_t;
+typedef struct { unsigned TRISB5:1; } TRISBbits_t;
+typedef struct { unsigned TRISA3:1; } TRISAbits_t;
+
+SFR T1CONbits_t T1CONbits, T3CONbits;
+SFR T1GCONbits_t T1GCONbits, T3GCONbits;
+SFR PIRbits_t PIE1bits, PIE2bits, PIR1bits, PIR2bits, IPR1bits;
+SFR ADCON0bits_t ADCON0bits;
+SFR ADCON1bits_t ADCON1bits, ADCON2bits;
+SFR OSCTUNEbits_t OSCTUNEbits;
+SFR INTCON2bits_t INTCON2bits;
+SFR RCONbits_t RCONbits;
+SFR OSCCONbits_t OSCCONbits;
+SFR WDTCONbits_t WDTCONbits;
+SFR INTCONbits_t INTCONbits;
+SFR T2CONbits_t T2CONbits;
+SFR CANCONbits_t CANCONbits;
+SFR CANSTATbits_t CANSTATbits;
+SFR ECANCONbits_t ECANCONbits;
+SFR COMSTATbits_t COMSTATbits;
+SFR PORTCbits_t PORTCbits;
+SFR PORTBbits_t PORTBbits;
+SFR PORTAbits_t PORTAbits;
+SFR LATCbits_t LATCbits;
+SFR LATBbits_t LATBbits;
+SFR LATAbits_t LATAbits;
+SFR TRISCbits_t TRISCbits;
+SFR TRISBbits_t TRISBbits;
+SFR TRISAbits_t TRISAbits;
+
+SFR unsigned char TMR0L, TMR0H, TMR1H, TMR1L, TMR2, TMR3H, TMR3L, PR2, T2CON;
+SFR unsigned char TRISA, TRISB, TRISC, PORTA, PORTB, PORTC, LATA, LATB, LATC;
+SFR unsigned char ANCON0, ANCON1, WPUB, ADRESH, ADRESL;
+SFR unsigned char PIR5, PIE5, WDTCON, RCON, OSCCON, EEADR, EEADRH, EEDATA;
+SFR unsigned char CANCON, CANSTAT, ECANCON, COMSTAT, BRGCON1, CIOCON, BSEL0, SDFLC;
+SFR unsigned char MSEL0, MSEL1, MSEL2, MSEL3, RXFCON0, RXFCON1;
+SFR unsigned char RXFBCON0, RXFBCON1, RXFBCON2, RXFBCON3, RXFBCON4, RXFBCON5, RXFBCON6, RXFBCON7;
+SFR unsigned char RXM0SIDH, RXM0SIDL, RXM0EIDH, RXM0EIDL;
+SFR unsigned char RXM1SIDH, RXM1SIDL, RXM1EIDH, RXM1EIDL;
+SFR unsigned char RXF0SIDH, RXF0SIDL, RXF0EIDH, RXF0EIDL;
+SFR unsigned char RXF1SIDH, RXF1SIDL, RXF1EIDH, RXF1EIDL;
+SFR unsigned char RXF2SIDH, RXF2SIDL, RXF2EIDH, RXF2EIDL;
+SFR unsigned char RXF3SIDH, RXF3SIDL, RXF3EIDH, RXF3EIDL;
+SFR unsigned char RXF4SIDH, RXF4SIDL, RXF4EIDH, RXF4EIDL;
+SFR unsigned char RXF5SIDH, RXF5SIDL, RXF5EIDH, RXF5EIDL;
+SFR unsigned char RXF6SIDH, RXF6SIDL, RXF6EIDH, RXF6EIDL;
+SFR unsigned char RXF7SIDH, RXF7SIDL, RXF7EIDH, RXF7EIDL;
+SFR unsigned char RXF8SIDH, RXF8SIDL, RXF8EIDH, RXF8EIDL;
+SFR unsigned char RXF9SIDH, RXF9SIDL, RXF9EIDH, RXF9EIDL;
+SFR unsigned char RXF10SIDH, RXF10SIDL, RXF10EIDH, RXF10EIDL;
+SFR unsigned char RXF11SIDH, RXF11SIDL, RXF11EIDH, RXF11EIDL;
+SFR unsigned char RXF12SIDH, RXF12SIDL, RXF12EIDH, RXF12EIDL;
+SFR unsigned char RXF13SIDH, RXF13SIDL, RXF13EIDH, RXF13EIDL;
+SFR unsigned char RXF14SIDH, RXF14SIDL, RXF14EIDH, RXF14EIDL;
+SFR unsigned char RXF15SIDH, RXF15SIDL, RXF15EIDH, RXF15EIDL;
+
+#define ei()
+#define Reset()
+#define ClrWdt()
+#define Sleep()
+#define Nop()
+
+#endif
@@ -0,0 +1,15 @@
+#ifndef EVENTS_H
+#define EVENTS_H
+#include "module.h"
+#include "GenericTypeDefs.h"
+typedef struct { WORD NN; WORD EN; } Event;
+typedef union { struct { BYTE eVsUsed:4; BOOL continued:1; BOOL continuation:1; BOOL forceOwnNN:1; BOOL freeEntry:1; }; BYTE asByte; } EventTableFlags;
+typedef struct { EventTableFlags flags; BYTE next; Event event; BYTE evs[EVENT_TABLE_WIDTH]; } EventTable;
+#define NO_INDEX 0xFF
+#define EVENT_ON_MASK 1
+extern Event producedEvent; extern BYTE evs[]; extern WORD nodeID;
+extern BYTE getEVs(BYTE); extern int getEv(BYTE, BYTE); extern BYTE addEvent(WORD, WORD, BYTE, BYTE, BOOL);
+extern void deleteConsumerActionRange(BYTE, BYTE); extern void deleteProducerActionRange(BYTE, BYTE); extern void clearAllEvents(void);
+extern BYTE findEvent(WORD, WORD); extern WORD getNN(BYTE); extern WORD getEN(BYTE); extern BOOL validStart(BYTE); extern void rebuildHashtable(void);
+extern BOOL sendProducedEvent(PRODUCER_ACTION_T, BOOL);
+#endif
@@ -0,0 +1,3 @@
+#include "GenericTypeDefs.h"
+extern void initRomOps(void); extern void writeFlashByte(BYTE*, BYTE); extern BYTE readFlashBlock(WORD); extern void flushFlashImage(void);
+extern BYTE ee_read(WORD); extern void ee_write(WORD, BYTE); extern void ee_write_short(WORD, WORD); extern WORD ee_read_short(WORD);
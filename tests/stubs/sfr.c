@@ -0,0 +1,8 @@
+/*
+ * File:   sfr.c
+ *
+ * Defines the special function registers declared in devincs.h.
+ */
+
+#define SFR
+#include "devincs.h"
@@ -0,0 +1,35 @@
+/*
+ * File:   test.h
+ *
+ * Created on 18 October 2026, 10:00
+ *
+ * Checks for the host tests.
+ */
+
+#ifndef TEST_H
+#define	TEST_H
+
+#include <stdio.h>
+
+static int testChecks;
+static int testFailures;
+
+#define CHECK(what, condition)  do { \
+        testChecks++; \
+        if ( ! (condition)) { \
+            testFailures++; \
+            printf("FAIL %s:%d %s\n", __FILE__, __LINE__, (what)); \
+        } \
+    } while (0)
+
+/**
+ * Report the result of a test program.
+ * @param name the name of the test
+ * @return the exit status
+ */
+static int testResult(const char * name) {
+    printf("%s: %d checks, %d failed\n", name, testChecks, testFailures);
+    return testFailures ? 1 : 0;
+}
+
+#endif	/* TEST_H */
@@ -0,0 +1,588 @@
+/*
+ Routines for CBUS FLiM operations - part of CBUS libraries for PIC 18F
+  This work is licensed under the:
+      Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International License.
+   To view a copy of this license, visit:
+      http://creativecommons.org/licenses/by-nc-sa/4.0/
+   or send a letter to Creative Commons, PO Box 1866, Mountain View, CA 94042, USA.
+   License summary:
+    You are free to:
+      Share, copy and redistribute the material in any medium or format
+      Adapt, remix, transform, and build upon the material
+    The licensor cannot revoke these freedoms as long as you follow the license terms.
+    Attribution : You must give appropriate credit, provide a link to the license,
+                   and indicate if changes were made. You may do so in any reasonable manner,
+                   but not in any way that suggests the licensor endorses you or your use.
+    NonCommercial : You may not use the material for commercial purposes. **(see note below)
+    ShareAlike : If you remix, transform, or build upon the material, you must distribute
+                  your contributions under the same license as the original.
+    No additional restrictions : You may not apply legal terms or technological measures that
+                                  legally restrict others from doing anything the license permits.
+   ** For commercial use, please contact the original copyright holder(s) to agree licensing terms
+**************************************************************************************************************
+	The FLiM routines have no code or definitions that are specific to any
+	module, so they can be used to provide FLiM facilities for any module 
+	using these libraries.
+	
+*/ 
+/*
+ * File:   test_canFilter.c
+ *
+ * Created on 18 October 2026, 10:00
+ *
+ * Host test of canFilter.c. The filters are computed from an event table and
+ * a table of frames is passed through a model of the ECAN acceptance filters
+ * in mode 1/2 with data byte filtering (SDFLC). The model compares:
+ *  - the standard identifier against RXFnSIDH and RXFnSIDL<7:5>
+ *  - the EXIDE bit against RXFnSIDL<3> when the mask's EXIDEN bit is set
+ *  - data byte 0 against EID<15:8>, data byte 1 against EID<7:0> and data
+ *    byte 2 bits 7:6 against EID<17:16>, for the first SDFLC bits
+ * 
+ * How the ECAN treats data bits missing from a short frame isn't described
+ * so frames with too few data bytes are checked both with the missing bits
+ * read as 0 and with them not compared and must give the same result.
+ * 
+ * A report then runs a mixed stream of frames, as a layout of other 
+ * producers and a DCC cab bus would send, through the model for several
+ * event tables and prints how many frames are rejected by the hardware, each
+ * of which saves a receive interrupt, and how many of those were accessory 
+ * events, each of which also saves an event lookup.
+ */
+
+#include <stdio.h>
+#include "devincs.h"
+#include "module.h"
+#include "events.h"
+#include "TickTime.h"
+#include "canFilter.h"
+#include "test.h"
+
+#define MAX_TABLE   16
+
+/*
+ * The event table seen through the CBUSlib functions canFilter.c uses
+ */
+typedef struct {
+    WORD nn;
+    WORD en;
+    BYTE action;    // EV#2 first consumer action, NO_ACTION for produced only
+} TestEvent;
+
+static TestEvent table[MAX_TABLE];
+static BYTE tableSize;
+BYTE evs[EVperEVT];
+
+BOOL validStart(BYTE tableIndex) {
+    return tableIndex < tableSize;
+}
+
+BYTE getEVs(BYTE tableIndex) {
+    BYTE e;
+    
+    for (e=0; e<EVperEVT; e++) {
+        evs[e] = NO_ACTION;
+    }
+    evs[1] = table[tableIndex].action;
+    return 0;
+}
+
+WORD getNN(BYTE tableIndex) {
+    return table[tableIndex].nn;
+}
+
+/*
+ * The bus load meter
+ */
+static BOOL meteringBus;
+
+BOOL busLoadMetering(void) {
+    return meteringBus;
+}
+
+/*
+ * Time passes while waiting for the ECAN and it follows REQOP unless stuck
+ */
+static DWORD now;
+static BOOL modeStuck;
+
+DWORD tickGet(void) {
+    now += 10;
+    if ( ! modeStuck) {
+        CANSTATbits.OPMODE = CANCONbits.REQOP;
+    }
+    return now;
+}
+
+DWORD tickTimeSince(TickValue t) {
+    return tickGet() - t.Val;
+}
+
+/*
+ * The ECAN acceptance model
+ */
+#define MISSING_AS_ZERO     0
+#define MISSING_IGNORED     1
+
+typedef struct {
+    const char * name;
+    WORD sid;
+    BOOL extended;
+    BOOL rtr;
+    BYTE dlc;
+    BYTE opc;
+    WORD nn;
+    WORD en;
+    BOOL accept;
+} Frame;
+
+static BYTE * const filterRegs[16][4] = {
+    {&RXF0SIDH, &RXF0SIDL, &RXF0EIDH, &RXF0EIDL},
+    {&RXF1SIDH, &RXF1SIDL, &RXF1EIDH, &RXF1EIDL},
+    {&RXF2SIDH, &RXF2SIDL, &RXF2EIDH, &RXF2EIDL},
+    {&RXF3SIDH, &RXF3SIDL, &RXF3EIDH, &RXF3EIDL},
+    {&RXF4SIDH, &RXF4SIDL, &RXF4EIDH, &RXF4EIDL},
+    {&RXF5SIDH, &RXF5SIDL, &RXF5EIDH, &RXF5EIDL},
+    {&RXF6SIDH, &RXF6SIDL, &RXF6EIDH, &RXF6EIDL},
+    {&RXF7SIDH, &RXF7SIDL, &RXF7EIDH, &RXF7EIDL},
+    {&RXF8SIDH, &RXF8SIDL, &RXF8EIDH, &RXF8EIDL},
+    {&RXF9SIDH, &RXF9SIDL, &RXF9EIDH, &RXF9EIDL},
+    {&RXF10SIDH, &RXF10SIDL, &RXF10EIDH, &RXF10EIDL},
+    {&RXF11SIDH, &RXF11SIDL, &RXF11EIDH, &RXF11EIDL},
+    {&RXF12SIDH, &RXF12SIDL, &RXF12EIDH, &RXF12EIDL},
+    {&RXF13SIDH, &RXF13SIDL, &RXF13EIDH, &RXF13EIDL},
+    {&RXF14SIDH, &RXF14SIDL, &RXF14EIDH, &RXF14EIDL},
+    {&RXF15SIDH, &RXF15SIDL, &RXF15EIDH, &RXF15EIDL}
+};
+
+static BYTE * const maskRegs[2][4] = {
+    {&RXM0SIDH, &RXM0SIDL, &RXM0EIDH, &RXM0EIDL},
+    {&RXM1SIDH, &RXM1SIDL, &RXM1EIDH, &RXM1EIDL}
+};
+
+/**
+ * Whether one data bit of the filter matches.
+ * @param bit the number of the data bit, 0 is the top bit of data byte 0
+ */
+static BOOL dataBitMatches(const Frame * f, BYTE bit, BYTE * filter, BYTE * mask, BYTE missing) {
+    BYTE data[3];
+    BYTE frameBit;
+    BYTE filterBit;
+    BYTE maskBit;
+    
+    if (bit/8 >= f->dlc) {
+        if (missing == MISSING_IGNORED) return TRUE;
+        frameBit = 0;
+    } else {
+        data[0] = f->opc;
+        data[1] = f->nn >> 8;
+        data[2] = f->nn & 0xFF;
+        frameBit = (data[bit/8] >> (7 - bit%8)) & 1;
+    }
+    if (bit < 8) {
+        filterBit = (filter[2] >> (7 - bit)) & 1;
+        maskBit = (mask[2] >> (7 - bit)) & 1;
+    } else if (bit < 16) {
+        filterBit = (filter[3] >> (15 - bit)) & 1;
+        maskBit = (mask[3] >> (15 - bit)) & 1;
+    } else {
+        filterBit = (filter[1] >> (17 - bit)) & 1;
+        maskBit = (mask[1] >> (17 - bit)) & 1;
+    }
+    return ( ! maskBit) || (frameBit == filterBit);
+}
+
+static BOOL filterMatches(const Frame * f, BYTE n, BYTE missing) {
+    BYTE * filter[4];
+    BYTE * maskp[4];
+    BYTE fr[4];
+    BYTE mk[4];
+    BYTE sel;
+    BYTE i;
+    BYTE bit;
+    
+    switch (n >> 2) {
+        case 0: sel = MSEL0; break;
+        case 1: sel = MSEL1; break;
+        case 2: sel = MSEL2; break;
+        default: sel = MSEL3; break;
+    }
+    sel = (sel >> ((n & 3) * 2)) & 3;
+    for (i=0; i<4; i++) {
+        filter[i] = filterRegs[n][i];
+        fr[i] = *filter[i];
+        if (sel == 3) {
+            mk[i] = 0;
+        } else {
+            maskp[i] = (sel == 2) ? filterRegs[15][i] : maskRegs[sel][i];
+            mk[i] = *maskp[i];
+        }
+    }
+    if ((((f->sid >> 3) ^ fr[0]) & mk[0]) != 0) return FALSE;
+    if (((((f->sid & 7) << 5) ^ fr[1]) & mk[1] & 0xE0) != 0) return FALSE;
+    if ((mk[1] & 0x08) && (f->extended != ((fr[1] >> 3) & 1))) return FALSE;
+    if (f->extended) return TRUE;  // data bytes are only compared in standard frames
+    for (bit=0; bit<SDFLC && bit<18; bit++) {
+        if ( ! dataBitMatches(f, bit, fr, mk, missing)) return FALSE;
+    }
+    return TRUE;
+}
+
+static BOOL accepted(const Frame * f, BYTE missing) {
+    BYTE n;
+    BYTE enabled;
+    
+    for (n=0; n<16; n++) {
+        enabled = (n < 8) ? (RXFCON0 >> n) & 1 : (RXFCON1 >> (n - 8)) & 1;
+        if (enabled && filterMatches(f, n, missing)) return TRUE;
+    }
+    return FALSE;
+}
+
+/**
+ * Check a table of frames against the current filter registers.
+ */
+static void checkFrames(const char * setup, const Frame * frames, BYTE count) {
+    BYTE i;
+    char what[100];
+    
+    for (i=0; i<count; i++) {
+        snprintf(what, sizeof(what), "%s: %s", setup, frames[i].name);
+        CHECK(what, accepted(&frames[i], MISSING_AS_ZERO) == frames[i].accept);
+        CHECK(what, accepted(&frames[i], MISSING_IGNORED) == frames[i].accept);
+    }
+}
+
+static void resetEcan(BYTE mode) {
+    now = 0;
+    modeStuck = FALSE;
+    ECANCONbits.MDSEL = mode;
+    CANCONbits.REQOP = 0;
+    CANSTATbits.OPMODE = 0;
+    RXFBCON0 = 0x01;
+    RXFCON0 = 0x01;
+    RXFCON1 = 0;
+    MSEL0 = 0;
+    SDFLC = 0;
+    RXM0SIDL = 0;
+    RXM0EIDH = 0;
+}
+
+static void learn(WORD nn, WORD en, BYTE action) {
+    table[tableSize].nn = nn;
+    table[tableSize].en = en;
+    table[tableSize].action = action;
+    tableSize++;
+}
+
+#define CONSUMED    ACTION_IO_CONSUMER_BASE(0)
+
+/*
+ * Learned: long events from NN 257 and NN 1000 and a produced event from NN 2000
+ */
+static const Frame longEventFrames[] = {
+    // name                  sid    ext    rtr    dlc opc        nn     en   accept
+    {"ACON learned",         0x10,  FALSE, FALSE, 5, OPC_ACON,   257,   1,   TRUE},
+    {"ACOF learned",         0x10,  FALSE, FALSE, 5, OPC_ACOF,   257,   1,   TRUE},
+    {"ACON same NN block",   0x10,  FALSE, FALSE, 5, OPC_ACON,   300,   9,   TRUE},
+    {"ACON 2nd NN",          0x7F,  FALSE, FALSE, 5, OPC_ACON,   1000,  5,   TRUE},
+    {"ACON other NN block",  0x10,  FALSE, FALSE, 5, OPC_ACON,   321,   1,   FALSE},
+    {"ACOF produced only",   0x10,  FALSE, FALSE, 5, OPC_ACOF,   2000,  3,   FALSE},
+    {"ASON other NN block",  0x10,  FALSE, FALSE, 5, OPC_ASON,   5000,  1,   FALSE},
+    {"ACON1 with data",      0x10,  FALSE, FALSE, 6, OPC_ACON1,  5000,  1,   TRUE},
+    {"ACON3 with data",      0x10,  FALSE, FALSE, 8, OPC_ACON3,  5000,  1,   TRUE},
+    {"RTR self enumeration", 0x21,  FALSE, TRUE,  0, 0,          0,     0,   TRUE},
+    {"enumeration response", 0x05,  FALSE, FALSE, 0, 0,          0,     0,   TRUE},
+    {"QNN",                  0x10,  FALSE, FALSE, 1, 0x0D,       0,     0,   TRUE},
+    {"RQNP",                 0x10,  FALSE, FALSE, 1, 0x10,       0,     0,   TRUE},
+    {"SNN",                  0x10,  FALSE, FALSE, 3, 0x42,       1234,  0,   TRUE},
+    {"NNCLR",                0x10,  FALSE, FALSE, 3, OPC_NNCLR,  1234,  0,   TRUE},
+    {"NERD",                 0x10,  FALSE, FALSE, 3, OPC_NERD,   1234,  0,   TRUE},
+    {"NVSET",                0x10,  FALSE, FALSE, 5, OPC_NVSET,  1234,  0,   TRUE},
+    {"AREQ",                 0x10,  FALSE, FALSE, 5, OPC_AREQ,   5000,  1,   TRUE},
+    {"ASRQ",                 0x10,  FALSE, FALSE, 5, OPC_ASRQ,   5000,  1,   TRUE},
+    {"EVULN",                0x10,  FALSE, FALSE, 5, OPC_EVULN,  5000,  1,   TRUE},
+    {"REVAL",                0x10,  FALSE, FALSE, 5, OPC_REVAL,  1234,  0,   TRUE},
+    {"EVLRN",                0x10,  FALSE, FALSE, 7, OPC_EVLRN,  5000,  1,   TRUE},
+    {"ENRSP",                0x10,  FALSE, FALSE, 8, OPC_ENRSP,  1234,  0,   TRUE},
+    {"RDCC4 not used",       0x10,  FALSE, FALSE, 5, 0x80,       0,     0,   FALSE},
+    {"extended frame",       0x10,  TRUE,  FALSE, 8, 0x0D,       0,     0,   FALSE}
+};
+
+static const Frame shortEventFrames[] = {
+    // name                  sid    ext    rtr    dlc opc        nn     en   accept
+    {"ASON any NN",          0x10,  FALSE, FALSE, 5, OPC_ASON,   5000,  7,   TRUE},
+    {"ACON any NN",          0x10,  FALSE, FALSE, 5, OPC_ACON,   2000,  3,   TRUE},
+    {"RTR self enumeration", 0x21,  FALSE, TRUE,  0, 0,          0,     0,   TRUE},
+    {"QNN",                  0x10,  FALSE, FALSE, 1, 0x0D,       0,     0,   TRUE}
+};
+
+/*
+ * Everything is accepted while the filters are open
+ */
+static const Frame openFrames[] = {
+    // name                  sid    ext    rtr    dlc opc        nn     en   accept
+    {"ACON any NN",          0x10,  FALSE, FALSE, 5, OPC_ACON,   2000,  3,   TRUE},
+    {"RDCC4",                0x10,  FALSE, FALSE, 5, 0x80,       0,     0,   TRUE},
+    {"RTR self enumeration", 0x21,  FALSE, TRUE,  0, 0,          0,     0,   TRUE},
+    {"extended frame",       0x10,  TRUE,  FALSE, 8, 0x0D,       0,     0,   TRUE}
+};
+
+#define COUNT(a)    (sizeof(a)/sizeof(a[0]))
+
+static void testLongEvents(void) {
+    resetEcan(2);
+    tableSize = 0;
+    learn(257, 1, CONSUMED);
+    learn(1000, 5, CONSUMED);
+    learn(2000, 3, NO_ACTION);
+    canFilterInit();
+    CHECK("long events: filtering", getCanFilterState() == ((10 << 8) | 2));
+    CHECK("long events: back in normal mode", CANSTATbits.OPMODE == 0);
+    checkFrames("long events", longEventFrames, COUNT(longEventFrames));
+}
+
+static void testShortEvent(void) {
+    resetEcan(2);
+    tableSize = 0;
+    learn(257, 1, CONSUMED);
+    learn(0, 7, CONSUMED);
+    canFilterInit();
+    CHECK("short event: no NN bits compared", getCanFilterState() == 1);
+    checkFrames("short event", shortEventFrames, COUNT(shortEventFrames));
+}
+
+static void testManyBlocks(void) {
+    BYTE i;
+    Frame f = {"", 0x10, FALSE, FALSE, 5, OPC_ACON, 0, 1, TRUE};
+    char what[60];
+    static const WORD nns[] = {64, 1000, 5000, 9000, 20000, 40000, 65000};
+    
+    resetEcan(2);
+    tableSize = 0;
+    for (i=0; i<COUNT(nns); i++) {
+        learn(nns[i], 1, CONSUMED);
+    }
+    canFilterInit();
+    CHECK("many blocks: filtering", getCanFilterState() != CAN_FILTER_OFF);
+    CHECK("many blocks: fewer NN bits", (getCanFilterState() >> 8) < 10);
+    for (i=0; i<COUNT(nns); i++) {
+        f.nn = nns[i];
+        snprintf(what, sizeof(what), "many blocks: ACON NN %u", nns[i]);
+        CHECK(what, accepted(&f, MISSING_AS_ZERO));
+    }
+}
+
+static void testChangeOpens(void) {
+    resetEcan(2);
+    tableSize = 0;
+    learn(257, 1, CONSUMED);
+    canFilterInit();
+    canFilterChanged();
+    CHECK("changed: filters open", getCanFilterState() == CAN_FILTER_OFF);
+    checkFrames("changed", openFrames, COUNT(openFrames));
+    learn(2000, 3, CONSUMED);
+    pollCanFilter();
+    CHECK("changed: still open before settling", getCanFilterState() == CAN_FILTER_OFF);
+    now += 2*ONE_SECOND;
+    pollCanFilter();
+    CHECK("changed: filtering after settling", getCanFilterState() == ((10 << 8) | 2));
+}
+
+static void testMeteringOpens(void) {
+    resetEcan(2);
+    tableSize = 0;
+    learn(257, 1, CONSUMED);
+    canFilterInit();
+    meteringBus = TRUE;
+    pollCanFilter();
+    CHECK("metering: filters open", getCanFilterState() == CAN_FILTER_OFF);
+    checkFrames("metering", openFrames, COUNT(openFrames));
+    now += 2*ONE_SECOND;
+    pollCanFilter();
+    CHECK("metering: still open", getCanFilterState() == CAN_FILTER_OFF);
+    meteringBus = FALSE;
+    pollCanFilter();
+    CHECK("metering: open until settled", getCanFilterState() == CAN_FILTER_OFF);
+    now += 2*ONE_SECOND;
+    pollCanFilter();
+    CHECK("metering: filtering after metering", getCanFilterState() == ((10 << 8) | 1));
+}
+
+static void testLegacyMode(void) {
+    resetEcan(0);
+    tableSize = 0;
+    learn(257, 1, CONSUMED);
+    canFilterInit();
+    CHECK("legacy mode: not filtering", getCanFilterState() == CAN_FILTER_OFF);
+    CHECK("legacy mode: filters untouched", (RXFCON0 == 0x01) && (SDFLC == 0));
+}
+
+static void testModeTimeout(void) {
+    resetEcan(2);
+    tableSize = 0;
+    learn(257, 1, CONSUMED);
+    modeStuck = TRUE;
+    canFilterInit();
+    CHECK("timeout: not filtering", getCanFilterState() == CAN_FILTER_OFF);
+    CHECK("timeout: failure counted", getCanFilterFailures() == 1);
+    CHECK("timeout: request withdrawn", CANCONbits.REQOP == 0);
+    CHECK("timeout: filters untouched", (RXFCON0 == 0x01) && (SDFLC == 0));
+    CHECK("timeout: gave up in time", now < 2*(10*ONE_MILI_SECOND));
+    modeStuck = FALSE;
+    canFilterChanged();
+    now += 2*ONE_SECOND;
+    pollCanFilter();
+    CHECK("timeout: filtering once the ECAN responds", getCanFilterState() != CAN_FILTER_OFF);
+}
+
+/*
+ * The mixed frame stream. Accessory events come from STREAM_PRODUCERS other
+ * nodes with node numbers from 256 up, either consecutive as FLiM allocates
+ * them or spread out as when they are chosen by hand, with 
+ * STREAM_LEARNED_SHARE of them being the learned events. The rest of the 
+ * stream is accessory events with data, DCC cab traffic and other short
+ * opcodes, RTR self enumeration and the responses to it.
+ */
+#define STREAM_FRAMES           100000
+#define STREAM_PRODUCERS        40
+#define STREAM_LEARNED_SHARE    10      // percent of the accessory events
+
+static DWORD streamSeed;
+static WORD nnSpacing;                  // between the producers' node numbers
+
+static WORD streamRandom(WORD range) {
+    streamSeed = streamSeed * 1103515245 + 12345;
+    return (WORD)((streamSeed >> 16) % range);
+}
+
+static void streamFrame(Frame * f) {
+    WORD r;
+    BYTE t;
+    static const BYTE accessory[] = {OPC_ACON, OPC_ACOF, OPC_ASON, OPC_ASOF};
+    static const BYTE withData[] = {OPC_ACON1, OPC_ACOF2, OPC_ARSON3, OPC_ASON1};
+    static const BYTE others[] = {0x47, 0x47, 0x47, 0x40, 0x21, 0x63, 0xE1, 0x0D, 0xB6, OPC_ASRQ};
+    
+    f->name = "stream";
+    f->sid = 0x10 + streamRandom(0x70);
+    f->extended = FALSE;
+    f->rtr = FALSE;
+    f->en = 1 + streamRandom(32);
+    f->nn = 256 + nnSpacing * streamRandom(STREAM_PRODUCERS);
+    r = streamRandom(100);
+    if (r < 70) {
+        f->opc = accessory[streamRandom(4)];
+        if (streamRandom(100) < STREAM_LEARNED_SHARE) {
+            t = streamRandom(tableSize);
+            f->opc = (table[t].nn == 0) ? OPC_ASON : OPC_ACON;
+            f->nn = table[t].nn;
+            f->en = table[t].en;
+        }
+    } else if (r < 75) {
+        f->opc = withData[streamRandom(4)];
+    } else if (r < 98) {
+        f->opc = others[streamRandom(10)];
+    } else {
+        f->opc = 0;
+        f->rtr = (r == 98);
+        f->sid = 0x21;
+    }
+    f->dlc = f->rtr ? 0 : (f->opc >> 5) + 1;
+}
+
+static BOOL isAccessoryEvent(BYTE opc) {
+    return (opc & 0x96) == 0x90;    // ACON/ACOF/ASON/ASOF with 0 to 3 data bytes
+}
+
+static BOOL isLearned(const Frame * f) {
+    BYTE t;
+    
+    if ( ! isAccessoryEvent(f->opc)) return FALSE;
+    for (t=0; t<tableSize; t++) {
+        if ((table[t].action != NO_ACTION) && (table[t].en == f->en) &&
+                (table[t].nn == ((f->opc & 0x08) ? 0 : f->nn))) return TRUE;
+    }
+    return FALSE;
+}
+
+static void reportStream(const char * name) {
+    DWORD frame;
+    DWORD rejected = 0;
+    DWORD lookupsSaved = 0;
+    DWORD lookups = 0;
+    DWORD learnedLost = 0;
+    Frame f;
+    char what[60];
+    
+    streamSeed = 1;
+    for (frame=0; frame<STREAM_FRAMES; frame++) {
+        streamFrame(&f);
+        if (isAccessoryEvent(f.opc)) lookups++;
+        if ( ! accepted(&f, MISSING_AS_ZERO)) {
+            rejected++;
+            if (isAccessoryEvent(f.opc)) lookupsSaved++;
+            if (isLearned(&f)) learnedLost++;
+        }
+    }
+    printf("%-20s %4u    %5.1f%%      %6.1f      %6.1f    %5.1f%%\n", name, 
+            getCanFilterState() == CAN_FILTER_OFF ? 0 : getCanFilterState() >> 8,
+            100.0 * rejected / STREAM_FRAMES,
+            1000.0 * rejected / STREAM_FRAMES, 1000.0 * lookupsSaved / STREAM_FRAMES,
+            100.0 * lookupsSaved / lookups);
+    snprintf(what, sizeof(what), "stream %s: no learned event rejected", name);
+    CHECK(what, learnedLost == 0);
+}
+
+static void reportFilters(WORD spacing) {
+    BYTE i;
+    static const WORD nns[] = {64, 1000, 5000, 9000, 20000, 40000, 65000};
+    
+    nnSpacing = spacing;
+    printf("%u producers %u NNs apart\n", STREAM_PRODUCERS, spacing);
+    printf("event table            NN  rejected  interrupts     lookups  share of\n");
+    printf("                     bits            saved/1000  saved/1000   lookups\n");
+    resetEcan(2);
+    tableSize = 0;
+    learn(257, 1, CONSUMED);
+    canFilterInit();
+    reportStream("1 node");
+    resetEcan(2);
+    tableSize = 0;
+    for (i=0; i<16; i++) {
+        learn(256 + 3 * (i & 3), 1 + i, CONSUMED);
+    }
+    canFilterInit();
+    reportStream("4 neighbouring nodes");
+    resetEcan(2);
+    tableSize = 0;
+    learn(257, 1, CONSUMED);
+    learn(1000, 5, CONSUMED);
+    learn(2000, 3, NO_ACTION);
+    canFilterInit();
+    reportStream("2 node blocks");
+    resetEcan(2);
+    tableSize = 0;
+    for (i=0; i<COUNT(nns); i++) {
+        learn(nns[i], 1, CONSUMED);
+    }
+    canFilterInit();
+    reportStream("7 node blocks");
+    resetEcan(2);
+    tableSize = 0;
+    learn(257, 1, CONSUMED);
+    learn(0, 7, CONSUMED);
+    canFilterInit();
+    reportStream("a short event");
+}
+
+int main(void) {
+    testLongEvents();
+    testShortEvent();
+    testManyBlocks();
+    testChangeOpens();
+    testMeteringOpens();
+    testLegacyMode();
+    testModeTimeout();
+    reportFilters(1);
+    reportFilters(97);
+    return testResult("canFilter");
+}
@@ -0,0 +1,287 @@
+/*
+ Routines for CBUS FLiM operations - part of CBUS libraries for PIC 18F
+  This work is licensed under the:
+      Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International License.
+   To view a copy of this license, visit:
+      http://creativecommons.org/licenses/by-nc-sa/4.0/
+   or send a letter to Creative Commons, PO Box 1866, Mountain View, CA 94042, USA.
+   License summary:
+    You are free to:
+      Share, copy and redistribute the material in any medium or format
+      Adapt, remix, transform, and build upon the material
+    The licensor cannot revoke these freedoms as long as you follow the license terms.
+    Attribution : You must give appropriate credit, provide a link to the license,
+                   and indicate if changes were made. You may do so in any reasonable manner,
+                   but not in any way that suggests the licensor endorses you or your use.
+    NonCommercial : You may not use the material for commercial purposes. **(see note below)
+    ShareAlike : If you remix, transform, or build upon the material, you must distribute
+                  your contributions under the same license as the original.
+    No additional restrictions : You may not apply legal terms or technological measures that
+                                  legally restrict others from doing anything the license permits.
+   ** For commercial use, please contact the original copyright holder(s) to agree licensing terms
+**************************************************************************************************************
+	The FLiM routines have no code or definitions that are specific to any
+	module, so they can be used to provide FLiM facilities for any module 
+	using these libraries.
+	
+*/ 
+/*
+ * File:   test_producerIndex.c
+ *
+ * Created on 19 October 2026, 09:10
+ *
+ * Host test of producerIndex.c. The lookup sendProducedEvent() does in 
+ * CBUSlib events.c is copied here and for many random event tables every
+ * producer action is sent both ways. Both must send the same event, or both
+ * nothing. Tables have duplicate actions, entries which are not valid and 
+ * actions with and without a default event, some of which have an EN of 0.
+ * 
+ * It also checks that the table is searched once it has changed, that the 
+ * index is rebuilt after PRODUCER_SETTLE_TIME, that full transmit buffers 
+ * are reported as PRODUCE_BUSY and that the bus load meter and the trace 
+ * are given the frame which was sent.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "devincs.h"
+#include "module.h"
+#include "events.h"
+#include "cbus.h"
+#include "TickTime.h"
+#include "producerIndex.h"
+#include "test.h"
+
+#define TRIALS      200
+
+/*
+ * The event table seen through the CBUSlib functions producerIndex.c uses
+ */
+typedef struct {
+    BOOL valid;
+    WORD nn;
+    WORD en;
+    BYTE ev0;
+} Entry;
+
+static Entry table[NUM_EVENTS];
+static DWORD now;
+static BOOL buffersFull;
+static int evReads;             // EV#0 reads, searching the table
+static int traced;              // frames given to the trace
+static BYTE tracedFrame[5];
+static BYTE loadOpc;            // opcode last given to the bus load meter
+
+/*
+ * The last event sent
+ */
+static int sends;
+static WORD sentNN;
+static WORD sentEN;
+static BOOL sentOn;
+
+Event producedEvent;
+WORD nodeID = 300;
+
+BOOL validStart(BYTE tableIndex) {
+    return table[tableIndex].valid;
+}
+
+int getEv(BYTE tableIndex, BYTE evIndex) {
+    evReads++;
+    return table[tableIndex].ev0;
+}
+
+void busLoadFrame(BYTE opc, BOOL transmitted) {
+    loadOpc = opc;
+}
+
+void traceFrame(BYTE * msg, BOOL transmitted) {
+    BYTE i;
+    
+    traced++;
+    for (i=0; i<5; i++) {
+        tracedFrame[i] = msg[i];
+    }
+}
+
+/**
+ * Check that the trace holds the frame cbusSendEvent() puts on the bus.
+ * @param nn the node number sent
+ * @param en the event number sent
+ * @param on TRUE for an ON event
+ * @return TRUE if the frame is right
+ */
+static BOOL tracedAsSent(WORD nn, WORD en, BOOL on) {
+    BYTE opc = (nn == 0) ? (on ? OPC_ASON : OPC_ASOF) : (on ? OPC_ACON : OPC_ACOF);
+    
+    if (nn == 0) nn = nodeID;
+    return (tracedFrame[0] == opc) && (loadOpc == opc) 
+            && (tracedFrame[1] == (nn >> 8)) && (tracedFrame[2] == (nn & 0xFF))
+            && (tracedFrame[3] == (en >> 8)) && (tracedFrame[4] == (en & 0xFF));
+}
+
+WORD getNN(BYTE tableIndex) {
+    return table[tableIndex].nn;
+}
+
+WORD getEN(BYTE tableIndex) {
+    return table[tableIndex].en;
+}
+
+BOOL cbusSendEvent(BYTE cbusPri, WORD nn, WORD en, BOOL on) {
+    if (buffersFull) return FALSE;
+    sends++;
+    sentNN = nn;
+    sentEN = en;
+    sentOn = on;
+    return TRUE;
+}
+
+DWORD tickGet(void) {
+    return now;
+}
+
+DWORD tickTimeSince(TickValue t) {
+    return tickGet() - t.Val;
+}
+
+/**
+ * Stand in for the defaults of mioEvents.c. Every third action has no 
+ * default, every fifth a default with an EN of 0.
+ */
+BOOL getDefaultProducedEvent(PRODUCER_ACTION_T paction) {
+    if (paction % 3 == 0) return FALSE;
+    producedEvent.NN = nodeID;
+    producedEvent.EN = (paction % 5 == 0) ? 0 : paction + 100;
+    return TRUE;
+}
+
+/**
+ * Copy of the produced event lookup of CBUSlib events.c.
+ */
+BOOL sendProducedEvent(PRODUCER_ACTION_T paction, BOOL on) {
+    int tableIndex;
+    
+    for (tableIndex=0; tableIndex<NUM_EVENTS; tableIndex++) {
+        if (validStart(tableIndex) && (getEv(tableIndex, 0) == paction)) {
+            producedEvent.NN = getNN(tableIndex);
+            producedEvent.EN = getEN(tableIndex);
+            break;
+        }
+    }
+    if ((tableIndex == NUM_EVENTS) && ( ! getDefaultProducedEvent(paction))) {
+        return TRUE;
+    }
+    if (producedEvent.EN == 0) {
+        return TRUE;
+    }
+    return cbusSendEvent(0, producedEvent.NN, producedEvent.EN, on);
+}
+
+/**
+ * Fill the event table with a random number of entries. About half the 
+ * actions appear and some more than once.
+ */
+static void randomTable(void) {
+    int i;
+    
+    for (i=0; i<NUM_EVENTS; i++) {
+        table[i].valid = (rand() % 4) != 0;
+        table[i].nn = (rand() % 8 == 0) ? 0 : (rand() & 0xFFFF);    // some short events
+        table[i].en = 1 + rand() % 1000;
+        table[i].ev0 = rand() % (NUM_PRODUCER_ACTIONS + 10);
+        if (rand() % 8 == 0) {
+            table[i].valid = FALSE;     // a mostly empty table
+        }
+    }
+}
+
+/**
+ * Send every action using the index and using the copy of the CBUSlib 
+ * lookup and compare the events sent. NO_ACTION is never produced.
+ */
+static void compareAll(void) {
+    int action;
+    int on;
+    BYTE result;
+    int indexSends;
+    WORD nn;
+    WORD en;
+    
+    for (action=NO_ACTION+1; action<NUM_PRODUCER_ACTIONS+10; action++) {
+        on = action & 1;
+        sends = 0;
+        evReads = 0;
+        traced = 0;
+        result = producerIndexSend((PRODUCER_ACTION_T)action, on);
+        indexSends = sends;
+        nn = sentNN;
+        en = sentEN;
+        if (action < NUM_PRODUCER_ACTIONS) {
+            CHECK("an indexed action doesn't search the table", evReads == 0);
+        }
+        CHECK("the result says whether an event was sent", (result == PRODUCE_SENT) == (indexSends != 0));
+        CHECK("each event sent is traced", traced == indexSends);
+        if (indexSends) {
+            CHECK("the trace and bus load have the frame sent", tracedAsSent(nn, en, on));
+        }
+        sends = 0;
+        sendProducedEvent((PRODUCER_ACTION_T)action, on);
+        CHECK("the index and CBUSlib both send or both do not", indexSends == sends);
+        if (sends && indexSends) {
+            CHECK("the index sends the event CBUSlib would", (nn == sentNN) && (en == sentEN));
+            CHECK("the index sends ON or OFF as asked", sentOn == on);
+        }
+    }
+}
+
+int main(void) {
+    int trial;
+    BYTE i;
+    
+    srand(4);
+    for (trial=0; trial<TRIALS; trial++) {
+        randomTable();
+        producerIndexInit();
+        compareAll();
+    }
+    
+    // a change stops the index being used until it has settled
+    randomTable();
+    producerIndexInit();
+    for (i=0; i<NUM_EVENTS; i++) {
+        if (table[i].valid && (table[i].ev0 > NO_ACTION) && (table[i].ev0 < NUM_PRODUCER_ACTIONS)) break;
+    }
+    CHECK("the table produces an event", i < NUM_EVENTS);
+    producerIndexChanged();
+    table[i].en = 2000;
+    evReads = 0;
+    sends = 0;
+    producerIndexSend(table[i].ev0, TRUE);
+    CHECK("a changed table is searched", evReads > 0);
+    CHECK("the search finds the changed event", (sends == 1) && (sentEN == 2000));
+    now += ONE_SECOND / 2;
+    pollProducerIndex();
+    evReads = 0;
+    producerIndexSend(table[i].ev0, TRUE);
+    CHECK("the index is not rebuilt while learning", evReads > 0);
+    now += ONE_SECOND;
+    pollProducerIndex();
+    evReads = 0;
+    sends = 0;
+    producerIndexSend(table[i].ev0, TRUE);
+    CHECK("the index is rebuilt once learning has finished", evReads == 0);
+    CHECK("the rebuilt index has the changed event", (sends == 1) && (sentEN == 2000));
+    compareAll();
+    
+    // full transmit buffers
+    buffersFull = TRUE;
+    sends = 0;
+    CHECK("full buffers are busy", producerIndexSend(table[i].ev0, TRUE) == PRODUCE_BUSY);
+    CHECK("nothing is sent when the buffers are full", sends == 0);
+    buffersFull = FALSE;
+    CHECK("an action with no event has nothing to send", producerIndexSend(NUM_PRODUCER_ACTIONS-1, TRUE) != PRODUCE_BUSY);
+    
+    return testResult("producerIndex");
+}
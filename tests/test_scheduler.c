@@ -0,0 +1,237 @@
+/*
+ Routines for CBUS FLiM operations - part of CBUS libraries for PIC 18F
+  This work is licensed under the:
+      Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International License.
+   To view a copy of this license, visit:
+      http://creativecommons.org/licenses/by-nc-sa/4.0/
+   or send a letter to Creative Commons, PO Box 1866, Mountain View, CA 94042, USA.
+   License summary:
+    You are free to:
+      Share, copy and redistribute the material in any medium or format
+      Adapt, remix, transform, and build upon the material
+    The licensor cannot revoke these freedoms as long as you follow the license terms.
+    Attribution : You must give appropriate credit, provide a link to the license,
+                   and indicate if changes were made. You may do so in any reasonable manner,
+                   but not in any way that suggests the licensor endorses you or your use.
+    NonCommercial : You may not use the material for commercial purposes. **(see note below)
+    ShareAlike : If you remix, transform, or build upon the material, you must distribute
+                  your contributions under the same license as the original.
+    No additional restrictions : You may not apply legal terms or technological measures that
+                                  legally restrict others from doing anything the license permits.
+   ** For commercial use, please contact the original copyright holder(s) to agree licensing terms
+**************************************************************************************************************
+	The FLiM routines have no code or definitions that are specific to any
+	module, so they can be used to provide FLiM facilities for any module 
+	using these libraries.
+	
+*/ 
+/*
+ * File:   test_scheduler.c
+ *
+ * Created on 19 October 2026, 10:30
+ *
+ * Host test of scheduler.c. The tick is simulated and each job advances it
+ * by its run time. Checks that:
+ *  - runs stay on their deadlines however long the jobs and loop passes take
+ *  - a task more than a period late runs once, skips the missed slots and 
+ *    stays on its phase
+ *  - tasks run in phase order and, when due together, in task number order
+ *  - the tick wrapping and tasks not started or set up are handled
+ */
+
+#include <stdio.h>
+#include "devincs.h"
+#include "module.h"
+#include "scheduler.h"
+#include "test.h"
+
+#define MAX_RUNS    64
+
+static DWORD now;
+static DWORD runTime;           // ticks each job takes
+
+/*
+ * Record of the runs
+ */
+static int runs;
+static BYTE runIds[MAX_RUNS];
+static DWORD runTicks[MAX_RUNS];
+static int runCount[NUM_TASKS];
+
+#ifdef PROFILE
+void profileBegin(BYTE job) {
+}
+
+void profileEnd(BYTE job) {
+}
+#endif
+
+static void record(BYTE id) {
+    if (runs < MAX_RUNS) {
+        runIds[runs] = id;
+        runTicks[runs] = now;
+    }
+    runs++;
+    runCount[id]++;
+    now += runTime;
+}
+
+static void job0(void) { record(0); }
+static void job1(void) { record(1); }
+static void job2(void) { record(2); }
+
+static void (*jobs[3])(void) = {job0, job1, job2};
+
+/**
+ * Clear the task table and the record of runs.
+ */
+static void reset(void) {
+    BYTE id;
+    
+    for (id=0; id<NUM_TASKS; id++) {
+        schedulerSetTask(id, NULL, 0, 0);
+        runCount[id] = 0;
+    }
+    schedulerTakeRunTasks();
+    runs = 0;
+    runTime = 0;
+}
+
+/**
+ * Run the main loop until a tick, each pass taking a number of ticks.
+ * @param until the tick to stop at
+ * @param pass ticks taken by each pass of the loop besides the jobs
+ */
+static void loop(DWORD until, DWORD pass) {
+    while ((DWORD)(now - until) & 0x80000000UL) {
+        schedulerRun(now);
+        now += pass;
+    }
+}
+
+/**
+ * A job taking most of its period and an uneven loop must still give one 
+ * run per period, each within a pass of its deadline.
+ */
+static void testDrift(void) {
+    DWORD start;
+    DWORD lateness;
+    DWORD maxLateness = 0;
+    int r;
+    
+    reset();
+    now = 1000;
+    start = now;
+    runTime = 60;
+    schedulerSetTask(0, job0, 100, 5);
+    schedulerStart(now);
+    loop(start + 100000, 7);
+    CHECK("one run per period with a long job", (runCount[0] >= 999) && (runCount[0] <= 1000));
+    for (r=0; r<MAX_RUNS; r++) {
+        lateness = runTicks[r] - (start + 5 + r*100);
+        if (lateness > maxLateness) maxLateness = lateness;
+    }
+    CHECK("each run is within a pass of its deadline", maxLateness < 7);
+    CHECK("no slots missed", schedulerMissed(0) == 0);
+    
+    // the old scheme, last run reset to the end of the job, would give 
+    // about 100000/(100+60) runs
+    printf("scheduler: %d runs of a 100 tick task taking 60 ticks in 100000 ticks, "
+            "latest %lu ticks after its deadline\n", runCount[0], (unsigned long)maxLateness);
+}
+
+/**
+ * A task held up for several periods runs once then carries on on its phase.
+ */
+static void testMissedSlots(void) {
+    DWORD start;
+    int before;
+    
+    reset();
+    now = 5000;
+    start = now;
+    schedulerSetTask(0, job0, 100, 20);
+    schedulerStart(now);
+    loop(start + 1000, 1);
+    before = runCount[0];
+    CHECK("runs up to the hold up", before == 10);
+    now = start + 1000 + 350;       // held up for 3.5 periods
+    schedulerRun(now);
+    CHECK("a late task runs once", runCount[0] == before + 1);
+    CHECK("the missed slots are counted", schedulerMissed(0) == 3);
+    CHECK("not due again straight away", ! schedulerDue(0, now));
+    runs = 0;
+    loop(start + 1600, 1);
+    CHECK("back on its phase", (runs > 0) && (runTicks[0] == start + 20 + 1400));
+    CHECK("no more slots missed", schedulerMissed(0) == 3);
+}
+
+/**
+ * Tasks with the same period run in phase order, and in task number order 
+ * when due on the same pass.
+ */
+static void testPhaseOrder(void) {
+    BYTE id;
+    
+    reset();
+    now = 0;
+    schedulerSetTask(0, job0, 50, 30);
+    schedulerSetTask(1, job1, 50, 10);
+    schedulerSetTask(2, job2, 50, 20);
+    schedulerStart(now);
+    loop(100, 1);
+    CHECK("each task runs twice", runs == 6);
+    CHECK("first in phase order", (runIds[0] == 1) && (runIds[1] == 2) && (runIds[2] == 0));
+    CHECK("each on its phase", (runTicks[0] == 10) && (runTicks[1] == 20) && (runTicks[2] == 30));
+    CHECK("then a period later", (runTicks[3] == 60) && (runTicks[4] == 70) && (runTicks[5] == 80));
+    
+    reset();
+    now = 0;
+    for (id=0; id<3; id++) {
+        schedulerSetTask(2-id, jobs[2-id], 50, 0);
+    }
+    schedulerStart(now);
+    schedulerRun(now);
+    CHECK("tasks due together run in task number order", 
+            (runs == 3) && (runIds[0] == 0) && (runIds[1] == 1) && (runIds[2] == 2));
+    CHECK("run tasks are recorded", schedulerTakeRunTasks() == 0x07);
+    CHECK("and cleared when taken", schedulerTakeRunTasks() == 0);
+}
+
+/**
+ * Deadlines across the tick wrapping, a task run on every pass and tasks 
+ * which are not started or not set up.
+ */
+static void testEdges(void) {
+    reset();
+    now = 0xFFFFFF00;
+    schedulerSetTask(0, job0, 100, 0);
+    schedulerStart(now);
+    loop(0x00000200, 1);
+    CHECK("runs across the tick wrapping", runCount[0] == 8);
+    CHECK("no slots missed across the wrapping", schedulerMissed(0) == 0);
+    
+    reset();
+    now = 0;
+    schedulerSetTask(0, job0, 0, 0);
+    schedulerSetTask(1, job1, 10, 0);
+    schedulerStartTask(0, now);
+    loop(100, 1);
+    CHECK("a zero period runs on every pass", runCount[0] == 100);
+    CHECK("a task not started doesn't run", runCount[1] == 0);
+    CHECK("a task not started isn't due", ! schedulerDue(1, now));
+    CHECK("enabled tasks", schedulerEnabledTasks() == 0x03);
+    
+    schedulerSetPeriod(0, 25);
+    runs = 0;
+    loop(200, 1);
+    CHECK("a new period takes effect", runCount[0] == 100 + 5);
+}
+
+int main(void) {
+    testDrift();
+    testMissedSlots();
+    testPhaseOrder();
+    testEdges();
+    return testResult("scheduler");
+}
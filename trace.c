@@ -0,0 +1,171 @@
+/*
+ Routines for CBUS FLiM operations - part of CBUS libraries for PIC 18F
+  This work is licensed under the:
+      Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International License.
+   To view a copy of this license, visit:
+      http://creativecommons.org/licenses/by-nc-sa/4.0/
+   or send a letter to Creative Commons, PO Box 1866, Mountain View, CA 94042, USA.
+   License summary:
+    You are free to:
+      Share, copy and redistribute the material in any medium or format
+      Adapt, remix, transform, and build upon the material
+    The licensor cannot revoke these freedoms as long as you follow the license terms.
+    Attribution : You must give appropriate credit, provide a link to the license,
+                   and indicate if changes were made. You may do so in any reasonable manner,
+                   but not in any way that suggests the licensor endorses you or your use.
+    NonCommercial : You may not use the material for commercial purposes. **(see note below)
+    ShareAlike : If you remix, transform, or build upon the material, you must distribute
+                  your contributions under the same license as the original.
+    No additional restrictions : You may not apply legal terms or technological measures that
+                                  legally restrict others from doing anything the license permits.
+   ** For commercial use, please contact the original copyright holder(s) to agree licensing terms
+**************************************************************************************************************
+	The FLiM routines have no code or definitions that are specific to any
+	module, so they can be used to provide FLiM facilities for any module 
+	using these libraries.
+	
+*/ 
+/*
+ * File:   trace.c
+ *
+ * Created on 18 October 2026, 23:00
+ *
+ * Keeps the last TRACE_SIZE CAN frames received and sent, with the time and
+ * direction, so that what a module actually saw can be looked at after a 
+ * problem on the layout. 
+ * 
+ * Recording stops when the trace is frozen, either by a request or when a 
+ * fault is detected, so the frames leading up to the fault are kept. The 
+ * trace is dumped with RDGN for the DIAG_TRACE service and is answered with
+ * a stream of DGN, 6 per frame. A request for TRACE_RESUME clears it and 
+ * starts recording again.
+ * 
+ * Received frames are recorded as taken from the receive buffers. Produced 
+ * events are looked up and sent by CBUSlib so they are recorded with the 
+ * producer action in the last data byte rather than the event number.
+ */
+
+#include "module.h"
+#include "TickTime.h"
+#include "diagnostics.h"
+#include "trace.h"
+
+#ifdef TRACE
+
+typedef struct {
+    WORD time;
+    BYTE frame[8];      // opcode and data, unused bytes are 0
+    BOOL transmitted;
+} TraceEntry;
+
+static TraceEntry trace[TRACE_SIZE];
+static BYTE traceNext;      // where the next frame goes
+static BYTE traceCount;     // frames held
+static BYTE frozen;         // TRACE_RUNNING or why recording stopped
+
+/**
+ * Clear the trace and start recording.
+ */
+void traceInit(void) {
+    traceNext = 0;
+    traceCount = 0;
+    frozen = TRACE_RUNNING;
+}
+
+/**
+ * Record a frame.
+ * @param msg the CBUS message starting at the opcode
+ * @param transmitted TRUE if sent by this module, FALSE if received
+ */
+void traceFrame(BYTE * msg, BOOL transmitted) {
+    BYTE i;
+    BYTE len;
+    
+    if (frozen != TRACE_RUNNING) return;
+    
+    trace[traceNext].time = (WORD)(tickGet() >> 4);
+    trace[traceNext].transmitted = transmitted;
+    len = (msg[0] >> 5) + 1;
+    for (i=0; i<8; i++) {
+        trace[traceNext].frame[i] = (i < len) ? msg[i] : 0;
+    }
+    traceNext++;
+    if (traceNext >= TRACE_SIZE) {
+        traceNext = 0;
+    }
+    if (traceCount < TRACE_SIZE) {
+        traceCount++;
+    }
+}
+
+/**
+ * Stop recording. The first reason is kept until the trace is resumed.
+ * @param reason the TRACE_FROZEN_xxx reason
+ */
+void traceFreeze(BYTE reason) {
+    if (frozen == TRACE_RUNNING) {
+        frozen = reason;
+    }
+}
+
+/**
+ * Handle the commands in an RDGN request for the DIAG_TRACE service.
+ * @param code the requested code
+ * @return the code to be answered
+ */
+BYTE traceRequest(BYTE code) {
+    switch (code) {
+        case DIAG_ALL_CODES:
+            // stop the trace changing whilst it is dumped
+            traceFreeze(TRACE_FROZEN_DEMAND);
+            return code;
+        case TRACE_FREEZE:
+            traceFreeze(TRACE_FROZEN_DEMAND);
+            return TRACE_STATUS;
+        case TRACE_RESUME:
+            traceInit();
+            return TRACE_STATUS;
+    }
+    return code;
+}
+
+/**
+ * Get a DIAG_TRACE diagnostic.
+ * @param code TRACE_STATUS or the frame and word, see trace.h
+ * @param value where to put the value
+ * @return TRUE if a valid code
+ */
+BOOL getTraceDiagnostic(BYTE code, WORD * value) {
+    BYTE entry;
+    BYTE word;
+    TraceEntry * t;
+    
+    if (code == TRACE_STATUS) {
+        *value = ((WORD)frozen << 8) | traceCount;
+        return TRUE;
+    }
+    if ((code == 0) || (code > traceCount * TRACE_WORDS)) return FALSE;
+    code--;
+    entry = code / TRACE_WORDS;
+    word = code % TRACE_WORDS;
+    // oldest first
+    entry += traceNext + TRACE_SIZE - traceCount;
+    if (entry >= TRACE_SIZE) {
+        entry -= TRACE_SIZE;
+    }
+    t = &(trace[entry]);
+    if (word == 0) {
+        *value = t->time;
+    } else if (word == 1) {
+        *value = t->transmitted ? 0x8000 | t->frame[0] : t->frame[0];
+    } else {
+        word = 2*word - 3;  // first data byte in this word
+        *value = (WORD)t->frame[word] << 8;
+        if (word < 7) {
+            *value |= t->frame[word+1];
+        }
+    }
+    return TRUE;
+}
+
+#endif
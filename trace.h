@@ -0,0 +1,85 @@
+/*
+ Routines for CBUS FLiM operations - part of CBUS libraries for PIC 18F
+  This work is licensed under the:
+      Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International License.
+   To view a copy of this license, visit:
+      http://creativecommons.org/licenses/by-nc-sa/4.0/
+   or send a letter to Creative Commons, PO Box 1866, Mountain View, CA 94042, USA.
+   License summary:
+    You are free to:
+      Share, copy and redistribute the material in any medium or format
+      Adapt, remix, transform, and build upon the material
+    The licensor cannot revoke these freedoms as long as you follow the license terms.
+    Attribution : You must give appropriate credit, provide a link to the license,
+                   and indicate if changes were made. You may do so in any reasonable manner,
+                   but not in any way that suggests the licensor endorses you or your use.
+    NonCommercial : You may not use the material for commercial purposes. **(see note below)
+    ShareAlike : If you remix, transform, or build upon the material, you must distribute
+                  your contributions under the same license as the original.
+    No additional restrictions : You may not apply legal terms or technological measures that
+                                  legally restrict others from doing anything the license permits.
+   ** For commercial use, please contact the original copyright holder(s) to agree licensing terms
+**************************************************************************************************************
+	The FLiM routines have no code or definitions that are specific to any
+	module, so they can be used to provide FLiM facilities for any module 
+	using these libraries.
+	
+*/ 
+/* 
+ * File:   trace.h
+ *
+ * Created on 18 October 2026, 23:00
+ *
+ * A RAM trace of the last CAN frames received and sent.
+ * Only compiled when TRACE is defined in module.h.
+ */
+
+#ifndef TRACE_H
+#define	TRACE_H
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+#include "GenericTypeDefs.h"
+
+/*
+ * Why the trace stopped recording.
+ */
+#define TRACE_RUNNING           0
+#define TRACE_FROZEN_DEMAND     1   // by an RDGN request
+#define TRACE_FROZEN_RX         2   // CAN receive buffers overflowed
+#define TRACE_FROZEN_TX         3   // a produced event was lost
+
+/*
+ * Codes for the DIAG_TRACE diagnostic service. Codes 1 to 6*TRACE_SIZE are 
+ * the recorded frames, oldest first, 6 codes per frame:
+ *  +0 time in units of 256us
+ *  +1 bit 15 set if sent by this module, low byte the opcode
+ *  +2 to +5 the data bytes, two per code
+ * Requesting code 0 freezes the trace and dumps all of it.
+ */
+#define TRACE_WORDS             6
+#define TRACE_STATUS            0xF0    // high byte TRACE_RUNNING or why frozen, low byte frames held
+#define TRACE_FREEZE            0xFE    // request only, freeze and reply with TRACE_STATUS
+#define TRACE_RESUME            0xFF    // request only, clear and restart and reply with TRACE_STATUS
+
+#ifdef TRACE
+#define TRACE_FRAME(msg, transmitted)   traceFrame(msg, transmitted)
+#define TRACE_FAULT(reason)             traceFreeze(reason)
+#else
+#define TRACE_FRAME(msg, transmitted)
+#define TRACE_FAULT(reason)
+#endif
+
+extern void traceInit(void);
+extern void traceFrame(BYTE * msg, BOOL transmitted);
+extern void traceFreeze(BYTE reason);
+extern BYTE traceRequest(BYTE code);
+extern BOOL getTraceDiagnostic(BYTE code, WORD * value);
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif	/* TRACE_H */
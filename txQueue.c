@@ -0,0 +1,216 @@
+/*
+ Routines for CBUS FLiM operations - part of CBUS libraries for PIC 18F
+  This work is licensed under the:
+      Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International License.
+   To view a copy of this license, visit:
+      http://creativecommons.org/licenses/by-nc-sa/4.0/
+   or send a letter to Creative Commons, PO Box 1866, Mountain View, CA 94042, USA.
+   License summary:
+    You are free to:
+      Share, copy and redistribute the material in any medium or format
+      Adapt, remix, transform, and build upon the material
+    The licensor cannot revoke these freedoms as long as you follow the license terms.
+    Attribution : You must give appropriate credit, provide a link to the license,
+                   and indicate if changes were made. You may do so in any reasonable manner,
+                   but not in any way that suggests the licensor endorses you or your use.
+    NonCommercial : You may not use the material for commercial purposes. **(see note below)
+    ShareAlike : If you remix, transform, or build upon the material, you must distribute
+                  your contributions under the same license as the original.
+    No additional restrictions : You may not apply legal terms or technological measures that
+                                  legally restrict others from doing anything the license permits.
+   ** For commercial use, please contact the original copyright holder(s) to agree licensing terms
+**************************************************************************************************************
+	The FLiM routines have no code or definitions that are specific to any
+	module, so they can be used to provide FLiM facilities for any module 
+	using these libraries.
+	
+*/ 
+/*
+ * File:   txQueue.c
+ *
+ * Created on 18 October 2026, 19:40
+ *
+ * Produced events are sent straight away if the transmit buffers have room 
+ * and nothing is already waiting. Otherwise they are put in the queue for 
+ * their priority class and sent by pollTxQueue() as the transmit buffers 
+ * empty. The classes are drained highest priority first so input changes
+ * overtake servo events which in turn overtake a SOD.
+ * 
+ * Each queue entry is the producer action with the on/off state in the top 
+ * bit. Producer actions are all less than 128.
+ * 
+ * CBUSlib gives no way to tell a full transmit buffer from any other reason
+ * a send was refused. At 125kbit/s the transmit buffers empty in a few 
+ * milliseconds so if nothing has been sent for TX_STALL_TIME the event at
+ * the head is dropped and counted as a send failure rather than blocking 
+ * the queue for ever.
+ */
+
+#include "module.h"
+#include "queue.h"
+#include "events.h"
+#include "TickTime.h"
+#include "txQueue.h"
+#include "trace.h"
+#include "producerIndex.h"
+
+#define TX_ON_FLAG      0x80
+#define TX_STALL_TIME   (ONE_SECOND/2)
+
+static CONSUMER_ACTION_T txInputQueueBuf[TX_INPUT_QUEUE_SIZE];
+static CONSUMER_ACTION_T txOutputQueueBuf[TX_OUTPUT_QUEUE_SIZE];
+static CONSUMER_ACTION_T txSodQueueBuf[TX_SOD_QUEUE_SIZE];
+static Queue txQueues[NUM_TX_PRIORITIES];
+
+static WORD overflows;
+static WORD deferred;
+static BYTE maxDepth;
+static WORD sendFailures;
+static BOOL stalled;
+static TickValue stallTime;
+
+// forward declarations
+static BYTE sendEvent(PRODUCER_ACTION_T action, BOOL on);
+
+/**
+ * Initialise the transmit queues.
+ */
+void txQueueInit(void) {
+    unsigned char p;
+    
+    txQueues[TX_PRIORITY_INPUT].size = TX_INPUT_QUEUE_SIZE;
+    txQueues[TX_PRIORITY_INPUT].queue = txInputQueueBuf;
+    txQueues[TX_PRIORITY_OUTPUT].size = TX_OUTPUT_QUEUE_SIZE;
+    txQueues[TX_PRIORITY_OUTPUT].queue = txOutputQueueBuf;
+    txQueues[TX_PRIORITY_SOD].size = TX_SOD_QUEUE_SIZE;
+    txQueues[TX_PRIORITY_SOD].queue = txSodQueueBuf;
+    for (p=0; p<NUM_TX_PRIORITIES; p++) {
+        txQueues[p].readIdx = 0;
+        txQueues[p].writeIdx = 0;
+    }
+    overflows = 0;
+    deferred = 0;
+    maxDepth = 0;
+    sendFailures = 0;
+    stalled = FALSE;
+}
+
+/**
+ * Send a produced event, or queue it if it cannot be sent yet.
+ * @param action the producer action
+ * @param on TRUE (any non zero value) for an ON event
+ * @param priority the TX_PRIORITY_xxx class
+ * @return FALSE if the queue was full and the event has been lost
+ */
+BOOL queueProducedEvent(PRODUCER_ACTION_T action, BOOL on, unsigned char priority) {
+    unsigned char p;
+    unsigned char depth = 0;
+    
+    for (p=0; p<NUM_TX_PRIORITIES; p++) {
+        depth += quantity(&(txQueues[p]));
+    }
+    // only send directly if nothing is waiting otherwise events could be reordered
+    if ((depth == 0) && (sendEvent(action, on) != PRODUCE_BUSY)) {
+        return TRUE;
+    }
+    if ( ! push(&(txQueues[priority]), on ? (action | TX_ON_FLAG) : action)) {
+        if (overflows != 0xFFFF) overflows++;
+        TRACE_FAULT(TRACE_FROZEN_TX);
+        return FALSE;
+    }
+    if (deferred != 0xFFFF) deferred++;
+    depth++;
+    if (depth > maxDepth) maxDepth = depth;
+    return TRUE;
+}
+
+/**
+ * Send or queue a produced event which may have its sense inverted.
+ * @param action the producer action
+ * @param state the state to be reported
+ * @param invert whether the event is inverted
+ * @param priority the TX_PRIORITY_xxx class
+ * @return FALSE if the queue was full and the event has been lost
+ */
+BOOL queueInvertedProducedEvent(PRODUCER_ACTION_T action, BOOL state, BOOL invert, unsigned char priority) {
+    return queueProducedEvent(action, invert?!state:state, priority);
+}
+
+/**
+ * Check if there is room to queue an event. Used by SOD so that it can wait
+ * for space rather than lose events.
+ * @param priority the TX_PRIORITY_xxx class
+ * @return TRUE if an event can be queued
+ */
+BOOL txQueueHasSpace(unsigned char priority) {
+    return quantity(&(txQueues[priority])) < txQueues[priority].size-1;
+}
+
+/**
+ * Send the waiting events, highest priority first, until the transmit buffers
+ * are full. An event which still cannot be sent after nothing has gone for
+ * TX_STALL_TIME is dropped. Called from the main loop.
+ */
+void pollTxQueue(void) {
+    unsigned char p;
+    CONSUMER_ACTION_T a;
+    
+    for (p=0; p<NUM_TX_PRIORITIES; p++) {
+        while (quantity(&(txQueues[p])) > 0) {
+            a = peek(&(txQueues[p]), 0);
+            if (sendEvent(a & ~TX_ON_FLAG, a & TX_ON_FLAG) == PRODUCE_BUSY) {
+                if ( ! stalled) {
+                    stalled = TRUE;
+                    stallTime.Val = tickGet();
+                    return;
+                }
+                if (tickTimeSince(stallTime) < TX_STALL_TIME) {
+                    return;     // transmit buffers full
+                }
+                if (sendFailures != 0xFFFF) sendFailures++;
+                stallTime.Val = tickGet();
+                pop(&(txQueues[p]));
+                return;
+            }
+            stalled = FALSE;
+            pop(&(txQueues[p]));
+        }
+    }
+    stalled = FALSE;
+}
+
+/**
+ * Try to put a produced event into a CAN transmit buffer. The frame sent is
+ * recorded by the bus load meter and the trace in producerIndex.c.
+ * @param action the producer action
+ * @param on TRUE (any non zero value) for an ON event
+ * @return PRODUCE_SENT, PRODUCE_BUSY if the transmit buffers are full or 
+ * PRODUCE_NOTHING if the action has no event
+ */
+static BYTE sendEvent(PRODUCER_ACTION_T action, BOOL on) {
+    return SEND_PRODUCED_EVENT(action, on);
+}
+
+/**
+ * Get a DIAG_TX diagnostic.
+ * @param code the TX_xxx code
+ * @param value where to put the value
+ * @return TRUE if a valid code
+ */
+BOOL getTxDiagnostic(BYTE code, WORD * value) {
+    switch (code) {
+        case TX_OVERFLOWS:
+            *value = overflows;
+            return TRUE;
+        case TX_DEFERRED:
+            *value = deferred;
+            return TRUE;
+        case TX_MAX_DEPTH:
+            *value = maxDepth;
+            return TRUE;
+        case TX_SEND_FAILURES:
+            *value = sendFailures;
+            return TRUE;
+    }
+    return FALSE;
+}
@@ -0,0 +1,73 @@
+/*
+ Routines for CBUS FLiM operations - part of CBUS libraries for PIC 18F
+  This work is licensed under the:
+      Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International License.
+   To view a copy of this license, visit:
+      http://creativecommons.org/licenses/by-nc-sa/4.0/
+   or send a letter to Creative Commons, PO Box 1866, Mountain View, CA 94042, USA.
+   License summary:
+    You are free to:
+      Share, copy and redistribute the material in any medium or format
+      Adapt, remix, transform, and build upon the material
+    The licensor cannot revoke these freedoms as long as you follow the license terms.
+    Attribution : You must give appropriate credit, provide a link to the license,
+                   and indicate if changes were made. You may do so in any reasonable manner,
+                   but not in any way that suggests the licensor endorses you or your use.
+    NonCommercial : You may not use the material for commercial purposes. **(see note below)
+    ShareAlike : If you remix, transform, or build upon the material, you must distribute
+                  your contributions under the same license as the original.
+    No additional restrictions : You may not apply legal terms or technological measures that
+                                  legally restrict others from doing anything the license permits.
+   ** For commercial use, please contact the original copyright holder(s) to agree licensing terms
+**************************************************************************************************************
+	The FLiM routines have no code or definitions that are specific to any
+	module, so they can be used to provide FLiM facilities for any module 
+	using these libraries.
+	
+*/ 
+/* 
+ * File:   txQueue.h
+ *
+ * Created on 18 October 2026, 19:40
+ *
+ * Queue of produced events waiting for a free CAN transmit buffer.
+ */
+
+#ifndef TXQUEUE_H
+#define	TXQUEUE_H
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+#include "GenericTypeDefs.h"
+#include "module.h"
+
+/*
+ * The priority classes, highest priority first.
+ */
+#define TX_PRIORITY_INPUT       0   // input changes
+#define TX_PRIORITY_OUTPUT      1   // servo, bounce, multi, output and analogue state changes
+#define TX_PRIORITY_SOD         2   // start of day responses
+#define NUM_TX_PRIORITIES       3
+
+/*
+ * Codes for the DIAG_TX diagnostic service
+ */
+#define TX_OVERFLOWS            1   // produced events lost because the queue was full
+#define TX_DEFERRED             2   // produced events which had to wait for a transmit buffer
+#define TX_MAX_DEPTH            3   // most events waiting at once
+#define TX_SEND_FAILURES        4   // queued events dropped because they could not be sent within TX_STALL_TIME
+
+extern void txQueueInit(void);
+extern BOOL queueProducedEvent(PRODUCER_ACTION_T action, BOOL on, unsigned char priority);
+extern BOOL queueInvertedProducedEvent(PRODUCER_ACTION_T action, BOOL state, BOOL invert, unsigned char priority);
+extern BOOL txQueueHasSpace(unsigned char priority);
+extern void pollTxQueue(void);
+extern BOOL getTxDiagnostic(BYTE code, WORD * value);
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif	/* TXQUEUE_H */